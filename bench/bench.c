@@ -0,0 +1,652 @@
+/** @file
+ * Pomiary wydajności modułu phone_forward.h
+ *
+ * Program jest wywoływany z nazwą pomiaru i jego parametrami, a wyniki
+ * wypisuje na standardowe wyjście, po jednym wierszu na przypadek.
+ * Przekierowania są losowane deterministycznie, więc kolejne uruchomienia
+ * mierzą te same dane.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "../src/phone_forward_internal.h"
+
+/**
+ * Maksymalna długość losowanego numeru
+ */
+#define benchNumberLength 15
+
+/**
+ * Liczba cyfr, z których składają się losowane numery
+ */
+#define benchDigits 10
+
+/**
+ * Maksymalna liczba wątków w pomiarze skalowania odczytów
+ */
+#define benchMaxThreads 64
+
+/** @brief Zwraca czas zegara monotonicznego w sekundach.
+ * @return Czas w sekundach.
+ */
+static double benchNow(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** @brief Zwraca kolejną liczbę pseudolosową.
+ * @param[in,out] state – stan generatora (xorshift64).
+ * @return Liczba pseudolosowa.
+ */
+static unsigned long long benchRandom(unsigned long long *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+/** @brief Losuje numer.
+ * @param[in,out] state – stan generatora;
+ * @param[out] num – bufor na co najmniej @ref benchNumberLength + 1 znaków;
+ * @param[in] min – minimalna długość numeru;
+ * @param[in] max – maksymalna długość numeru.
+ */
+static void benchNumber(unsigned long long *state, char *num, int min, int max)
+{
+    int len = min + benchRandom(state) % (max - min + 1);
+
+    for(int i = 0; i < len; i++)
+        num[i] = '0' + benchRandom(state) % benchDigits;
+
+    num[len] = '\0';
+}
+
+/** @brief Tworzy strukturę z losowymi przekierowaniami.
+ * Prefiksy mają od 3 do 8 cyfr, a numery docelowe od 3 do 10 cyfr.
+ * @param[in] rules – liczba dodawanych przekierowań;
+ * @param[in] seed – ziarno generatora.
+ * @return Wskaźnik na strukturę lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+static struct PhoneForward *benchForward(size_t rules, unsigned long long seed)
+{
+    struct PhoneForward *pf = phfwdNew();
+    char num1[benchNumberLength + 1], num2[benchNumberLength + 1];
+
+    for(size_t i = 0; pf != NULL && i < rules; i++)
+    {
+        benchNumber(&seed, num1, 3, 8);
+        benchNumber(&seed, num2, 3, 10);
+
+        if (!phfwdAdd(pf, num1, num2) && strcmp(num1, num2) != 0)
+        {
+            phfwdDelete(pf);
+            return NULL;
+        }
+    }
+
+    return pf;
+}
+
+/**
+ * Dane wątku w pomiarze skalowania odczytów.
+ */
+struct BenchReader
+{
+    pthread_t thread; ///< wątek
+    struct PhoneForward *pf; ///< wspólna struktura w trybie współbieżnym
+    unsigned long long seed; ///< ziarno generatora numerów wątku
+    atomic_bool *stop; ///< czy pomiar się skończył
+    unsigned long long operations; ///< liczba wykonanych operacji
+};
+
+/** @brief Wykonuje zapytania @ref phfwdGet, dopóki pomiar trwa.
+ * @param[in,out] data – wskaźnik na @ref BenchReader.
+ * @return NULL.
+ */
+static void *benchReader(void *data)
+{
+    struct BenchReader *r = data;
+    char num[benchNumberLength + 1];
+
+    while (!atomic_load_explicit(r->stop, memory_order_relaxed))
+    {
+        benchNumber(&r->seed, num, 9, benchNumberLength);
+        phnumDelete(phfwdGet(r->pf, num));
+        r->operations++;
+    }
+
+    return NULL;
+}
+
+/** @brief Dodaje i usuwa przekierowania, dopóki pomiar trwa.
+ * @param[in,out] data – wskaźnik na @ref BenchReader.
+ * @return NULL.
+ */
+static void *benchWriter(void *data)
+{
+    struct BenchReader *w = data;
+    char num1[benchNumberLength + 1], num2[benchNumberLength + 1];
+
+    while (!atomic_load_explicit(w->stop, memory_order_relaxed))
+    {
+        benchNumber(&w->seed, num1, 9, 12);
+        benchNumber(&w->seed, num2, 3, 10);
+        phfwdAdd(w->pf, num1, num2);
+        phfwdRemove(w->pf, num1);
+        w->operations++;
+    }
+
+    return NULL;
+}
+
+/** @brief Uruchamia wątki na zadany czas.
+ * @param[in,out] threads – dane wątków;
+ * @param[in] count – liczba wątków;
+ * @param[in] writers – liczba wątków na początku @p threads, które zmieniają
+ *                      przekierowania;
+ * @param[in] seconds – czas trwania pomiaru.
+ * @return Czas, który faktycznie upłynął.
+ */
+static double benchRun(struct BenchReader *threads, int count, int writers, double seconds)
+{
+    atomic_bool stop;
+    struct timespec pause = {(time_t)seconds, (long)((seconds - (time_t)seconds) * 1e9)};
+
+    atomic_init(&stop, false);
+
+    double start = benchNow();
+
+    for(int i = 0; i < count; i++)
+    {
+        threads[i].stop = &stop;
+        threads[i].operations = 0;
+        pthread_create(&threads[i].thread, NULL, i < writers ? benchWriter : benchReader,
+                       &threads[i]);
+    }
+
+    nanosleep(&pause, NULL);
+    atomic_store(&stop, true);
+
+    for(int i = 0; i < count; i++)
+        pthread_join(threads[i].thread, NULL);
+
+    return benchNow() - start;
+}
+
+/** @brief Mierzy skalowanie odczytów w trybie współbieżnym.
+ * Dla każdej liczby czytelników od 1 do @p maxThreads mierzy łączną
+ * przepustowość @ref phfwdGet, najpierw bez pisarza, a potem z jednym
+ * pisarzem, który cały czas dodaje i usuwa przekierowania. Liczba operacji
+ * pisarza pokazuje, że czytelnicy go nie zagładzają.
+ * @param[in] rules – liczba przekierowań w strukturze;
+ * @param[in] maxThreads – maksymalna liczba czytelników;
+ * @param[in] seconds – czas trwania każdego przypadku.
+ * @return Wartość @p true, jeśli pomiar się udał.
+ */
+static bool benchRead(size_t rules, int maxThreads, double seconds)
+{
+    struct PhoneForward *pf = benchForward(rules, 1);
+    struct BenchReader threads[benchMaxThreads + 1];
+
+    if (pf == NULL || !phfwdSetConcurrent(pf))
+    {
+        phfwdDelete(pf);
+        return false;
+    }
+
+    printf("threads  reads/s      reads/s+writer  writes/s\n");
+
+    for(int t = 1; t <= maxThreads; t++)
+    {
+        for(int i = 0; i <= t; i++)
+            threads[i] = (struct BenchReader){.pf = pf, .seed = 0x9e3779b97f4a7c15ull * (i + 1)};
+
+        double alone = benchRun(threads + 1, t, 0, seconds);
+        unsigned long long reads = 0;
+
+        for(int i = 1; i <= t; i++)
+            reads += threads[i].operations;
+
+        double alonePerSecond = reads / alone;
+
+        double mixed = benchRun(threads, t + 1, 1, seconds);
+
+        reads = 0;
+
+        for(int i = 1; i <= t; i++)
+            reads += threads[i].operations;
+
+        printf("%7d  %11.0f  %14.0f  %8.0f\n", t, alonePerSecond, reads / mixed,
+               threads[0].operations / mixed);
+    }
+
+    phfwdDelete(pf);
+
+    return true;
+}
+
+/**
+ * Plik, w którym pomiar wczytywania zapisuje przekierowania
+ */
+#define benchLoadPath "/tmp/phone_forward_bench.bin"
+
+/** @brief Mierzy zapisywanie i wczytywanie struktury.
+ * Tworzy strukturę z @p rules przekierowaniami o prefiksach od 6 do 12 cyfr
+ * i mierzy @ref phfwdSave, @ref phfwdLoad oraz @ref phfwdOpen ze
+ * sprawdzaniem całego pliku i bez niego, a dla porównania czas dodawania
+ * przekierowań funkcją @ref phfwdAdd.
+ * @param[in] rules – liczba przekierowań.
+ * @return Wartość @p true, jeśli pomiar się udał.
+ */
+static bool benchLoad(size_t rules)
+{
+    struct PhoneForward *pf = phfwdNew();
+    char num1[benchNumberLength + 1], num2[benchNumberLength + 1];
+    unsigned long long seed = 1;
+    double start = benchNow();
+
+    for(size_t i = 0; pf != NULL && i < rules; i++)
+    {
+        benchNumber(&seed, num1, 6, 12);
+        benchNumber(&seed, num2, 3, 10);
+
+        if (!phfwdAdd(pf, num1, num2) && strcmp(num1, num2) != 0)
+        {
+            phfwdDelete(pf);
+            pf = NULL;
+        }
+    }
+
+    double add = benchNow() - start;
+
+    start = benchNow();
+
+    bool ok = pf != NULL && phfwdSave(pf, benchLoadPath);
+    double save = benchNow() - start;
+
+    phfwdDelete(pf);
+
+    if (!ok)
+        return false;
+
+    start = benchNow();
+
+    struct PhoneForward *loaded = phfwdLoad(benchLoadPath);
+    double load = benchNow() - start;
+
+    start = benchNow();
+
+    struct PhoneForward *verified = phfwdOpen(benchLoadPath, true);
+    double verify = benchNow() - start;
+
+    start = benchNow();
+
+    struct PhoneForward *opened = phfwdOpen(benchLoadPath, false);
+    double open = benchNow() - start;
+
+    struct stat st;
+
+    ok = loaded != NULL && verified != NULL && opened != NULL && stat(benchLoadPath, &st) == 0;
+
+    if (ok)
+        printf("%9zu  %9.1f  %8.3f  %8.3f  %8.3f  %9.6f  %10.3f\n", rules, st.st_size / 1e6, add, save, load,
+               open, verify);
+
+    phfwdDelete(loaded);
+    phfwdDelete(verified);
+    phfwdDelete(opened);
+    unlink(benchLoadPath);
+
+    return ok;
+}
+
+/** @brief Porównuje napisy wskazywane przez dwa wskaźniki (dla qsort).
+ * @param[in] a – wskaźnik na pierwszy wskaźnik na napis;
+ * @param[in] b – wskaźnik na drugi wskaźnik na napis.
+ * @return Wynik strcmp napisów.
+ */
+static int benchCompare(const void *a, const void *b)
+{
+    return strcmp(*(char const *const *)a, *(char const *const *)b);
+}
+
+/** @brief Wypisuje przepustowość jednego sposobu wyznaczania przekierowań.
+ * @param[in] name – nazwa sposobu;
+ * @param[in] queries – liczba numerów;
+ * @param[in] seconds – czas wyznaczania;
+ * @param[in] check – suma kontrolna wyników, żeby kompilator ich nie pominął.
+ */
+static void benchReport(char const *name, size_t queries, double seconds, size_t check)
+{
+    printf("%-22s  %12.0f  %8zx\n", name, queries / seconds, check & 0xffffffff);
+}
+
+/** @brief Mierzy przepustowość @ref phfwdGetBatch w porównaniu z @ref phfwdGet.
+ * Numery w zapytaniach to jeden z @p prefixes wspólnych prefiksów
+ * z 8 cyfr, po których następuje 4 do 7 losowych cyfr, jak numery
+ * z bilingu jednego operatora. Mierzone są: @ref phfwdGet w pętli,
+ * @ref phfwdGetView w pętli oraz @ref phfwdGetBatch dla numerów
+ * w losowej kolejności i już posortowanych.
+ * @param[in] rules – liczba przekierowań w strukturze;
+ * @param[in] queries – liczba numerów w zapytaniu;
+ * @param[in] prefixes – liczba wspólnych prefiksów numerów.
+ * @return Wartość @p true, jeśli pomiar się udał.
+ */
+static bool benchBatch(size_t rules, size_t queries, size_t prefixes)
+{
+    struct PhoneForward *pf = benchForward(rules, 1);
+    char *digits = malloc(queries * (benchNumberLength + 1));
+    char (*common)[benchNumberLength + 1] = malloc(prefixes * sizeof(*common));
+    char const **nums = malloc(queries * sizeof(char const *));
+    struct PhoneForwardView *views = malloc(queries * sizeof(struct PhoneForwardView));
+    bool ok = pf != NULL && digits != NULL && common != NULL && nums != NULL && views != NULL;
+    unsigned long long seed = 2;
+
+    for(size_t i = 0; ok && i < prefixes; i++)
+        benchNumber(&seed, common[i], 8, 8);
+
+    for(size_t i = 0; ok && i < queries; i++)
+    {
+        char *num = digits + i * (benchNumberLength + 1);
+
+        memcpy(num, common[benchRandom(&seed) % prefixes], 8);
+        benchNumber(&seed, num + 8, 4, 7);
+        nums[i] = num;
+    }
+
+    if (ok)
+    {
+        printf("%-22s  %12s  %8s\n", "method", "numbers/s", "check");
+
+        size_t check = 0;
+        double start = benchNow();
+
+        for(size_t i = 0; i < queries; i++)
+        {
+            struct PhoneNumbers const *result = phfwdGet(pf, nums[i]);
+
+            check += strlen(phnumGet(result, 0));
+            phnumDelete(result);
+        }
+
+        benchReport("phfwdGet", queries, benchNow() - start, check);
+
+        check = 0;
+        start = benchNow();
+
+        for(size_t i = 0; i < queries; i++)
+        {
+            phfwdGetView(pf, nums[i], &views[i]);
+            check += views[i].prefixLength + strlen(views[i].suffix);
+        }
+
+        benchReport("phfwdGetView", queries, benchNow() - start, check);
+
+        check = 0;
+        start = benchNow();
+        ok = phfwdGetBatch(pf, nums, queries, views);
+
+        for(size_t i = 0; ok && i < queries; i++)
+            check += views[i].prefixLength + strlen(views[i].suffix);
+
+        benchReport("phfwdGetBatch", queries, benchNow() - start, check);
+
+        qsort(nums, queries, sizeof(char const *), benchCompare);
+
+        check = 0;
+        start = benchNow();
+        ok = ok && phfwdGetBatch(pf, nums, queries, views);
+
+        for(size_t i = 0; ok && i < queries; i++)
+            check += views[i].prefixLength + strlen(views[i].suffix);
+
+        benchReport("phfwdGetBatch sorted", queries, benchNow() - start, check);
+    }
+
+    free(views);
+    free(nums);
+    free(common);
+    free(digits);
+    phfwdDelete(pf);
+
+    return ok;
+}
+
+/**
+ * Liczba powtórzeń pomiaru jednego przypadku; wypisywany jest najkrótszy czas
+ */
+#define benchCountRounds 5
+
+/** @brief Tworzy strukturę do pomiaru liczenia nietrywialnych numerów.
+ * Numery docelowe przekierowań, których dotyczy indeks, mają od
+ * @p length - 3 do @p length cyfr ze wszystkich dwunastu, więc indeks ma
+ * tym więcej grup, im dłuższe są te numery (do 4096 masek na każdą
+ * głębokość).
+ * @param[in] rules – liczba przekierowań;
+ * @param[in] length – maksymalna długość numeru docelowego (co najmniej 4).
+ * @return Wskaźnik na strukturę w trybie współbieżnym lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+static struct PhoneForward *benchCountForward(size_t rules, int length)
+{
+    static char const digits[] = "0123456789:;";
+    struct PhoneForward *pf = phfwdNew();
+    char num1[benchNumberLength + 1], num2[benchNumberLength + 1];
+    unsigned long long seed = 3;
+
+    for(size_t i = 0; pf != NULL && i < rules; i++)
+    {
+        int len = length - benchRandom(&seed) % 4;
+
+        for(int j = 0; j < len; j++)
+            num2[j] = digits[benchRandom(&seed) % 12];
+
+        num2[len] = '\0';
+        benchNumber(&seed, num1, 6, 12);
+        phfwdAdd(pf, num1, num2);
+    }
+
+    // Tryb współbieżny wyłącza zapamiętywanie wyników
+    if (pf != NULL && !phfwdSetConcurrent(pf))
+    {
+        phfwdDelete(pf);
+        return NULL;
+    }
+
+    return pf;
+}
+
+/** @brief Mierzy średni czas wywołania @ref phfwdNonTrivialCount.
+ * @param[in,out] pf – wskaźnik na strukturę;
+ * @param[in] length – maksymalna długość numeru docelowego.
+ * @return Najkrótszy z @ref benchCountRounds średnich czasów w mikrosekundach.
+ */
+static double benchCountCall(struct PhoneForward *pf, int length)
+{
+    double best = 0;
+
+    for(int round = 0; round < benchCountRounds; round++)
+    {
+        size_t calls = 0;
+        double start = benchNow(), elapsed;
+
+        do
+        {
+            phfwdNonTrivialCount(pf, "0123456789", length + calls % 4);
+            calls++;
+            elapsed = benchNow() - start;
+        } while (elapsed < 0.1);
+
+        if (round == 0 || elapsed * 1e6 / calls < best)
+            best = elapsed * 1e6 / calls;
+    }
+
+    return best;
+}
+
+/** @brief Mierzy czas @ref phfwdNonTrivialCount dla różnej liczby wątków.
+ * Dla struktur z 1000, 2000, 4000... przekierowań (do @p maxRules) wypisuje
+ * liczbę grup i miejsc tablicy indeksu oraz średni czas jednego wywołania
+ * dla każdej liczby wątków od 1 do @p maxThreads. Wiersze, w których
+ * tablica jest mniejsza od @ref countParallelThreshold, liczą zawsze w jednym
+ * wątku. Ostatnia kolumna to czas liczenia jednego miejsca tablicy
+ * w jednym wątku.
+ *
+ * Próg wynika z tego pomiaru: wywołanie z pulą kosztuje dodatkowo czas
+ * obudzenia jej wątków (różnica kolumn dla 2 i 1 wątku na komputerze
+ * z jednym rdzeniem), a na k rdzeniach oszczędza co najwyżej (k - 1)/k
+ * czasu liczenia w jednym wątku. Podział opłaca się więc dopiero, gdy
+ * liczenie w jednym wątku trwa dłużej niż dwukrotny koszt obudzenia puli.
+ * @param[in] maxRules – maksymalna liczba przekierowań;
+ * @param[in] length – maksymalna długość numeru docelowego (co najmniej 4);
+ * @param[in] maxThreads – maksymalna liczba wątków.
+ * @return Wartość @p true, jeśli pomiar się udał.
+ */
+static bool benchCount(size_t maxRules, int length, int maxThreads)
+{
+    printf("    rules   groups    slots");
+
+    for(int t = 1; t <= maxThreads; t++)
+        printf("  %2d thr [us]", t);
+
+    printf("  ns/slot\n");
+
+    for(size_t rules = 1000; rules <= maxRules; rules *= 2)
+    {
+        struct PhoneForward *pf = benchCountForward(rules, length);
+        double serial = 0;
+
+        if (pf == NULL)
+            return false;
+
+        printf("%9zu  %7zu  %7zu", rules, pf->shallowest.size, pf->shallowest.capacity);
+
+        for(int t = 1; t <= maxThreads; t++)
+        {
+            phfwdSetCountThreads(pf, t);
+
+            double call = benchCountCall(pf, length);
+
+            serial = t == 1 ? call : serial;
+            printf("  %11.2f", call);
+        }
+
+        printf("  %7.2f%s\n", serial * 1e3 / pf->shallowest.capacity,
+               pf->shallowest.capacity < countParallelThreshold ? "  (serial)" : "");
+        phfwdDelete(pf);
+    }
+
+    return true;
+}
+
+/** @brief Wypisuje sposób wywołania programu.
+ * @param[in] name – nazwa programu.
+ */
+static void benchUsage(char const *name)
+{
+    fprintf(stderr, "usage: %s read [rules] [threads] [seconds]\n"
+                    "       %s load [rules...]\n"
+                    "       %s batch [rules] [numbers] [prefixes]\n"
+                    "       %s count [max rules] [target length] [threads]\n", name, name, name, name);
+}
+
+/** @brief Uruchamia wybrany pomiar.
+ * @param[in] argc – liczba argumentów;
+ * @param[in] argv – argumenty: nazwa pomiaru i jego parametry.
+ * @return 0, jeśli pomiar się udał, a 1 w przeciwnym wypadku.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        benchUsage(argv[0]);
+        return 1;
+    }
+
+    bool ok;
+
+    if (strcmp(argv[1], "read") == 0)
+    {
+        size_t rules = argc > 2 ? strtoull(argv[2], NULL, 10) : 100000;
+        int threads = argc > 3 ? atoi(argv[3]) : 8;
+        double seconds = argc > 4 ? atof(argv[4]) : 1;
+
+        if (threads < 1 || threads > benchMaxThreads || seconds <= 0)
+        {
+            benchUsage(argv[0]);
+            return 1;
+        }
+
+        ok = benchRead(rules, threads, seconds);
+    }
+    else if (strcmp(argv[1], "batch") == 0)
+    {
+        size_t rules = argc > 2 ? strtoull(argv[2], NULL, 10) : 1000000;
+        size_t queries = argc > 3 ? strtoull(argv[3], NULL, 10) : 1000000;
+        size_t prefixes = argc > 4 ? strtoull(argv[4], NULL, 10) : 1000;
+
+        if (queries == 0 || prefixes == 0)
+        {
+            benchUsage(argv[0]);
+            return 1;
+        }
+
+        ok = benchBatch(rules, queries, prefixes);
+    }
+    else if (strcmp(argv[1], "count") == 0)
+    {
+        size_t rules = argc > 2 ? strtoull(argv[2], NULL, 10) : 256000;
+        int length = argc > 3 ? atoi(argv[3]) : 12;
+        int threads = argc > 4 ? atoi(argv[4]) : 4;
+
+        if (length < 4 || length > benchNumberLength || threads < 1)
+        {
+            benchUsage(argv[0]);
+            return 1;
+        }
+
+        ok = benchCount(rules, length, threads);
+    }
+    else if (strcmp(argv[1], "load") == 0)
+    {
+        static const size_t defaultRules[] = {1000000, 10000000, 50000000};
+
+        ok = true;
+        printf("    rules  file [MB]  add [s]  save [s]  load [s]  open [s]  verify [s]\n");
+
+        if (argc == 2)
+        {
+            for(size_t i = 0; ok && i < sizeof(defaultRules) / sizeof(defaultRules[0]); i++)
+                ok = benchLoad(defaultRules[i]);
+        }
+
+        for(int i = 2; ok && i < argc; i++)
+            ok = benchLoad(strtoull(argv[i], NULL, 10));
+    }
+    else
+    {
+        benchUsage(argv[0]);
+        return 1;
+    }
+
+    if (!ok)
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/** @file
+ * Implementacja modułu arena.h
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#include <stdlib.h>
+#include "arena.h"
+
+/**
+ * Rozmiar bloku, z którego przydzielane są małe obiekty
+ */
+#define arenaBlockSize (64 * 1024)
+
+/** @brief Wyznacza klasę rozmiaru obiektu.
+ * @param[in] size – rozmiar obiektu większy niż 0.
+ * @return Indeks klasy rozmiaru.
+ */
+static inline size_t arenaClass(size_t size)
+{
+    return (size - 1) / arenaGranularity;
+}
+
+/** @brief Czyści stan areny bez zmiany jej muteksu.
+ * @param[out] arena – wskaźnik na arenę.
+ */
+static void arenaReset(struct Arena *arena)
+{
+    for(int i = 0; i < arenaClasses; i++)
+        arena->freeLists[i] = NULL;
+
+    arena->next = NULL;
+    arena->end = NULL;
+    arena->blocks = NULL;
+    arena->large.prev = &arena->large;
+    arena->large.next = &arena->large;
+}
+
+void arenaInit(struct Arena *arena)
+{
+    arenaReset(arena);
+    arena->lock = NULL;
+}
+
+/** @brief Alokuje duży obiekt.
+ * @param[in,out] arena – wskaźnik na arenę;
+ * @param[in] size – rozmiar obiektu w bajtach.
+ * @return Wskaźnik na obiekt lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+static void *arenaAllocLarge(struct Arena *arena, size_t size)
+{
+    struct ArenaLarge *l = malloc(sizeof(struct ArenaLarge) + size);
+
+    if (l == NULL)
+        return NULL;
+
+    l->prev = &arena->large;
+    l->next = arena->large.next;
+    l->next->prev = l;
+    arena->large.next = l;
+
+    return l + 1;
+}
+
+/** @brief Alokuje obiekt o rozmiarze @p size bez zakładania muteksu areny.
+ * @param[in,out] arena – wskaźnik na arenę;
+ * @param[in] size – rozmiar obiektu w bajtach.
+ * @return Wskaźnik na obiekt lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+static void *arenaAllocUnlocked(struct Arena *arena, size_t size)
+{
+    if (size == 0)
+        size = 1;
+
+    if (size > arenaGranularity * arenaClasses)
+        return arenaAllocLarge(arena, size);
+
+    size_t cls = arenaClass(size);
+    void *p = arena->freeLists[cls];
+
+    if (p != NULL)
+    {
+        arena->freeLists[cls] = *(void **)p;
+        return p;
+    }
+
+    size = (cls + 1) * arenaGranularity;
+
+    if (arena->next == NULL || (size_t)(arena->end - arena->next) < size)
+    {
+        char *block = malloc(arenaBlockSize);
+
+        if (block == NULL)
+            return NULL;
+
+        *(void **)block = arena->blocks;
+        arena->blocks = block;
+        arena->next = block + arenaGranularity;
+        arena->end = block + arenaBlockSize;
+    }
+
+    p = arena->next;
+    arena->next += size;
+
+    return p;
+}
+
+/** @brief Zwalnia obiekt zaalokowany w arenie bez zakładania muteksu areny.
+ * @param[in,out] arena – wskaźnik na arenę;
+ * @param[in] p – wskaźnik na obiekt różny od NULL;
+ * @param[in] size – rozmiar podany przy alokacji obiektu.
+ */
+static void arenaFreeUnlocked(struct Arena *arena, void *p, size_t size)
+{
+    if (size == 0)
+        size = 1;
+
+    if (size > arenaGranularity * arenaClasses)
+    {
+        struct ArenaLarge *l = (struct ArenaLarge *)p - 1;
+
+        l->prev->next = l->next;
+        l->next->prev = l->prev;
+        free(l);
+
+        return;
+    }
+
+    size_t cls = arenaClass(size);
+
+    *(void **)p = arena->freeLists[cls];
+    arena->freeLists[cls] = p;
+}
+
+void *arenaAlloc(struct Arena *arena, size_t size)
+{
+    if (arena->lock == NULL)
+        return arenaAllocUnlocked(arena, size);
+
+    pthread_mutex_lock(arena->lock);
+
+    void *p = arenaAllocUnlocked(arena, size);
+
+    pthread_mutex_unlock(arena->lock);
+
+    return p;
+}
+
+void arenaFree(struct Arena *arena, void *p, size_t size)
+{
+    if (p == NULL)
+        return;
+
+    if (arena->lock == NULL)
+    {
+        arenaFreeUnlocked(arena, p, size);
+        return;
+    }
+
+    pthread_mutex_lock(arena->lock);
+    arenaFreeUnlocked(arena, p, size);
+    pthread_mutex_unlock(arena->lock);
+}
+
+void arenaDestroy(struct Arena *arena)
+{
+    while (arena->blocks != NULL)
+    {
+        void *block = arena->blocks;
+        arena->blocks = *(void **)block;
+        free(block);
+    }
+
+    struct ArenaLarge *l = arena->large.next;
+
+    while (l != &arena->large)
+    {
+        struct ArenaLarge *next = l->next;
+        free(l);
+        l = next;
+    }
+
+    arenaReset(arena);
+}
@@ -0,0 +1,83 @@
+/** @file
+ * Interfejs alokatora pamięci dla węzłów i napisów struktury PhoneForward
+ *
+ * Alokator przydziela małe obiekty z dużych bloków pamięci. Zwolnione
+ * obiekty trafiają na listy wolnych obiektów (osobną dla każdej klasy
+ * rozmiaru) i są używane ponownie. Obiekty większe niż największa klasa
+ * są alokowane osobno, ale arena je pamięta, dzięki czemu cała pamięć
+ * areny może zostać zwolniona naraz, bez przechodzenia po strukturach,
+ * które z niej korzystają.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * Co ile bajtów są klasy rozmiaru obiektów
+ */
+#define arenaGranularity 8
+
+/**
+ * Liczba klas rozmiaru, największa klasa to arenaGranularity * arenaClasses bajtów
+ */
+#define arenaClasses 32
+
+/**
+ * @brief Nagłówek dużego obiektu.
+ * Duże obiekty są alokowane osobno i połączone w listę dwukierunkową,
+ * żeby można je było zwolnić razem z areną.
+ */
+struct ArenaLarge
+{
+    struct ArenaLarge *prev; ///< poprzedni duży obiekt
+    struct ArenaLarge *next; ///< następny duży obiekt
+};
+
+/**
+ * Struktura przechowująca stan areny.
+ */
+struct Arena
+{
+    void *freeLists[arenaClasses]; ///< listy wolnych obiektów dla każdej klasy rozmiaru
+    char *next; ///< początek wolnej części aktualnego bloku
+    char *end; ///< koniec aktualnego bloku
+    void *blocks; ///< lista zaalokowanych bloków
+    struct ArenaLarge large; ///< wartownik listy dużych obiektów
+    pthread_mutex_t *lock; ///< muteks chroniący arenę używaną przez wiele wątków lub NULL
+};
+
+/** @brief Inicjuje pustą arenę.
+ * Arena nie ma muteksu; właściciel może go później ustawić w polu @p lock,
+ * zanim zaczną z niej korzystać inne wątki.
+ * @param[out] arena – wskaźnik na inicjowaną arenę.
+ */
+void arenaInit(struct Arena *arena);
+
+/** @brief Alokuje obiekt o rozmiarze @p size.
+ * @param[in,out] arena – wskaźnik na arenę;
+ * @param[in] size – rozmiar obiektu w bajtach.
+ * @return Wskaźnik na obiekt lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+void *arenaAlloc(struct Arena *arena, size_t size);
+
+/** @brief Zwalnia obiekt zaalokowany w arenie.
+ * Nic nie robi, jeżeli @p p ma wartość NULL.
+ * @param[in,out] arena – wskaźnik na arenę;
+ * @param[in] p – wskaźnik na obiekt;
+ * @param[in] size – rozmiar podany przy alokacji obiektu.
+ */
+void arenaFree(struct Arena *arena, void *p, size_t size);
+
+/** @brief Zwalnia całą pamięć areny.
+ * Po wywołaniu wszystkie obiekty zaalokowane w arenie są nieważne,
+ * a arena jest pusta i może być dalej używana. Muteks areny nie jest zmieniany.
+ * @param[in,out] arena – wskaźnik na arenę.
+ */
+void arenaDestroy(struct Arena *arena);
+
+#endif /* __ARENA_H__ */
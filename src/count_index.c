@@ -0,0 +1,155 @@
+/** @file
+ * Implementacja modułu count_index.h
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#include <stdlib.h>
+#include "count_index.h"
+#include "open_table.h"
+
+/**
+ * Początkowy rozmiar tablicy haszującej
+ */
+#define countIndexInitialCapacity 16
+
+/** @brief Wylicza wartość funkcji haszującej grupy.
+ * @param[in] depth – głębokość wierzchołków grupy;
+ * @param[in] mask – maska bitowa cyfr grupy.
+ * @return Wartość funkcji haszującej.
+ */
+static size_t countIndexHash(size_t depth, unsigned int mask)
+{
+    size_t hash = (depth * 4096 + mask) * (size_t)11400714819323198485ull;
+
+    return hash ^ (hash >> 29);
+}
+
+/** @brief Sprawdza, czy miejsce tablicy jest puste.
+ * @param[in] entry – wskaźnik na miejsce tablicy.
+ * @return Wartość @p true, jeśli miejsce jest puste.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool countIndexEmpty(void const *entry)
+{
+    return ((struct CountIndexEntry const *)entry)->count == 0;
+}
+
+/** @brief Wylicza wartość funkcji haszującej grupy z miejsca tablicy.
+ * @param[in] entry – wskaźnik na niepuste miejsce tablicy.
+ * @return Wartość funkcji haszującej.
+ */
+static size_t countIndexEntryHash(void const *entry)
+{
+    struct CountIndexEntry const *e = entry;
+
+    return countIndexHash(e->depth, e->mask);
+}
+
+/** @brief Sprawdza, czy miejsce tablicy zawiera szukaną grupę.
+ * @param[in] entry – wskaźnik na niepuste miejsce tablicy;
+ * @param[in] key – wskaźnik na grupę z szukaną głębokością i maską.
+ * @return Wartość @p true, jeśli miejsce zawiera grupę.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool countIndexMatches(void const *entry, void const *key)
+{
+    struct CountIndexEntry const *e = entry, *k = key;
+
+    return e->depth == k->depth && e->mask == k->mask;
+}
+
+/**
+ * Opis elementów tablicy haszującej indeksu
+ */
+static const struct OpenTableType countIndexType =
+    {sizeof(struct CountIndexEntry), countIndexEmpty, countIndexEntryHash};
+
+void countIndexInit(struct CountIndex *index)
+{
+    index->table = NULL;
+    index->capacity = 0;
+    index->size = 0;
+}
+
+/** @brief Szuka w tablicy miejsca grupy.
+ * @param[in] index – wskaźnik na indeks o niezerowym rozmiarze tablicy;
+ * @param[in] depth – głębokość wierzchołków grupy;
+ * @param[in] mask – maska bitowa cyfr grupy.
+ * @return Indeks miejsca z grupą lub pierwszego wolnego miejsca.
+ */
+static size_t countIndexSlot(struct CountIndex const *index, size_t depth, unsigned int mask)
+{
+    struct CountIndexEntry key = {depth, mask, 0};
+
+    return openTableFind(index->table, index->capacity, &countIndexType, countIndexHash(depth, mask),
+                         countIndexMatches, &key);
+}
+
+/** @brief Przenosi grupy do tablicy haszującej o rozmiarze @p capacity.
+ * @param[in,out] index – wskaźnik na indeks;
+ * @param[in] capacity – nowy rozmiar tablicy (potęga dwójki większa od 2 * @p size).
+ * @return Wartość @p true, jeśli przeniesiono grupy.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool countIndexResize(struct CountIndex *index, size_t capacity)
+{
+    struct CountIndexEntry *table = openTableResize(index->table, index->capacity, &countIndexType, capacity);
+
+    if (table == NULL)
+        return false;
+
+    free(index->table);
+    index->table = table;
+    index->capacity = capacity;
+
+    return true;
+}
+
+bool countIndexAdd(struct CountIndex *index, size_t depth, unsigned int mask)
+{
+    // Tablica jest zapełniona co najwyżej w połowie
+    if (2 * (index->size + 1) > index->capacity
+        && !countIndexResize(index, index->capacity == 0 ? countIndexInitialCapacity : index->capacity * 2))
+        return false;
+
+    size_t i = countIndexSlot(index, depth, mask);
+
+    if (index->table[i].count == 0)
+    {
+        index->table[i].depth = depth;
+        index->table[i].mask = mask;
+        index->size++;
+    }
+
+    index->table[i].count++;
+
+    return true;
+}
+
+void countIndexRemove(struct CountIndex *index, size_t depth, unsigned int mask)
+{
+    if (index->capacity == 0)
+        return;
+
+    size_t i = countIndexSlot(index, depth, mask);
+
+    if (index->table[i].count == 0 || --index->table[i].count > 0)
+        return;
+
+    openTableErase(index->table, index->capacity, &countIndexType, i);
+    index->size--;
+
+    // Liczenie przegląda całą tablicę, więc po usunięciu większości grup jest
+    // ona zmniejszana; próg 1/8 zostawia zapas, żeby nie zmieniać rozmiaru
+    // przy każdym dodaniu i usunięciu. Jeżeli nie uda się zaalokować
+    // pamięci, zostaje stara tablica.
+    if (index->capacity > countIndexInitialCapacity && 8 * index->size < index->capacity)
+        countIndexResize(index, index->capacity / 2);
+}
+
+void countIndexDestroy(struct CountIndex *index)
+{
+    free(index->table);
+    countIndexInit(index);
+}
@@ -0,0 +1,67 @@
+/** @file
+ * Interfejs indeksu najpłytszych niepustych wierzchołków drzewa Trie_reverse
+ *
+ * Indeks przechowuje, ile jest najpłytszych wierzchołków drzewa Trie_reverse
+ * z niepustym drzewem reverse (takich, że żaden ich przodek nie ma
+ * przekierowań) o danej głębokości i danym zbiorze cyfr na ścieżce od
+ * korzenia. Tylko te dane są potrzebne do wyliczenia phfwdNonTrivialCount.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#ifndef __COUNT_INDEX_H__
+#define __COUNT_INDEX_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @brief Grupa wierzchołków o tej samej głębokości i tym samym zbiorze cyfr.
+ * Wpis z zerową liczbą wierzchołków jest pusty.
+ */
+struct CountIndexEntry
+{
+    size_t depth; ///< głębokość wierzchołków, czyli długość numeru, który reprezentują
+    unsigned int mask; ///< maska bitowa cyfr występujących w tym numerze
+    size_t count; ///< liczba wierzchołków w grupie
+};
+
+/**
+ * Struktura przechowująca indeks.
+ */
+struct CountIndex
+{
+    struct CountIndexEntry *table; ///< tablica haszująca z adresowaniem otwartym
+    size_t capacity; ///< rozmiar tablicy (potęga dwójki lub 0)
+    size_t size; ///< liczba niepustych grup
+};
+
+/** @brief Inicjuje pusty indeks.
+ * @param[out] index – wskaźnik na inicjowany indeks.
+ */
+void countIndexInit(struct CountIndex *index);
+
+/** @brief Dodaje wierzchołek do indeksu.
+ * @param[in,out] index – wskaźnik na indeks;
+ * @param[in] depth – głębokość wierzchołka;
+ * @param[in] mask – maska bitowa cyfr na ścieżce do wierzchołka.
+ * @return Wartość @p true, jeśli dodano wierzchołek.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+bool countIndexAdd(struct CountIndex *index, size_t depth, unsigned int mask);
+
+/** @brief Usuwa wierzchołek z indeksu.
+ * Nic nie robi, jeżeli w indeksie nie ma takiej grupy. Tablica jest
+ * zmniejszana o połowę, gdy niepuste grupy zajmują mniej niż 1/8 jej miejsc.
+ * @param[in,out] index – wskaźnik na indeks;
+ * @param[in] depth – głębokość wierzchołka;
+ * @param[in] mask – maska bitowa cyfr na ścieżce do wierzchołka.
+ */
+void countIndexRemove(struct CountIndex *index, size_t depth, unsigned int mask);
+
+/** @brief Zwalnia pamięć indeksu.
+ * @param[in,out] index – wskaźnik na indeks.
+ */
+void countIndexDestroy(struct CountIndex *index);
+
+#endif /* __COUNT_INDEX_H__ */
@@ -0,0 +1,460 @@
+/** @file
+ * Implementacja modułu journal.h
+ *
+ * Rekord składa się z bajtu rodzaju, długości obu numerów (po 4 bajty),
+ * cyfr obu numerów zakończonych znakami '\0' (drugi numer rekordu usunięcia
+ * jest pusty) i 4-bajtowej sumy kontrolnej wszystkich poprzednich bajtów.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "journal.h"
+
+/**
+ * Początkowy rozmiar każdego z buforów
+ */
+#define journalBufferSize (1 << 16)
+
+/**
+ * Rozmiar początku rekordu: rodzaju i długości numerów
+ */
+#define journalRecordHead (1 + 2 * sizeof(uint32_t))
+
+/**
+ * Rodzaj rekordu dodania przekierowania
+ */
+#define journalAdd 1
+
+/**
+ * Rodzaj rekordu usunięcia przekierowań
+ */
+#define journalRemove 2
+
+/** @brief Wylicza sumę kontrolną (FNV-1a) rekordu.
+ * @param[in] data – wskaźnik na początek rekordu;
+ * @param[in] length – liczba bajtów przed sumą kontrolną.
+ * @return Suma kontrolna.
+ */
+static uint32_t journalHash(char const *data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+
+    for(size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+/** @brief Zapisuje w pliku cały bufor.
+ * @param[in] fd – deskryptor pliku;
+ * @param[in] data – wskaźnik na bufor;
+ * @param[in] length – liczba bajtów.
+ * @return Wartość @p true, jeśli zapisano bufor.
+ *         Wartość @p false, jeśli wystąpił błąd zapisu.
+ */
+static bool journalWrite(int fd, char const *data, size_t length)
+{
+    while (length > 0)
+    {
+        ssize_t written = write(fd, data, length);
+
+        if (written < 0 && errno != EINTR)
+            return false;
+
+        if (written > 0)
+        {
+            data += written;
+            length -= written;
+        }
+    }
+
+    return true;
+}
+
+/** @brief Wczytuje cały plik.
+ * @param[in] fd – deskryptor pliku;
+ * @param[out] size – rozmiar pliku.
+ * @return Wskaźnik na bufor z zawartością pliku (niepusty także dla pustego
+ *         pliku) lub NULL, gdy wystąpił błąd odczytu lub nie udało się
+ *         zaalokować pamięci.
+ */
+static char *journalRead(int fd, size_t *size)
+{
+    struct stat st;
+
+    if (fstat(fd, &st) != 0)
+        return NULL;
+
+    char *data = malloc(st.st_size + 1);
+    size_t length = 0;
+
+    while (data != NULL && length < (size_t)st.st_size)
+    {
+        ssize_t got = read(fd, data + length, st.st_size - length);
+
+        if (got == 0 || (got < 0 && errno != EINTR))
+        {
+            free(data);
+            return NULL;
+        }
+
+        if (got > 0)
+            length += got;
+    }
+
+    *size = length;
+
+    return data;
+}
+
+/** @brief Sprawdza rekord leżący na początku @p data.
+ * @param[in] data – wskaźnik na początek rekordu;
+ * @param[in] available – liczba bajtów do końca pliku;
+ * @param[out] length1 – długość pierwszego numeru;
+ * @param[out] length2 – długość drugiego numeru.
+ * @return Rozmiar poprawnego rekordu lub 0, jeżeli rekord jest niepełny
+ *         albo uszkodzony.
+ */
+static size_t journalRecord(char const *data, size_t available, uint32_t *length1, uint32_t *length2)
+{
+    if (available < journalRecordHead)
+        return 0;
+
+    memcpy(length1, data + 1, sizeof(uint32_t));
+    memcpy(length2, data + 1 + sizeof(uint32_t), sizeof(uint32_t));
+
+    // Długości są sprawdzane osobno, żeby ich suma się nie przepełniła
+    if (*length1 >= available || *length2 >= available)
+        return 0;
+
+    size_t body = journalRecordHead + (size_t)*length1 + 1 + *length2 + 1;
+    uint32_t checksum;
+
+    if (body + sizeof(uint32_t) > available)
+        return 0;
+
+    memcpy(&checksum, data + body, sizeof(uint32_t));
+
+    bool valid = (data[0] == journalAdd || (data[0] == journalRemove && *length2 == 0))
+                 && data[journalRecordHead + *length1] == '\0' && data[body - 1] == '\0'
+                 && checksum == journalHash(data, body);
+
+    return valid ? body + sizeof(uint32_t) : 0;
+}
+
+bool journalReplay(char const *path, JournalApply apply, void *data)
+{
+    int fd = open(path, O_RDWR);
+
+    if (fd < 0)
+        return errno == ENOENT;
+
+    size_t size;
+    char *file = journalRead(fd, &size);
+    struct JournalHeader header;
+    bool result = file != NULL;
+    size_t position = 0;
+
+    if (result && size >= sizeof(struct JournalHeader))
+    {
+        memcpy(&header, file, sizeof(struct JournalHeader));
+        result = header.magic == journalMagic && header.version == journalVersion;
+        position = sizeof(struct JournalHeader);
+    }
+
+    // Plik bez pełnego nagłówka nie ma rekordów i jest przycinany do zera
+    while (result && position > 0 && position < size)
+    {
+        uint32_t length1, length2;
+        size_t record = journalRecord(file + position, size - position, &length1, &length2);
+
+        if (record == 0)
+            break;
+
+        char const *num1 = file + position + journalRecordHead;
+
+        result = apply(data, file[position] == journalAdd, num1,
+                       file[position] == journalAdd ? num1 + length1 + 1 : NULL);
+        position += record;
+    }
+
+    // Rekordy za przerwanym zapisem nie mogły zostać utrwalone
+    if (result && position < size)
+        result = ftruncate(fd, position) == 0;
+
+    free(file);
+    close(fd);
+
+    return result;
+}
+
+struct Journal *journalOpen(char const *path, unsigned int batch, uint64_t threshold)
+{
+    struct Journal *j = malloc(sizeof(struct Journal));
+
+    if (j == NULL)
+        return NULL;
+
+    j->fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    j->buffer = malloc(journalBufferSize);
+    j->spare = malloc(journalBufferSize);
+
+    struct stat st;
+    struct JournalHeader header = {journalMagic, journalVersion};
+    bool ok = j->fd >= 0 && j->buffer != NULL && j->spare != NULL && fstat(j->fd, &st) == 0;
+
+    // Plik bez pełnego nagłówka został przycięty przez journalReplay albo jego tworzenie przerwano
+    if (ok && (uint64_t)st.st_size < sizeof(struct JournalHeader))
+    {
+        ok = ftruncate(j->fd, 0) == 0 && journalWrite(j->fd, (char const *)&header, sizeof(header))
+             && fdatasync(j->fd) == 0;
+        st.st_size = sizeof(header);
+    }
+
+    if (!ok || pthread_mutex_init(&j->lock, NULL) != 0)
+    {
+        if (j->fd >= 0)
+            close(j->fd);
+
+        free(j->buffer);
+        free(j->spare);
+        free(j);
+        return NULL;
+    }
+
+    if (pthread_cond_init(&j->written, NULL) != 0)
+    {
+        pthread_mutex_destroy(&j->lock);
+        close(j->fd);
+        free(j->buffer);
+        free(j->spare);
+        free(j);
+        return NULL;
+    }
+
+    j->length = 0;
+    j->capacity = journalBufferSize;
+    j->spareCapacity = journalBufferSize;
+    j->busy = false;
+    j->failed = false;
+    j->appended = 0;
+    j->synced = 0;
+    j->batch = batch > 0 ? batch : 1;
+    j->size = st.st_size;
+    j->threshold = threshold;
+    j->limit = threshold;
+
+    return j;
+}
+
+bool journalClose(struct Journal *j)
+{
+    if (j == NULL)
+        return true;
+
+    bool result = journalSync(j);
+
+    result &= close(j->fd) == 0;
+    pthread_cond_destroy(&j->written);
+    pthread_mutex_destroy(&j->lock);
+    free(j->buffer);
+    free(j->spare);
+    free(j);
+
+    return result;
+}
+
+/** @brief Zapisuje bufor w pliku.
+ * Wywoływana z założonym muteksem dziennika, który zdejmuje na czas zapisu.
+ * W tym czasie inne wątki dopisują rekordy do drugiego bufora.
+ * @param[in,out] j – wskaźnik na dziennik;
+ * @param[in] sync – czy utrwalić plik po zapisie.
+ */
+static void journalFlushLocked(struct Journal *j, bool sync)
+{
+    while (j->busy)
+        pthread_cond_wait(&j->written, &j->lock);
+
+    if (j->failed)
+        return;
+
+    char *buffer = j->buffer;
+    size_t length = j->length;
+    size_t capacity = j->capacity;
+    unsigned long long appended = j->appended;
+
+    j->buffer = j->spare;
+    j->capacity = j->spareCapacity;
+    j->length = 0;
+    j->busy = true;
+    pthread_mutex_unlock(&j->lock);
+
+    bool ok = journalWrite(j->fd, buffer, length) && (!sync || fdatasync(j->fd) == 0);
+
+    pthread_mutex_lock(&j->lock);
+    j->spare = buffer;
+    j->spareCapacity = capacity;
+    j->busy = false;
+
+    if (!ok)
+        j->failed = true;
+    else if (sync && appended > j->synced)
+        j->synced = appended;
+
+    pthread_cond_broadcast(&j->written);
+}
+
+/** @brief Powiększa bieżący bufor tak, żeby zmieścił @p size bajtów.
+ * @param[in,out] j – wskaźnik na dziennik z pustym buforem;
+ * @param[in] size – wymagany rozmiar.
+ * @return Wartość @p true, jeśli powiększono bufor.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool journalGrow(struct Journal *j, size_t size)
+{
+    size_t capacity = 2 * j->capacity > size ? 2 * j->capacity : size;
+    char *buffer = realloc(j->buffer, capacity);
+
+    if (buffer == NULL)
+        return false;
+
+    j->buffer = buffer;
+    j->capacity = capacity;
+
+    return true;
+}
+
+bool journalAppend(struct Journal *j, bool add, char const *num1, char const *num2)
+{
+    size_t length1 = strlen(num1);
+    size_t length2 = add ? strlen(num2) : 0;
+    size_t body = journalRecordHead + length1 + 1 + length2 + 1;
+
+    pthread_mutex_lock(&j->lock);
+
+    if (length1 >= UINT32_MAX || length2 >= UINT32_MAX)
+        j->failed = true;
+
+    while (!j->failed && j->length + body + sizeof(uint32_t) > j->capacity)
+    {
+        if (j->length > 0)
+            journalFlushLocked(j, false);
+        else if (!journalGrow(j, body + sizeof(uint32_t)))
+            j->failed = true;
+    }
+
+    if (!j->failed)
+    {
+        char *record = j->buffer + j->length;
+        uint32_t length = length1;
+
+        record[0] = add ? journalAdd : journalRemove;
+        memcpy(record + 1, &length, sizeof(uint32_t));
+        length = length2;
+        memcpy(record + 1 + sizeof(uint32_t), &length, sizeof(uint32_t));
+        memcpy(record + journalRecordHead, num1, length1 + 1);
+        memcpy(record + journalRecordHead + length1 + 1, add ? num2 : "", length2 + 1);
+
+        uint32_t checksum = journalHash(record, body);
+
+        memcpy(record + body, &checksum, sizeof(uint32_t));
+        j->length += body + sizeof(uint32_t);
+        j->size += body + sizeof(uint32_t);
+        j->appended++;
+    }
+
+    bool full = !j->failed && j->appended - j->synced >= j->batch;
+
+    pthread_mutex_unlock(&j->lock);
+
+    return full;
+}
+
+bool journalSync(struct Journal *j)
+{
+    pthread_mutex_lock(&j->lock);
+
+    // Rekordy dopisane później utrwali następne wywołanie
+    unsigned long long appended = j->appended;
+
+    while (!j->failed && j->synced < appended)
+    {
+        if (j->busy)
+            pthread_cond_wait(&j->written, &j->lock);
+        else
+            journalFlushLocked(j, true);
+    }
+
+    bool result = !j->failed;
+
+    pthread_mutex_unlock(&j->lock);
+
+    return result;
+}
+
+bool journalFull(struct Journal *j)
+{
+    pthread_mutex_lock(&j->lock);
+
+    bool result = j->size > j->limit;
+
+    pthread_mutex_unlock(&j->lock);
+
+    return result;
+}
+
+bool journalFailed(struct Journal *j)
+{
+    pthread_mutex_lock(&j->lock);
+
+    bool result = j->failed;
+
+    pthread_mutex_unlock(&j->lock);
+
+    return result;
+}
+
+bool journalReset(struct Journal *j)
+{
+    struct JournalHeader header = {journalMagic, journalVersion};
+
+    pthread_mutex_lock(&j->lock);
+
+    while (j->busy)
+        pthread_cond_wait(&j->written, &j->lock);
+
+    j->failed = j->failed || ftruncate(j->fd, 0) != 0
+                || !journalWrite(j->fd, (char const *)&header, sizeof(header)) || fdatasync(j->fd) != 0;
+
+    if (!j->failed)
+    {
+        j->length = 0;
+        j->synced = j->appended;
+        j->size = sizeof(header);
+        j->limit = j->threshold;
+    }
+
+    bool result = !j->failed;
+
+    pthread_mutex_unlock(&j->lock);
+
+    return result;
+}
+
+void journalPostpone(struct Journal *j)
+{
+    pthread_mutex_lock(&j->lock);
+    j->limit = j->size + j->threshold;
+    pthread_mutex_unlock(&j->lock);
+}
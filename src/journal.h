@@ -0,0 +1,159 @@
+/** @file
+ * Interfejs dziennika zmian przekierowań
+ *
+ * Dziennik jest plikiem, do którego tylko się dopisuje: po nagłówku leżą
+ * rekordy dodania i usunięcia przekierowań, każdy z własną sumą kontrolną.
+ * Rekordy trafiają najpierw do bufora w pamięci, a do pliku są zapisywane
+ * całymi buforami. Utrwalanie (fdatasync) jest grupowe: wątek, który je
+ * rozpoczyna, utrwala rekordy wszystkich wątków, a pozostałe czekają na
+ * jego wynik zamiast wywoływać fdatasync osobno.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#ifndef __JOURNAL_H__
+#define __JOURNAL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/**
+ * Pierwsze słowo nagłówka pliku dziennika
+ */
+#define journalMagic 0x4a574650u
+
+/**
+ * Wersja formatu pliku dziennika
+ */
+#define journalVersion 1u
+
+/**
+ * @brief Nagłówek pliku dziennika.
+ */
+struct JournalHeader
+{
+    uint32_t magic; ///< wartość @ref journalMagic
+    uint32_t version; ///< wartość @ref journalVersion
+};
+
+/**
+ * Struktura przechowująca otwarty dziennik.
+ */
+struct Journal
+{
+    int fd; ///< deskryptor pliku dziennika otwartego do dopisywania
+    pthread_mutex_t lock; ///< muteks chroniący pozostałe pola
+    pthread_cond_t written; ///< zmienna warunkowa sygnalizowana po zapisaniu bufora
+    char *buffer; ///< rekordy, które nie są jeszcze zapisane w pliku
+    size_t length; ///< liczba bajtów w @p buffer
+    size_t capacity; ///< rozmiar @p buffer
+    char *spare; ///< drugi bufor, zapisywany w pliku, gdy @p busy ma wartość @p true
+    size_t spareCapacity; ///< rozmiar @p spare
+    bool busy; ///< czy któryś wątek zapisuje bufor w pliku
+    bool failed; ///< czy wystąpił błąd zapisu (wtedy dziennik nie przyjmuje rekordów)
+    unsigned long long appended; ///< liczba dopisanych rekordów
+    unsigned long long synced; ///< liczba rekordów utrwalonych na dysku
+    unsigned int batch; ///< liczba nieutrwalonych rekordów, po której trzeba utrwalić dziennik
+    uint64_t size; ///< rozmiar dziennika w bajtach razem z buforami
+    uint64_t limit; ///< rozmiar, po przekroczeniu którego dziennik trzeba skrócić
+    uint64_t threshold; ///< przyrost rozmiaru, po którym dziennik trzeba skrócić
+};
+
+/** @brief Funkcja stosująca rekord dziennika.
+ * @param[in,out] data – dane przekazane do @ref journalReplay;
+ * @param[in] add – czy rekord dodaje przekierowanie (a nie usuwa);
+ * @param[in] num1 – wskaźnik na pierwszy numer rekordu;
+ * @param[in] num2 – wskaźnik na drugi numer rekordu dodania lub NULL.
+ * @return Wartość @p true, jeśli zastosowano rekord.
+ *         Wartość @p false, jeśli odtwarzanie trzeba przerwać.
+ */
+typedef bool (*JournalApply)(void *data, bool add, char const *num1, char const *num2);
+
+/** @brief Odtwarza rekordy dziennika.
+ * Wczytuje cały plik jednym odczytem i wywołuje @p apply dla kolejnych
+ * rekordów. Niepełny lub uszkodzony rekord oznacza przerwany zapis, więc
+ * plik jest przycinany przed nim, a dalsze rekordy są pomijane.
+ * @param[in] path – ścieżka pliku dziennika;
+ * @param[in] apply – funkcja stosująca rekordy;
+ * @param[in,out] data – dane przekazywane do @p apply.
+ * @return Wartość @p true, jeśli odtworzono dziennik lub plik nie istnieje.
+ *         Wartość @p false, jeśli plik nie jest dziennikiem, wystąpił błąd
+ *         odczytu lub @p apply przerwała odtwarzanie.
+ */
+bool journalReplay(char const *path, JournalApply apply, void *data);
+
+/** @brief Otwiera dziennik do dopisywania.
+ * Tworzy plik z nagłówkiem, jeżeli nie istnieje lub nie ma pełnego nagłówka.
+ * @param[in] path – ścieżka pliku dziennika;
+ * @param[in] batch – liczba rekordów, po której dopisaniu dziennik trzeba
+ *                    utrwalić (co najmniej 1);
+ * @param[in] threshold – przyrost rozmiaru pliku w bajtach, po którym
+ *                        dziennik trzeba skrócić.
+ * @return Wskaźnik na dziennik lub NULL, gdy nie udało się otworzyć pliku
+ *         lub zaalokować pamięci.
+ */
+struct Journal *journalOpen(char const *path, unsigned int batch, uint64_t threshold);
+
+/** @brief Utrwala i zamyka dziennik.
+ * Nic nie robi, jeśli @p j ma wartość NULL.
+ * @param[in] j – wskaźnik na dziennik, do którego nikt nie dopisuje.
+ * @return Wartość @p true, jeśli wszystkie rekordy zostały utrwalone.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+bool journalClose(struct Journal *j);
+
+/** @brief Dopisuje rekord do dziennika.
+ * Rekord trafia do bufora; pełny bufor jest zapisywany w pliku bez
+ * utrwalania. Błędy są zapamiętywane w polu @p failed.
+ * @param[in,out] j – wskaźnik na dziennik;
+ * @param[in] add – czy rekord dodaje przekierowanie (a nie usuwa);
+ * @param[in] num1 – wskaźnik na pierwszy numer;
+ * @param[in] num2 – wskaźnik na drugi numer rekordu dodania lub NULL.
+ * @return Wartość @p true, jeśli liczba nieutrwalonych rekordów osiągnęła
+ *         @p batch i trzeba wywołać @ref journalSync.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+bool journalAppend(struct Journal *j, bool add, char const *num1, char const *num2);
+
+/** @brief Utrwala wszystkie dopisane dotąd rekordy.
+ * Jeżeli inny wątek właśnie utrwala dziennik, to czeka na niego i utrwala
+ * sam tylko wtedy, gdy tamten nie objął wszystkich rekordów.
+ * @param[in,out] j – wskaźnik na dziennik.
+ * @return Wartość @p true, jeśli rekordy zostały utrwalone.
+ *         Wartość @p false, jeśli wystąpił błąd zapisu.
+ */
+bool journalSync(struct Journal *j);
+
+/** @brief Sprawdza, czy dziennik wymaga skrócenia.
+ * @param[in] j – wskaźnik na dziennik.
+ * @return Wartość @p true, jeśli rozmiar dziennika przekroczył limit.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+bool journalFull(struct Journal *j);
+
+/** @brief Sprawdza, czy dziennik przyjmuje rekordy.
+ * @param[in] j – wskaźnik na dziennik.
+ * @return Wartość @p true, jeśli wystąpił błąd zapisu.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+bool journalFailed(struct Journal *j);
+
+/** @brief Usuwa wszystkie rekordy dziennika.
+ * Wywoływana, gdy stan opisany przez rekordy jest już utrwalony w innym
+ * pliku. Bufor jest porzucany, a plik przycinany do samego nagłówka.
+ * @param[in,out] j – wskaźnik na dziennik, do którego nikt nie dopisuje.
+ * @return Wartość @p true, jeśli usunięto rekordy.
+ *         Wartość @p false, jeśli wystąpił błąd zapisu.
+ */
+bool journalReset(struct Journal *j);
+
+/** @brief Odkłada skrócenie dziennika.
+ * Przesuwa limit rozmiaru o @p threshold od bieżącego rozmiaru, żeby po
+ * nieudanym skróceniu nie ponawiać go przy każdym rekordzie.
+ * @param[in,out] j – wskaźnik na dziennik.
+ */
+void journalPostpone(struct Journal *j);
+
+#endif /* __JOURNAL_H__ */
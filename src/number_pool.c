@@ -0,0 +1,236 @@
+/** @file
+ * Implementacja modułu number_pool.h
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "number_pool.h"
+#include "open_table.h"
+
+/**
+ * Początkowy rozmiar tablicy haszującej
+ */
+#define poolInitialCapacity 64
+
+/** @brief Sprawdza, czy miejsce tablicy jest puste.
+ * @param[in] entry – wskaźnik na miejsce tablicy.
+ * @return Wartość @p true, jeśli miejsce jest puste.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool poolEmpty(void const *entry)
+{
+    return *(struct PoolEntry *const *)entry == NULL;
+}
+
+/** @brief Zwraca zapamiętaną wartość funkcji haszującej numeru.
+ * @param[in] entry – wskaźnik na niepuste miejsce tablicy.
+ * @return Wartość funkcji haszującej.
+ */
+static size_t poolEntryHash(void const *entry)
+{
+    return (*(struct PoolEntry *const *)entry)->hash;
+}
+
+/**
+ * Opis elementów tablicy haszującej puli
+ */
+static const struct OpenTableType poolType = {sizeof(struct PoolEntry *), poolEmpty, poolEntryHash};
+
+/**
+ * @brief Szukany numer.
+ */
+struct PoolKey
+{
+    char const *num; ///< cyfry numeru
+    unsigned int hash; ///< wartość funkcji haszującej numeru
+    size_t length; ///< długość numeru
+};
+
+/** @brief Sprawdza, czy miejsce tablicy zawiera szukany numer.
+ * @param[in] entry – wskaźnik na niepuste miejsce tablicy;
+ * @param[in] key – wskaźnik na @ref PoolKey.
+ * @return Wartość @p true, jeśli miejsce zawiera numer.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool poolMatches(void const *entry, void const *key)
+{
+    struct PoolEntry const *e = *(struct PoolEntry *const *)entry;
+    struct PoolKey const *k = key;
+
+    return e->hash == k->hash && e->length == k->length && memcmp(e->digits, k->num, k->length) == 0;
+}
+
+void poolInit(struct NumberPool *pool, struct Arena *arena)
+{
+    pool->arena = arena;
+    pool->table = NULL;
+    pool->capacity = 0;
+    pool->size = 0;
+    pool->lock = NULL;
+}
+
+/** @brief Szuka w tablicy miejsca numeru @p num.
+ * @param[in] pool – wskaźnik na pulę o niezerowym rozmiarze tablicy;
+ * @param[in] num – wskaźnik na numer;
+ * @param[in] hash – wartość funkcji haszującej numeru;
+ * @param[in] length – długość numeru.
+ * @return Indeks miejsca z numerem lub pierwszego wolnego miejsca.
+ */
+static size_t poolSlot(struct NumberPool const *pool, char const *num, unsigned int hash, size_t length)
+{
+    struct PoolKey key = {num, hash, length};
+
+    return openTableFind(pool->table, pool->capacity, &poolType, hash, poolMatches, &key);
+}
+
+/** @brief Powiększa tablicę haszującą dwukrotnie.
+ * @param[in,out] pool – wskaźnik na pulę.
+ * @return Wartość @p true, jeśli powiększono tablicę.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool poolGrow(struct NumberPool *pool)
+{
+    size_t capacity = pool->capacity == 0 ? poolInitialCapacity : pool->capacity * 2;
+    struct PoolEntry **table = openTableResize(pool->table, pool->capacity, &poolType, capacity);
+
+    if (table == NULL)
+        return false;
+
+    free(pool->table);
+    pool->table = table;
+    pool->capacity = capacity;
+
+    return true;
+}
+
+/** @brief Zwraca numer z puli równy @p num bez zakładania muteksu puli.
+ * @param[in,out] pool – wskaźnik na pulę;
+ * @param[in] num – wskaźnik na numer.
+ * @return Wskaźnik na numer z puli lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+static char const *poolInternUnlocked(struct NumberPool *pool, char const *num)
+{
+    size_t length;
+    unsigned int hash = openTableHash(num, &length);
+
+    // Tablica jest zapełniona co najwyżej w połowie
+    if (2 * (pool->size + 1) > pool->capacity && !poolGrow(pool))
+        return NULL;
+
+    size_t i = poolSlot(pool, num, hash, length);
+
+    if (pool->table[i] != NULL)
+    {
+        atomic_fetch_add_explicit(&pool->table[i]->refs, 1, memory_order_relaxed);
+        return pool->table[i]->digits;
+    }
+
+    struct PoolEntry *e = arenaAlloc(pool->arena, sizeof(struct PoolEntry) + length + 1);
+
+    if (e == NULL)
+        return NULL;
+
+    atomic_init(&e->refs, 1);
+    e->hash = hash;
+    e->length = length;
+    memcpy(e->digits, num, length + 1);
+
+    pool->table[i] = e;
+    pool->size++;
+
+    return e->digits;
+}
+
+char const *poolIntern(struct NumberPool *pool, char const *num)
+{
+    if (pool->lock == NULL)
+        return poolInternUnlocked(pool, num);
+
+    pthread_mutex_lock(pool->lock);
+
+    char const *result = poolInternUnlocked(pool, num);
+
+    pthread_mutex_unlock(pool->lock);
+
+    return result;
+}
+
+bool poolReserve(struct NumberPool *pool, size_t size)
+{
+    while (2 * size > pool->capacity)
+    {
+        if (!poolGrow(pool))
+            return false;
+    }
+
+    return true;
+}
+
+char const *poolFind(struct NumberPool const *pool, char const *num)
+{
+    if (pool->capacity == 0)
+        return NULL;
+
+    size_t length;
+    unsigned int hash = openTableHash(num, &length);
+    size_t i = poolSlot(pool, num, hash, length);
+
+    return pool->table[i] != NULL ? pool->table[i]->digits : NULL;
+}
+
+size_t poolPosition(struct NumberPool const *pool, char const *num)
+{
+    struct PoolEntry const *e = poolEntry(num);
+
+    return poolSlot(pool, num, e->hash, e->length);
+}
+
+/** @brief Usuwa z puli numer, do którego nie ma już odwołań.
+ * @param[in,out] pool – wskaźnik na pulę;
+ * @param[in] num – wskaźnik na numer z puli.
+ */
+static void poolErase(struct NumberPool *pool, char const *num)
+{
+    struct PoolEntry *e = poolEntry(num);
+
+    openTableErase(pool->table, pool->capacity, &poolType, poolSlot(pool, num, e->hash, e->length));
+    pool->size--;
+
+    arenaFree(pool->arena, e, sizeof(struct PoolEntry) + e->length + 1);
+}
+
+void poolRelease(struct NumberPool *pool, char const *num)
+{
+    if (num == NULL)
+        return;
+
+    struct PoolEntry *e = poolEntry(num);
+
+    if (pool->lock == NULL)
+    {
+        if (atomic_fetch_sub_explicit(&e->refs, 1, memory_order_relaxed) == 1)
+            poolErase(pool, num);
+
+        return;
+    }
+
+    // Licznik jest zmniejszany pod muteksem, żeby poolIntern nie znalazł
+    // numeru, który właśnie jest usuwany
+    pthread_mutex_lock(pool->lock);
+
+    if (atomic_fetch_sub_explicit(&e->refs, 1, memory_order_relaxed) == 1)
+        poolErase(pool, num);
+
+    pthread_mutex_unlock(pool->lock);
+}
+
+void poolDestroy(struct NumberPool *pool)
+{
+    pthread_mutex_t *lock = pool->lock;
+
+    free(pool->table);
+    poolInit(pool, pool->arena);
+    pool->lock = lock;
+}
@@ -0,0 +1,132 @@
+/** @file
+ * Interfejs puli numerów współdzielonych przez drzewa struktury PhoneForward
+ *
+ * Każdy numer jest przechowywany w puli co najwyżej raz, razem z licznikiem
+ * odwołań. Dwa numery z tej samej puli są równe wtedy i tylko wtedy, gdy
+ * wskaźniki na nie są równe.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#ifndef __NUMBER_POOL_H__
+#define __NUMBER_POOL_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "arena.h"
+
+/**
+ * @brief Numer przechowywany w puli.
+ * Użytkownicy puli dostają wskaźnik na pole @p digits.
+ */
+struct PoolEntry
+{
+    atomic_uint refs; ///< liczba odwołań do numeru
+    unsigned int hash; ///< wartość funkcji haszującej numeru
+    size_t length; ///< długość numeru
+    char digits[]; ///< cyfry numeru zakończone znakiem '\0'
+};
+
+/**
+ * Struktura przechowująca pulę numerów.
+ */
+struct NumberPool
+{
+    struct Arena *arena; ///< arena, w której alokowane są numery
+    struct PoolEntry **table; ///< tablica haszująca z adresowaniem otwartym
+    size_t capacity; ///< rozmiar tablicy (potęga dwójki lub 0)
+    size_t size; ///< liczba numerów w puli
+    pthread_mutex_t *lock; ///< muteks chroniący pulę używaną przez wiele wątków lub NULL
+};
+
+/** @brief Inicjuje pustą pulę.
+ * Pula nie ma muteksu; właściciel może go później ustawić w polu @p lock,
+ * zanim zaczną z niej korzystać inne wątki.
+ * @param[out] pool – wskaźnik na inicjowaną pulę;
+ * @param[in] arena – arena, w której będą alokowane numery.
+ */
+void poolInit(struct NumberPool *pool, struct Arena *arena);
+
+/** @brief Zwraca numer z puli równy @p num i zwiększa jego licznik odwołań.
+ * Jeżeli w puli nie ma takiego numeru, to jest on dodawany.
+ * @param[in,out] pool – wskaźnik na pulę;
+ * @param[in] num – wskaźnik na numer.
+ * @return Wskaźnik na numer z puli lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+char const *poolIntern(struct NumberPool *pool, char const *num);
+
+/** @brief Przygotowuje pulę na @p size numerów.
+ * Powiększa tablicę haszującą tak, żeby pula z @p size numerami nie musiała
+ * jej powiększać.
+ * @param[in,out] pool – wskaźnik na pulę;
+ * @param[in] size – liczba numerów.
+ * @return Wartość @p true, jeśli przygotowano pulę.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+bool poolReserve(struct NumberPool *pool, size_t size);
+
+/** @brief Zwraca numer z puli równy @p num bez zmiany licznika odwołań.
+ * Nie zakłada muteksu puli, więc inne wątki nie mogą w tym czasie jej zmieniać.
+ * @param[in] pool – wskaźnik na pulę;
+ * @param[in] num – wskaźnik na numer.
+ * @return Wskaźnik na numer z puli lub NULL, jeżeli nie ma go w puli.
+ */
+char const *poolFind(struct NumberPool const *pool, char const *num);
+
+/** @brief Zwraca pozycję numeru w tablicy haszującej puli.
+ * Różne numery z puli mają różne pozycje, mniejsze od @p capacity, więc
+ * pozycja może indeksować tablicę danych dołączonych do numerów. Pozycje
+ * zmieniają się przy dodawaniu i usuwaniu numerów.
+ * @param[in] pool – wskaźnik na pulę;
+ * @param[in] num – wskaźnik na numer z puli.
+ * @return Indeks numeru w tablicy @p table.
+ */
+size_t poolPosition(struct NumberPool const *pool, char const *num);
+
+/** @brief Zwalnia jedno odwołanie do numeru z puli.
+ * Numer, do którego nie ma już odwołań, jest usuwany z puli.
+ * Nic nie robi, jeżeli @p num ma wartość NULL.
+ * @param[in,out] pool – wskaźnik na pulę;
+ * @param[in] num – wskaźnik na numer z puli.
+ */
+void poolRelease(struct NumberPool *pool, char const *num);
+
+/** @brief Zwalnia tablicę haszującą puli.
+ * Same numery są zwalniane razem z areną.
+ * @param[in,out] pool – wskaźnik na pulę.
+ */
+void poolDestroy(struct NumberPool *pool);
+
+/** @brief Zwraca nagłówek numeru z puli.
+ * @param[in] num – wskaźnik na numer z puli.
+ * @return Wskaźnik na nagłówek numeru.
+ */
+static inline struct PoolEntry *poolEntry(char const *num)
+{
+    return (struct PoolEntry *)(num - offsetof(struct PoolEntry, digits));
+}
+
+/** @brief Dodaje odwołanie do numeru z puli.
+ * Wywołujący musi mieć odwołanie do numeru, więc licznik nie może w tym
+ * czasie spaść do zera i nie trzeba zakładać muteksu puli.
+ * @param[in] num – wskaźnik na numer z puli.
+ * @return Wskaźnik @p num.
+ */
+static inline char const *poolRetain(char const *num)
+{
+    atomic_fetch_add_explicit(&poolEntry(num)->refs, 1, memory_order_relaxed);
+    return num;
+}
+
+/** @brief Zwraca długość numeru z puli.
+ * @param[in] num – wskaźnik na numer z puli.
+ * @return Długość numeru.
+ */
+static inline size_t poolLength(char const *num)
+{
+    return poolEntry(num)->length;
+}
+
+#endif /* __NUMBER_POOL_H__ */
@@ -0,0 +1,148 @@
+/** @file
+ * Interfejs tablic haszujących z adresowaniem otwartym
+ *
+ * Tablice mają rozmiar będący potęgą dwójki i są przeszukiwane liniowo.
+ * Użytkownik trzyma elementy w zwykłej tablicy i opisuje je strukturą
+ * @ref OpenTableType; miejsce wypełnione zerami musi być puste. Funkcje są
+ * zdefiniowane w nagłówku, żeby kompilator mógł wstawić w nie funkcje
+ * z opisu typu, bo szukanie leży na gorącej ścieżce.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#ifndef __OPEN_TABLE_H__
+#define __OPEN_TABLE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Opis elementów tablicy haszującej.
+ */
+struct OpenTableType
+{
+    size_t size; ///< rozmiar elementu w bajtach
+    bool (*empty)(void const *entry); ///< czy miejsce jest puste
+    size_t (*hash)(void const *entry); ///< wartość funkcji haszującej elementu z niepustego miejsca
+};
+
+/** @brief Wylicza wartość funkcji haszującej (FNV-1a) napisu.
+ * @param[in] s – wskaźnik na napis;
+ * @param[out] length – długość napisu lub NULL, jeśli nie jest potrzebna.
+ * @return Wartość funkcji haszującej.
+ */
+static inline unsigned int openTableHash(char const *s, size_t *length)
+{
+    unsigned int hash = 2166136261u;
+    size_t i = 0;
+
+    for(; s[i] != '\0'; i++)
+    {
+        hash ^= (unsigned char)s[i];
+        hash *= 16777619u;
+    }
+
+    if (length != NULL)
+        *length = i;
+
+    return hash;
+}
+
+/** @brief Zwraca wskaźnik na miejsce tablicy.
+ * @param[in] table – wskaźnik na tablicę;
+ * @param[in] type – opis elementów;
+ * @param[in] i – indeks miejsca.
+ * @return Wskaźnik na miejsce @p i.
+ */
+static inline void *openTableAt(void const *table, struct OpenTableType const *type, size_t i)
+{
+    return (char *)table + i * type->size;
+}
+
+/** @brief Szuka w tablicy miejsca elementu.
+ * @param[in] table – wskaźnik na tablicę, której nie wypełniają same elementy;
+ * @param[in] capacity – rozmiar tablicy (potęga dwójki);
+ * @param[in] type – opis elementów;
+ * @param[in] hash – wartość funkcji haszującej szukanego elementu;
+ * @param[in] matches – funkcja sprawdzająca, czy element jest szukanym;
+ * @param[in] key – dane przekazywane do @p matches.
+ * @return Indeks miejsca ze znalezionym elementem lub pierwszego wolnego miejsca.
+ */
+static inline size_t openTableFind(void const *table, size_t capacity, struct OpenTableType const *type,
+                                   size_t hash, bool (*matches)(void const *entry, void const *key),
+                                   void const *key)
+{
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+
+    while (!type->empty(openTableAt(table, type, i)) && !matches(openTableAt(table, type, i), key))
+        i = (i + 1) & mask;
+
+    return i;
+}
+
+/** @brief Przenosi elementy do nowej tablicy.
+ * @param[in] table – wskaźnik na tablicę lub NULL, jeżeli @p capacity jest 0;
+ * @param[in] capacity – rozmiar tablicy;
+ * @param[in] type – opis elementów;
+ * @param[in] newCapacity – rozmiar nowej tablicy (potęga dwójki większa od
+ *                          liczby elementów).
+ * @return Wskaźnik na nową tablicę lub NULL, gdy nie udało się zaalokować
+ *         pamięci. Starą tablicę zwalnia wywołujący.
+ */
+static inline void *openTableResize(void const *table, size_t capacity, struct OpenTableType const *type,
+                                    size_t newCapacity)
+{
+    void *resized = calloc(newCapacity, type->size);
+
+    if (resized == NULL)
+        return NULL;
+
+    for(size_t i = 0; i < capacity; i++)
+    {
+        void const *e = openTableAt(table, type, i);
+
+        if (!type->empty(e))
+        {
+            size_t j = type->hash(e) & (newCapacity - 1);
+
+            while (!type->empty(openTableAt(resized, type, j)))
+                j = (j + 1) & (newCapacity - 1);
+
+            memcpy(openTableAt(resized, type, j), e, type->size);
+        }
+    }
+
+    return resized;
+}
+
+/** @brief Usuwa element z tablicy.
+ * Usuwa z przesuwaniem wstecz, żeby nie zostawiać pustych miejsc w ciągach
+ * zajętych miejsc, i wypełnia zwolnione miejsce zerami.
+ * @param[in,out] table – wskaźnik na tablicę;
+ * @param[in] capacity – rozmiar tablicy (potęga dwójki);
+ * @param[in] type – opis elementów;
+ * @param[in] i – indeks miejsca usuwanego elementu.
+ */
+static inline void openTableErase(void *table, size_t capacity, struct OpenTableType const *type, size_t i)
+{
+    size_t mask = capacity - 1;
+
+    for(size_t j = (i + 1) & mask; !type->empty(openTableAt(table, type, j)); j = (j + 1) & mask)
+    {
+        size_t home = type->hash(openTableAt(table, type, j)) & mask;
+
+        // Element z j może zająć miejsce i, jeżeli i leży między home a j (cyklicznie)
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            memcpy(openTableAt(table, type, i), openTableAt(table, type, j), type->size);
+            i = j;
+        }
+    }
+
+    memset(openTableAt(table, type, i), 0, type->size);
+}
+
+#endif /* __OPEN_TABLE_H__ */
@@ -5,11 +5,20 @@
  * @date 12.05.2018
  */
 
-#include <stdio.h>
-#include <stdlib.h>
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
-#include "phone_forward.h"
+#include <stdatomic.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "phone_forward_internal.h"
 
 ///znak zero
 #define zero '0'
@@ -24,24 +33,6 @@
 ///////
 // Phone_num
 
-/** @brief Kopiuje numer.
- * Tworzy nowy numer, który jest taki sam jak ten wskazany przez @p num.
- *
- * @param[in] num – wskaźnik na poprawny numer.
- * @return Wskaźnik na skopiowany numer.
- */
-
-static char const *copy_number(char const *num)
-{
-    size_t len = strlen(num);
-
-    char *new_num = malloc(sizeof(char const) * len + 1);
-
-    new_num = strcpy(new_num, num);
-
-    return new_num;
-}
-
 /** @brief Łączy dwa numery w jeden ( @p num1 + @p num2).
  * Tworzy nowy numer, który jest konkatenacją numerów
  * wskazanych przez @p num1 i @p num2.
@@ -93,16 +84,15 @@ static struct PhoneNumbers *phnumNew(int size)
 }
 
 
-/** @brief Dodaje numer do struktury.
- *  Tworzy nowy numer, taki sam jak ten wskazywany przez @p num
- *  i dodaje go (jego wskaźnik) do struktury @p pnum.
+/** @brief Dodaje wskaźnik na numer do struktury.
+ *  Dodaje do struktury @p pnum wskaźnik @p num bez kopiowania numeru.
  *
  * @param[in,out] pnum – wskaźnik na strukture przechowującą numery.
  * @param[in] num – wskaźnik na numer
  * @return Wskaźnik na stworzoną strukturę z dodanym numerem, jeśli dodano numer.
  *         Wskaźnik na strukturę bez dodanego numeru, jeżel nie udało się zaalokować pamięci.
  */
-static struct PhoneNumbers *phnumAdd(struct PhoneNumbers *pnum, char const *num)
+static struct PhoneNumbers *phnumAppend(struct PhoneNumbers *pnum, char const *num)
 {
 
     if (pnum->size == pnum->struct_size)
@@ -126,53 +116,12 @@ static struct PhoneNumbers *phnumAdd(struct PhoneNumbers *pnum, char const *num)
         free((void *)pnum2);
     }
 
-    char const *new_num = copy_number(num);
-    pnum->tab[pnum->size] = new_num;
+    pnum->tab[pnum->size] = num;
     pnum->size++;
 
     return pnum;
 }
 
-/** @brief Usuwa numer o zadanym indeksie ze struktury.
- *  Usuwa numer o indeksie @p idx ze struktury @p pnum.
- *
- * @param[in,out] pnum – wskaźnik na strukture przechowującą numery.
- * @param[in] idx – indeks numeru w strukturze (idx >= 0 && idx < liczba numerów w strukturze) .
- * @return Wskaźnik na strukturę z usuniętym numerem, jeśli usunięto numer.
- *         Wskaźnik na strukturę bez usuniętego numeru, jeżel nie udało się zaalokować pamięci.
- */
-
-struct PhoneNumbers *phnumRemove(struct PhoneNumbers *pnum, int idx)
-{
-    free((char *)pnum->tab[idx]);
-    pnum->tab[idx] = pnum->tab[pnum->size - 1];
-    pnum->size--;
-
-    if (pnum->size == pnum->struct_size/2 && pnum->size != 0)
-    {
-        int new_size = pnum->size;
-
-        struct PhoneNumbers *pnum2 = pnum;
-        pnum = phnumNew(new_size);
-
-        if (pnum == NULL)
-            return pnum2;
-
-        pnum->size = pnum2->size;
-
-        for(int i = 0; i < pnum2->size; i++)
-        {
-            pnum->tab[i] = pnum2->tab[i];
-        }
-
-        free((char **)pnum2->tab);
-        free((void *)pnum2);
-    }
-
-    return pnum;
-}
-
-
 // Funkcja z phone_forward.h
 char const *phnumGet(struct PhoneNumbers const *pnum, size_t idx)
 {
@@ -182,780 +131,4456 @@ char const *phnumGet(struct PhoneNumbers const *pnum, size_t idx)
         return NULL;
 }
 
-/** @brief Komparator numerów.
- *
- * @param[in] a – wskaźnik na numer.
- * @param[in] b – wskaźnik na numer.
- * @return Wartość mniejszą od 0, jeżeli a < b (w leksykograficznym porządku numerów pod tymi wskaźnikami).
- *         Wartość 0, jeżeli a = b.
- *         Wartość większą od 0, jeżeli a > b.
- */
-
-static int compare(const void *a, const void *b)
-{
-    return strcmp(*(const char **) a, *(const char **) b);
-}
-
-/** @brief Sortuje numery w strukturze @p pnum.
- *
- *  Sortuje n pierwszych numerów w strukturze @p pnum
- *
- * @param[in] pnum – wskaźnik na strukture przechowującą numery.
- * @param[in] n – liczba elementów do posortowania.
- */
-
-static void phnumSort(struct PhoneNumbers *pnum, int n)
-{
-    qsort(pnum->tab, n, sizeof(const char*), compare);
-}
-
+///////
+///////
+///////
+// TrieSons
 
-/** @brief Usuwa powtarzające się numery w strukturze @p pnum.
+/** @brief Zwraca syna węzła odpowiadającego cyfrze @p digit.
  *
- * @param[in,out] pnum – wskaźnik na strukture przechowującą numery.
- * @return Wskaźnik, która zawiera wszystkie numery ze struktury
- *         @p pnum bez powtórzeń.
+ * @param[in] sons – wskaźnik na synów węzła.
+ * @param[in] digit – wartość cyfry.
+ * @return Wskaźnik na syna lub NULL, jeżeli nie ma takiego syna.
  */
 
-static struct PhoneNumbers *phnumUnique(struct PhoneNumbers *pnum)
+static inline void *sonsGet(const struct TrieSons *sons, int digit)
 {
-    phnumSort(pnum, pnum->size);
+    if (sons->capacity == numberOfDigits)
+        return sons->tab[digit];
 
-    for(int i = pnum->size - 1; i > 0; i--)
+    for(int i = 0; i < sons->numberOfSons; i++)
     {
-        if (strcmp(pnum->tab[i], pnum->tab[i-1]) == 0)
-            pnum = phnumRemove(pnum, i);
+        if (sons->keys[i] == digit)
+            return sons->tab[i];
     }
 
-    phnumSort(pnum, pnum->size);
-
-    return pnum;
-
+    return NULL;
 }
 
-///////
-///////
-///////
-// Trie_forward
-
-/** @brief Tworzy pusty obiekt typu Trie_forward
- *
- * Tworzy pusty obiekt typu Trie_forward, domyślnie ustawia
- * wskaźniki na synów i forwarding jako NULL.
+/** @brief Zwraca miejsce, w którym zapisany jest syn odpowiadający cyfrze @p digit.
  *
- * @return Pusty obiekt typu Trie_forward.
+ * @param[in] sons – wskaźnik na synów węzła.
+ * @param[in] digit – wartość cyfry.
+ * @return Wskaźnik na miejsce w tablicy synów lub NULL, jeżeli nie ma takiego syna.
  */
 
-static Trie_forward trieforNew()
+static inline void **sonsSlot(struct TrieSons *sons, int digit)
 {
-    Trie_forward t = (Trie_forward)malloc(sizeof(struct Node_forward));
+    if (sons->capacity == numberOfDigits)
+        return sons->tab[digit] != NULL ? &sons->tab[digit] : NULL;
 
-    t->forwarding = NULL;
-    // Jest numberOfDigits cyfr
-    t->sons = malloc(sizeof(Trie_forward) * numberOfDigits);
-    t->numberOfSons = 0;
-
-    for(int i = 0; i < numberOfDigits; i++)
+    for(int i = 0; i < sons->numberOfSons; i++)
     {
-        t->sons[i] =  NULL;
+        if (sons->keys[i] == digit)
+            return &sons->tab[i];
     }
 
-    return t;
+    return NULL;
 }
 
-/** @brief Dealokuje pojedynczy wierzchołek typu Trie_forward
+/** @brief Zwraca miejsce, w którym zapisany jest jedyny syn węzła.
  *
- * @param[in] t – obiekt typu Trie_forward.
+ * @param[in] sons – wskaźnik na synów węzła, który ma dokładnie jednego syna.
+ * @return Wskaźnik na miejsce w tablicy synów.
  */
 
-static void trieforDeleteNode(Trie_forward t)
+static inline void **sonsOnlySlot(struct TrieSons *sons)
 {
-    free(t->sons);
-    free(t->forwarding);
-    free(t);
+    int i = 0;
+
+    while (sons->tab[i] == NULL)
+        i++;
+
+    return &sons->tab[i];
 }
 
-/** @brief Dealokuje pojedynczy wierzchołek i całe poddrzewo typu Trie_forward
+/** @brief Zwraca cyfrę syna z pozycji @p i tablicy synów.
  *
- * @param[in] t – obiekt typu Trie_forward.
+ * @param[in] sons – wskaźnik na synów węzła.
+ * @param[in] i – pozycja w tablicy synów (i < sons->capacity).
+ * @return Wartość cyfry.
  */
 
-static void trieforDelete(Trie_forward t)
+static inline int sonsDigit(const struct TrieSons *sons, int i)
 {
-    for(int i = 0; i < numberOfDigits; i++)
-    {
-        if (t->sons[i] != NULL)
-            trieforDelete(t->sons[i]);
-    }
-
-    trieforDeleteNode(t);
+    return sons->capacity == numberOfDigits ? i : sons->keys[i];
 }
 
-
-/** @brief Dodaje przekierowanie.
+/** @brief Zmienia rozmiar tablicy synów.
  *
- * Dodaje przekierowanie z numeru wskazywanego przez @p num1
- * na numer wskazywany przez @p num2 do @p t.
+ * Przepisuje synów do nowej tablicy o rozmiarze @p capacity
+ * (0, smallSons lub numberOfDigits).
  *
- * @param[in] t – obiekt typu Trie_forward.
- * @param[in] num1 – wskaźnik na numer przekierowywany.
- * @param[in] num2 – wskaźnik na numer, który jest przekierowniem z @p num1
- * @return Wartość @p true, jeśli przekierowanie zostało dodane
- *         Wartość @p false, jeśli przekierowanie nie zostało dodane
+ * @param[in,out] arena – arena, w której alokowane są tablice.
+ * @param[in,out] sons – wskaźnik na synów węzła.
+ * @param[in] capacity – nowy rozmiar tablicy.
+ * @return Wartość @p true, jeśli zmieniono rozmiar.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
  */
 
-static bool trieforAdd(Trie_forward t, char *num1, char *num2)
+static bool sonsResize(struct Arena *arena, struct TrieSons *sons, int capacity)
 {
-    bool p;
+    void **tab = NULL;
+    int n = 0;
 
-    if (num1[0] == '\0')
+    if (capacity > 0)
     {
-        if (t->forwarding != NULL)
-            free(t->forwarding);
+        tab = arenaAlloc(arena, sizeof(void *) * capacity);
+
+        if (tab == NULL)
+            return false;
 
-        t->forwarding = (char  *)copy_number(num2);
-        p = true;
+        for(int i = 0; i < capacity; i++)
+            tab[i] = NULL;
     }
-    else
+
+    for(int i = 0; i < sons->capacity; i++)
     {
-        if (t->sons[num1[0] - zero] == NULL)
+        if (sons->tab[i] == NULL)
+            continue;
+
+        int digit = sonsDigit(sons, i);
+
+        if (capacity == numberOfDigits)
         {
-            t->sons[num1[0] - zero] = trieforNew();
-            t->numberOfSons++;
+            tab[digit] = sons->tab[i];
         }
-
-        if (t->sons[num1[0] - zero] == NULL)
-            p = false;
         else
-            p = trieforAdd(t->sons[num1[0] - zero], num1 + 1, num2);
+        {
+            tab[n] = sons->tab[i];
+            sons->keys[n] = digit;
+            n++;
+        }
     }
 
-    return p;
+    arenaFree(arena, sons->tab, sizeof(void *) * sons->capacity);
+    sons->tab = tab;
+    sons->capacity = capacity;
+
+    return true;
 }
 
-/** @brief Usuwa wierzchołek @p t i jego poddrzewo.
+/** @brief Dodaje nowego syna.
  *
- * Usuwa wierzchołek @p t i jego poddrzewo, a przekierowanie, które
- * znajdowały się w usuwanych wierzchołkach dodaje do struktury
- * skazywanej przez @p numbers.
+ * Dodaje syna @p son dla cyfry @p digit, której węzeł jeszcze nie ma.
+ * W razie potrzeby zamienia małą tablicę synów na pełną.
  *
- * @param[in] t – obiekt typu Trie_forward.
- * @param[in] numbers – wskaźnik na strukturę przechowującą numery.
- * @return Wskaźnik na strukturę @p numbers z dodanymi numerami.
+ * @param[in,out] arena – arena, w której alokowane są tablice.
+ * @param[in,out] sons – wskaźnik na synów węzła.
+ * @param[in] digit – wartość cyfry.
+ * @param[in] son – wskaźnik na syna.
+ * @return Wartość @p true, jeśli dodano syna.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
  */
 
-static struct PhoneNumbers *removeSubtree(Trie_forward t, struct PhoneNumbers *numbers)
+static bool sonsAdd(struct Arena *arena, struct TrieSons *sons, int digit, void *son)
 {
-    for(int i = 0; i < numberOfDigits; i++)
+    if (sons->pinned)
     {
-        if (t->sons[i] != NULL)
-            numbers = removeSubtree(t->sons[i], numbers);
+        sons->tab[digit] = son;
+        return true;
     }
 
-    if (t->forwarding != NULL)
-        numbers = phnumAdd(numbers, t->forwarding);
+    if (sons->numberOfSons == sons->capacity)
+    {
+        if (!sonsResize(arena, sons, sons->capacity == 0 ? smallSons : numberOfDigits))
+            return false;
+    }
 
-    trieforDeleteNode(t);
+    if (sons->capacity == numberOfDigits)
+    {
+        sons->tab[digit] = son;
+    }
+    else
+    {
+        int i = sons->numberOfSons;
 
-    return numbers;
+        // Mała tablica jest posortowana według cyfr
+        while (i > 0 && sons->keys[i - 1] > digit)
+        {
+            sons->keys[i] = sons->keys[i - 1];
+            sons->tab[i] = sons->tab[i - 1];
+            i--;
+        }
+
+        sons->keys[i] = digit;
+        sons->tab[i] = son;
+    }
+
+    sons->numberOfSons++;
+
+    return true;
 }
 
-/** @brief Usuwa przekierowania z obiektu typu Trie_forward.
+/** @brief Usuwa syna odpowiadającego cyfrze @p digit.
  *
- * Usuwa wszystkie przekierowania, w których parametr @p num jest prefiksem
- * parametru @p num1 użytego przy dodawaniu. Jeśli nie ma takich przekierowań
- * lub napis nie reprezentuje numeru, nic nie robi.  Alokuje strukturę
- * @p PhoneNumbers,która musi być zwolniona za pomocą funkcji @ref phnumDelete.
+ * Gdy synów zostanie mało, pełna tablica jest zamieniana na małą,
+ * a gdy nie zostanie żaden, tablica jest zwalniana.
  *
- * @param[in] t – obiekt typu Trie_forward.
- * @param[in] num – wskaźnik na numer.
- * @return Wskaźnik na strukturę przechowującą numery,
- *         które były przekierowaniami w usuwanych wierzchołkach.
+ * @param[in,out] arena – arena, w której alokowane są tablice.
+ * @param[in,out] sons – wskaźnik na synów węzła.
+ * @param[in] digit – wartość cyfry istniejącego syna.
  */
 
-static struct PhoneNumbers *trieforRemove(Trie_forward t, char *num)
+static void sonsRemove(struct Arena *arena, struct TrieSons *sons, int digit)
 {
-
-    bool removeSub = true;
-
-    struct PhoneNumbers *numbers = phnumNew(4);
-
-    char *numAux = num;
-    Trie_forward tAux = t;
-    unsigned int depth = 0, indeks = 0;
-    size_t len = strlen(num);
-
-    // Schodzenie po drzewie i spamiętywanie co można usunąć
-
-    while(numAux[0] != '\0')
+    if (sons->pinned)
     {
+        sons->tab[digit] = NULL;
+        return;
+    }
 
-        if (t->sons[numAux[0] - zero] != NULL)
-        {
-            if (len-1 == indeks)
-            {
-                if (tAux == NULL)
-                {
-                    tAux = t;
-                    depth = indeks;
-                }
-
-            }
-            else
-            {
-
-                if (t->sons[numAux[0] - zero]->forwarding != NULL)
-                    tAux = NULL;
-                else
-                {
-                    if (t->sons[numAux[0] - zero]->numberOfSons == 1)
-                    {
-                        if (tAux == NULL)
-                        {
-                            tAux = t;
-                            depth = indeks;
-                        }
-                    }
-                    else
-                        tAux = NULL;
-                }
+    if (sons->capacity == numberOfDigits)
+    {
+        sons->tab[digit] = NULL;
+    }
+    else
+    {
+        int i = 0;
 
-            }
+        while (sons->keys[i] != digit)
+            i++;
 
-            t = t->sons[numAux[0] - zero];
-        }
-        else
+        for(; i + 1 < sons->numberOfSons; i++)
         {
-            removeSub = false;
-            break;
+            sons->keys[i] = sons->keys[i + 1];
+            sons->tab[i] = sons->tab[i + 1];
         }
 
-        indeks++;
-        numAux++;
+        sons->tab[i] = NULL;
     }
 
-    //Usuwanie poddrzewa, które można usunąć
-
-    if (removeSub)
-    {
-        numbers = removeSubtree(tAux->sons[num[depth] - zero], numbers);
-        tAux->sons[num[depth] - zero] = NULL;
-        tAux->numberOfSons--;
-    }
+    sons->numberOfSons--;
 
-    return numbers;
+    if (sons->numberOfSons == 0)
+        sonsResize(arena, sons, 0);
+    else if (sons->capacity == numberOfDigits && sons->numberOfSons < smallSons)
+        sonsResize(arena, sons, smallSons);
 }
 
+/** @brief Inicjuje pusty zbiór synów.
+ *
+ * @param[out] sons – wskaźnik na synów węzła.
+ */
 
-// Dostaje już poprawny numer
+static inline void sonsInit(struct TrieSons *sons)
+{
+    sons->tab = NULL;
+    sons->capacity = 0;
+    sons->numberOfSons = 0;
+    sons->pinned = false;
+}
 
-/** @brief Wyznacza przekierowanie numeru.
- * Wyznacza przekierowanie podanego numeru. Szuka najdłuższego pasującego
- * prefiksu. Wynikiem jest co najwyżej jeden numer. Jeśli dany numer nie został
- * przekierowany, to wynikiem jest ten numer. Jeśli podany napis nie
- * reprezentuje numeru, wynikiem jest pusty ciąg. Alokuje strukturę
- * @p PhoneNumbers,która musi być zwolniona za pomocą funkcji @ref phnumDelete.
- * @param[in] t  – obiekt typu Trie_forward;
- * @param[in] num – wskaźnik na napis reprezentujący numer.
- * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
- *         udało się zaalokować pamięci.
+/** @brief Ustala pełną tablicę synów.
+ *
+ * Później dodawanie i usuwanie synów zmienia tylko miejsca ich cyfr, więc
+ * wątki zmieniające synów o różnych cyfrach nie zapisują wspólnych pól.
+ *
+ * @param[in,out] arena – arena, w której alokowane są tablice.
+ * @param[in,out] sons – wskaźnik na synów węzła.
+ * @return Wartość @p true, jeśli ustalono tablicę.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
  */
 
-static struct PhoneNumbers *trieforGet(Trie_forward t, char *num)
+static bool sonsPin(struct Arena *arena, struct TrieSons *sons)
 {
-    struct PhoneNumbers *number = phnumNew(1);
+    if (sons->capacity != numberOfDigits && !sonsResize(arena, sons, numberOfDigits))
+        return false;
 
-    char *s = NULL;
-    char *numAux = num;
-    char *numAux2;
+    sons->pinned = true;
 
-    while(numAux[0] != '\0')
-    {
-        if (t->sons[numAux[0] - zero] != NULL)
-        {
+    return true;
+}
 
-            if (t->sons[numAux[0] - zero]->forwarding != NULL)
-            {
-                s = t->sons[numAux[0] - zero]->forwarding;
-                numAux2 = numAux + 1;
-            }
+/** @brief Kopiuje tablicę synów.
+ *
+ * Kopia wskazuje na tych samych synów co oryginał; wywołujący musi
+ * zwiększyć ich liczniki odwołań.
+ *
+ * @param[in,out] arena – arena, w której alokowane są tablice.
+ * @param[out] copy – wskaźnik na kopię synów.
+ * @param[in] sons – wskaźnik na kopiowanych synów.
+ * @return Wartość @p true, jeśli skopiowano tablicę.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
 
-            t = t->sons[numAux[0] - zero];
-        }
-        else
-            break;
+static bool sonsCopy(struct Arena *arena, struct TrieSons *copy, const struct TrieSons *sons)
+{
+    *copy = *sons;
 
-        numAux++;
-    }
+    if (sons->capacity == 0)
+        return true;
 
+    copy->tab = arenaAlloc(arena, sizeof(void *) * sons->capacity);
 
-    if (s == NULL)
-        s = (char *)copy_number(num);
-    else
-        s = (char *)merge_numbers(s, numAux2);
+    if (copy->tab == NULL)
+        return false;
 
-    number = phnumAdd(number, s);
-    free(s);
+    memcpy(copy->tab, sons->tab, sizeof(void *) * sons->capacity);
 
-    return number;
+    return true;
 }
 
-/** @brief Zwraca przekierowanie numeru wskazanego przez @p num.
- *
- * Tworzy nowy numer i wskaźnik na niego jako przekierowanie @p num.
+///////
+///////
+///////
+// TrieLabel
+
+/** @brief Zwraca cyfry etykiety.
  *
- * @param[in] t – obiekt typu Trie_forward.
- * @param[in] num – wskaźnik na numer.
- * @return Wskaźnik na numer, jeżeli przekierowanie istnieje.
- *         NULL w przeciwnym wypadku.
+ * @param[in] label – wskaźnik na etykietę.
+ * @return Wskaźnik na pierwszą cyfrę etykiety.
  */
 
-static const char * trieforGetForward(Trie_forward t, char *num)
+static inline const char *labelDigits(const struct TrieLabel *label)
 {
-    char *numAux = num;
-
-    while(numAux[0] != '\0')
-    {
-        if (t->sons[numAux[0] - zero] == NULL)
-            return NULL;
-        else
-        {
-            t = t->sons[numAux[0] - zero];
-            numAux++;
-        }
-    }
-
-    if (t->forwarding == NULL)
-        return NULL;
-    else
-        return copy_number(t->forwarding);
+    return label->length <= inlineLabel ? label->digits.inl : label->digits.ptr;
 }
 
-////
-////
-////
-//Trie_reverse
-
-/** @brief Tworzy pusty obiekt typu Trie_reverse
+/** @brief Ustawia etykietę na @p length cyfr wskazywanych przez @p digits.
  *
- * Tworzy pusty obiekt typu Trie_reverse, domyślnie ustawia
- * wskaźniki na synów i forwarding jako NULL.
+ * Poprzednia zawartość etykiety nie jest zwalniana.
  *
- * @return Pusty obiekt typu Trie_forward.
+ * @param[in,out] arena – arena, w której alokowane są długie etykiety.
+ * @param[out] label – wskaźnik na etykietę.
+ * @param[in] digits – wskaźnik na cyfry.
+ * @param[in] length – liczba cyfr.
+ * @return Wartość @p true, jeśli ustawiono etykietę.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
  */
 
-static Trie_reverse trierevNew()
+static bool labelSet(struct Arena *arena, struct TrieLabel *label, const char *digits, size_t length)
 {
-    Trie_reverse t = (Trie_reverse)malloc(sizeof(struct Node_reverse));
+    if (length <= inlineLabel)
+    {
+        memcpy(label->digits.inl, digits, length);
+    }
+    else
+    {
+        char *ptr = arenaAlloc(arena, length);
 
-    t->reverse = phnumNew(1);
-    // Jest numberOfDigits cyfr
-    t->sons = malloc(sizeof(Trie_reverse) * numberOfDigits);
-    t->numberOfSons = 0;
+        if (ptr == NULL)
+            return false;
 
-    for(int i = 0; i < numberOfDigits ; i++)
-    {
-        t->sons[i] =  NULL;
+        memcpy(ptr, digits, length);
+        label->digits.ptr = ptr;
     }
 
-    return t;
+    label->length = length;
+
+    return true;
 }
 
-/** @brief Dealokuje pojedynczy wierzchołek typu Trie_reverse
+/** @brief Zwalnia etykietę i ustawia ją na pustą.
  *
- * @param[in] t – obiekt typu Trie_reverse.
+ * @param[in,out] arena – arena, w której alokowane są długie etykiety.
+ * @param[in,out] label – wskaźnik na etykietę.
  */
 
-static void trierevDeleteNode(Trie_reverse t)
+static void labelFree(struct Arena *arena, struct TrieLabel *label)
 {
-    phnumDelete(t->reverse);
-    free(t->sons);
-    free(t);
+    if (label->length > inlineLabel)
+        arenaFree(arena, label->digits.ptr, label->length);
+
+    label->length = 0;
 }
 
-/** @brief Dealokuje pojedynczy wierzchołek i całe poddrzewo typu Trie_reverse
+/** @brief Wyznacza długość wspólnego prefiksu etykiety i numeru.
  *
- * @param[in] t – obiekt typu Trie_reverse.
+ * @param[in] label – wskaźnik na etykietę.
+ * @param[in] num – wskaźnik na numer (być może pusty).
+ * @return Liczba początkowych cyfr etykiety zgodnych z numerem.
  */
 
-static void trierevDelete(Trie_reverse t)
+static inline size_t labelCommon(const struct TrieLabel *label, const char *num)
 {
-    for(int i = 0; i < numberOfDigits; i++)
-    {
-        if (t->sons[i] != NULL)
-            trierevDelete(t->sons[i]);
-    }
-    trierevDeleteNode(t);
-}
+    const char *digits = labelDigits(label);
+    size_t i = 0;
 
+    while (i < label->length && digits[i] == num[i])
+        i++;
 
-/** @brief Dodaje przekierowanie.
- *
- * Dodaje przekierowanie z numeru wskazywanego przez @p num1
- * na numer wskazywany przez @p num2 do @p t.
+    return i;
+}
+
+/** @brief Dokleja etykietę @p first na początek etykiety @p second.
  *
- * @param[in] t – obiekt typu Trie_reverse.
- * @param[in] num1 – wskaźnik na numer przekierowywany.
- * @param[in] num2 – wskaźnik na numer, który jest przekierowniem z @p num1
- * @return Wartość @p true, jeśli przekierowanie zostało dodane
- *         Wartość @p false, jeśli przekierowanie nie zostało dodane
+ * @param[in,out] arena – arena, w której alokowane są długie etykiety.
+ * @param[in] first – wskaźnik na etykietę doklejaną.
+ * @param[in,out] second – wskaźnik na etykietę wynikową.
+ * @return Wartość @p true, jeśli połączono etykiety.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci
+ *         (etykiety się nie zmieniają).
  */
 
-static bool trierevAdd(Trie_reverse t, char *num1, char *num2)
+static bool labelJoin(struct Arena *arena, const struct TrieLabel *first, struct TrieLabel *second)
 {
-    bool p;
+    struct TrieLabel joined;
+    size_t length = (size_t)first->length + second->length;
+    char *digits = joined.digits.inl;
 
-    if (num1[0] == '\0')
+    if (length > inlineLabel)
     {
-        t->reverse = phnumAdd(t->reverse, num2);
-        p = true;
-    }
-    else
-    {
-        if (t->sons[num1[0] - zero] == NULL)
-        {
-            t->sons[num1[0] - zero] = trierevNew();
-            t->numberOfSons++;
-        }
+        digits = arenaAlloc(arena, length);
 
-        if (t->sons[num1[0] - zero] == NULL)
-            p = false;
-        else
-            p = trierevAdd(t->sons[num1[0] - zero], num1 + 1, num2);
+        if (digits == NULL)
+            return false;
+
+        joined.digits.ptr = digits;
     }
 
-    return p;
-}
+    memcpy(digits, labelDigits(first), first->length);
+    memcpy(digits + first->length, labelDigits(second), second->length);
+    joined.length = length;
 
+    labelFree(arena, second);
+    *second = joined;
 
-/** @brief Usuwa przekierowania z obiektu typu Trie_reverse.
- *
- * Usuwa wszystkie przekierowania numerów ze struktury @p pnum,
- * w których parametr @p num jest prefiksem
- * parametru @p num1 użytego przy dodawaniu. Jeśli nie ma takich przekierowań
- * lub napis nie reprezentuje numeru, nic nie robi.
+    return true;
+}
+
+///////
+///////
+///////
+// NodeStack
+
+/**
+ * @brief Element stosu wierzchołków drzewa.
+ */
+
+struct NodeStackItem
+{
+    void *node; ///< wierzchołek drzewa Trie_forward lub Trie_reverse
+    size_t depth; ///< liczba cyfr na ścieżce od korzenia do wierzchołka
+    unsigned int mask; ///< maska bitowa cyfr na ścieżce od korzenia do wierzchołka
+};
+
+/**
+ * @brief Stos wierzchołków drzewa, zastępujący rekurencję przy przechodzeniu drzew.
+ */
+
+struct NodeStack
+{
+    struct NodeStackItem *tab; ///< elementy stosu
+    size_t size; ///< liczba elementów na stosie
+    size_t capacity; ///< rozmiar tablicy @p tab
+};
+
+/** @brief Dodaje wierzchołek na stos.
  *
- * @param[in] trev – obiekt typu Trie_reverse.
- * @param[in] num – wskaźnik na numer.
- * @param[in] pnum – wskaźnik na strukturę przechowującą numery.
- * @return Wskaźnik na strukturę przechowującą numery,
- *         które były przekierowaniami w usuwanych wierzchołkach.
+ * @param[in,out] stack – wskaźnik na stos.
+ * @param[in] node – wierzchołek drzewa.
+ * @param[in] depth – liczba cyfr na ścieżce od korzenia do wierzchołka.
+ * @param[in] mask – maska bitowa cyfr na ścieżce od korzenia do wierzchołka.
+ * @return Wartość @p true, jeśli wierzchołek został dodany.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool stackPush(struct NodeStack *stack, void *node, size_t depth, unsigned int mask)
+{
+    if (stack->size == stack->capacity)
+    {
+        size_t capacity = stack->capacity == 0 ? 64 : 2 * stack->capacity;
+        struct NodeStackItem *tab = realloc(stack->tab, sizeof(struct NodeStackItem) * capacity);
+
+        if (tab == NULL)
+            return false;
+
+        stack->tab = tab;
+        stack->capacity = capacity;
+    }
+
+    stack->tab[stack->size++] = (struct NodeStackItem){node, depth, mask};
+
+    return true;
+}
+
+///////
+///////
+///////
+// Trie_forward
+
+/** @brief Zwraca syna wierzchołka @p t odpowiadającego cyfrze @p digit.
+ *
+ * @param[in] t – obiekt typu Trie_forward.
+ * @param[in] digit – wartość cyfry.
+ * @return Syn lub NULL, jeżeli nie ma takiego syna.
+ */
+
+static inline Trie_forward trieforSon(Trie_forward t, int digit)
+{
+    return sonsGet(&t->sons, digit);
+}
+
+/** @brief Tworzy pusty obiekt typu Trie_forward
+ *
+ * Tworzy pusty obiekt typu Trie_forward, domyślnie ustawia
+ * wskaźniki na synów i forwarding jako NULL.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowany jest wierzchołek.
+ * @return Pusty obiekt typu Trie_forward lub NULL, gdy nie udało się
+ *         zaalokować pamięci.
+ */
+
+static Trie_forward trieforNew(struct PhoneForward *pf)
+{
+    Trie_forward t = arenaAlloc(&pf->arena, sizeof(struct Node_forward));
+
+    if (t == NULL)
+        return NULL;
+
+    t->label.length = 0;
+    t->forwarding = NULL;
+    t->source = NULL;
+    t->refs = 1;
+    // Tablica synów jest alokowana dopiero przy dodaniu pierwszego syna
+    sonsInit(&t->sons);
+
+    return t;
+}
+
+/** @brief Dealokuje pojedynczy wierzchołek typu Trie_forward
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołek.
+ * @param[in] t – obiekt typu Trie_forward.
+ */
+
+static void trieforDeleteNode(struct PhoneForward *pf, Trie_forward t)
+{
+    labelFree(&pf->arena, &t->label);
+    arenaFree(&pf->arena, t->sons.tab, sizeof(void *) * t->sons.capacity);
+    poolRelease(&pf->numbers, t->forwarding);
+    poolRelease(&pf->numbers, t->source);
+    arenaFree(&pf->arena, t, sizeof(struct Node_forward));
+}
+
+/** @brief Zapewnia, że wierzchołek nie jest współdzielony z migawkami.
+ *
+ * Jeżeli wierzchołek zapisany w @p slot jest współdzielony, to zastępuje go
+ * tam kopią, która współdzieli z nim synów i numery z puli.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowane są wierzchołki.
+ * @param[in,out] slot – miejsce, w którym zapisany jest wierzchołek.
+ * @return Niewspółdzielony wierzchołek zapisany w @p slot lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
  */
 
-static void trierevRemove(Trie_reverse trev, struct PhoneNumbers *pnum, const char *num)
+static Trie_forward trieforOwn(struct PhoneForward *pf, void **slot)
 {
-    bool removeSub;
-    char *numAux;
-    Trie_reverse tAux = NULL, t = trev;
-    unsigned int depth, indeks = 0;
-    size_t len = strlen(num);
+    Trie_forward t = *slot;
+
+    if (t->refs == 1)
+        return t;
+
+    Trie_forward copy = arenaAlloc(&pf->arena, sizeof(struct Node_forward));
+
+    if (copy == NULL)
+        return NULL;
+
+    *copy = *t;
+    copy->refs = 1;
+
+    if (!sonsCopy(&pf->arena, &copy->sons, &t->sons))
+    {
+        arenaFree(&pf->arena, copy, sizeof(struct Node_forward));
+        return NULL;
+    }
+
+    if (!labelSet(&pf->arena, &copy->label, labelDigits(&t->label), t->label.length))
+    {
+        arenaFree(&pf->arena, copy->sons.tab, sizeof(void *) * copy->sons.capacity);
+        arenaFree(&pf->arena, copy, sizeof(struct Node_forward));
+        return NULL;
+    }
+
+    for(int i = 0; i < copy->sons.capacity; i++)
+    {
+        Trie_forward son = copy->sons.tab[i];
+
+        if (son != NULL)
+            son->refs++;
+    }
 
-    for(int k = 0; k < pnum->size; k++)
+    if (copy->forwarding != NULL)
     {
-        numAux = (char *)pnum->tab[k];
-        tAux = trev;
-        t = trev;
-        depth = 0;
-        indeks = 0;
-        len = strlen(pnum->tab[k]);
-        removeSub = true;
+        poolRetain(copy->forwarding);
+        poolRetain(copy->source);
+    }
+
+    t->refs--;
+    *slot = copy;
+
+    return copy;
+}
+
+/** @brief Zwalnia odwołanie do drzewa Trie_forward.
+ *
+ * Usuwa wierzchołki, do których nie ma już odwołań, razem z ich poddrzewami.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in] t – obiekt typu Trie_forward.
+ */
 
-        // Schodzenie w drzewie i spamiętywanie co można usunąć
+static void trieforRelease(struct PhoneForward *pf, Trie_forward t)
+{
+    struct NodeStack stack = {NULL, 0, 0};
 
-        while(numAux[0] != '\0')
+    while (t != NULL)
+    {
+        if (--t->refs == 0)
         {
-            // Sprawdzam, czy już usunąłem to
-            if (t->sons[numAux[0] - zero] != NULL)
+            for(int i = 0; i < t->sons.capacity; i++)
             {
-                if (len-1 == indeks)
-                {
-                    if (tAux == NULL)
-                    {
-                        tAux = t;
-                        depth = indeks;
-                    }
-                }
-                else
-                {
-                    if (t->sons[numAux[0] - zero]->reverse->size > 0)
-                        tAux = NULL;
-                    else
-                    {
-                        if (t->reverse->size == 0 && (t->sons[numAux[0] - zero]->numberOfSons == 1 || t->sons[numAux[0] - zero]->numberOfSons == 0) )
-                        {
-                            if (tAux == NULL)
-                            {
-                                tAux = t;
-                                depth = indeks;
-                            }
-                        }
-                        else
-                            tAux = NULL;
-                    }
-                }
+                // Przy braku pamięci poddrzewo syna zostaje w arenie do usunięcia struktury
+                if (t->sons.tab[i] != NULL)
+                    stackPush(&stack, t->sons.tab[i], 0, 0);
+            }
 
-                t = t->sons[numAux[0] - zero];
+            trieforDeleteNode(pf, t);
+        }
 
-                indeks++;
-                numAux++;
-            }
-            else
+        t = stack.size > 0 ? stack.tab[--stack.size].node : NULL;
+    }
+
+    free(stack.tab);
+}
+
+/** @brief Dodaje przekierowanie.
+ *
+ * Dodaje przekierowanie z numeru wskazywanego przez @p num1
+ * na numer wskazywany przez @p num2 do @p t. Jeżeli @p num1 kończy się
+ * w środku krawędzi, to krawędź jest rozdzielana nowym wierzchołkiem.
+ * Współdzielone wierzchołki na ścieżce są zastępowane kopiami.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowane są wierzchołki.
+ * @param[in] t – niewspółdzielony obiekt typu Trie_forward.
+ * @param[in] num1 – wskaźnik na numer przekierowywany.
+ * @param[in] source – wskaźnik na numer z puli równy @p num1.
+ * @param[in] num2 – wskaźnik na numer z puli, który jest przekierowniem z @p num1;
+ *                   jeżeli przekierowanie zostanie dodane, to drzewo przejmuje
+ *                   odwołanie do niego
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane
+ *         Wartość @p false, jeśli przekierowanie nie zostało dodane
+ */
+
+static bool trieforAdd(struct PhoneForward *pf, Trie_forward t, char *num1, char const *source, char const *num2)
+{
+    while (num1[0] != '\0')
+    {
+        void **slot = sonsSlot(&t->sons, num1[0] - zero);
+
+        if (slot == NULL)
+        {
+            // Cała reszta numeru staje się etykietą nowego liścia
+            Trie_forward son = trieforNew(pf);
+
+            if (son == NULL || !labelSet(&pf->arena, &son->label, num1, strlen(num1))
+                || !sonsAdd(&pf->arena, &t->sons, num1[0] - zero, son))
             {
-                removeSub = false;
-                break;
+                if (son != NULL)
+                    trieforDeleteNode(pf, son);
+
+                return false;
             }
+
+            t = son;
+            break;
         }
 
-        if (removeSub)
-        {
+        Trie_forward son = trieforOwn(pf, slot);
 
-            // chcemy usunąć z tablicy reverse rzeczy, które musimy
+        if (son == NULL)
+            return false;
+
+        size_t k = labelCommon(&son->label, num1);
 
-            int idx = 0, iter;
-            int *tab = malloc(sizeof(int) * t->reverse->size);
+        if (k < son->label.length)
+        {
+            // Rozdziela krawędź, nowy wierzchołek dostaje wspólny początek etykiety
+            Trie_forward mid = trieforNew(pf);
+            struct TrieLabel rest;
+            int digit = labelDigits(&son->label)[k] - zero;
 
-            for(int i = 0; i < t->reverse->size; i++)
+            if (mid == NULL || !labelSet(&pf->arena, &mid->label, num1, k))
             {
-                iter = 0;
+                if (mid != NULL)
+                    trieforDeleteNode(pf, mid);
 
-                while(num[iter] != '\0' && t->reverse->tab[i][iter] != '\0')
-                {
-                    if (num[iter] != t->reverse->tab[i][iter])
-                    {
-                        iter = 0;
-                        break;
-                    }
-                    iter++;
-                }
+                return false;
+            }
 
-                if (num[iter] == '\0')
-                {
-                    tab[idx] = i;
-                    idx++;
-                }
+            if (!labelSet(&pf->arena, &rest, labelDigits(&son->label) + k, son->label.length - k))
+            {
+                trieforDeleteNode(pf, mid);
+                return false;
             }
 
-            for(int i = idx - 1; i >= 0; i--)
+            if (!sonsAdd(&pf->arena, &mid->sons, digit, son))
             {
-                t->reverse = phnumRemove(t->reverse, tab[i]);
+                labelFree(&pf->arena, &rest);
+                trieforDeleteNode(pf, mid);
+                return false;
             }
 
-            free(tab);
+            labelFree(&pf->arena, &son->label);
+            son->label = rest;
+            *slot = mid;
+            son = mid;
+        }
 
-            //Usuwanie poddrzewa
+        t = son;
+        num1 += k;
+    }
 
-            if (t->reverse->size == 0 && t->numberOfSons == 0)
-            {
-                trierevDelete(tAux->sons[pnum->tab[k][depth] - zero]);
-                tAux->sons[pnum->tab[k][depth] - zero] = NULL;
-                tAux->numberOfSons--;
-            }
+    // Numery w puli są unikalne, więc wierzchołek z przekierowaniem ma już source
+    if (t->forwarding == NULL)
+        t->source = poolRetain(source);
+
+    poolRelease(&pf->numbers, t->forwarding);
+    t->forwarding = num2;
+
+    return true;
+}
+
+/**
+ * @brief Przekierowanie usunięte z drzewa Trie_forward.
+ */
+
+struct RemovedRule
+{
+    char const *source; ///< numer z puli, który był przekierowywany
+    char const *target; ///< numer z puli, na który było przekierowanie
+};
+
+/**
+ * @brief Tablica przekierowań usuniętych z drzewa Trie_forward.
+ * Przekierowania w tablicy przejmują odwołania do numerów z puli.
+ */
+
+struct RemovedRules
+{
+    struct RemovedRule *tab; ///< przekierowania
+    size_t size; ///< liczba przekierowań
+    size_t capacity; ///< rozmiar tablicy @p tab
+};
+
+/** @brief Dodaje przekierowanie do tablicy usuniętych przekierowań.
+ *
+ * @param[in,out] rules – wskaźnik na tablicę usuniętych przekierowań.
+ * @param[in] source – numer z puli, który był przekierowywany.
+ * @param[in] target – numer z puli, na który było przekierowanie.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool rulesAdd(struct RemovedRules *rules, char const *source, char const *target)
+{
+    if (rules->size == rules->capacity)
+    {
+        size_t capacity = rules->capacity == 0 ? 16 : 2 * rules->capacity;
+        struct RemovedRule *tab = realloc(rules->tab, sizeof(struct RemovedRule) * capacity);
+
+        if (tab == NULL)
+            return false;
+
+        rules->tab = tab;
+        rules->capacity = capacity;
+    }
+
+    rules->tab[rules->size++] = (struct RemovedRule){source, target};
+
+    return true;
+}
+
+/** @brief Dodaje do tablicy przekierowania z poddrzewa współdzielonego z migawką.
+ *
+ * Poddrzewo zostaje w migawce, więc tablica dostaje nowe odwołania do numerów.
+ *
+ * @param[in] t – obiekt typu Trie_forward.
+ * @param[in,out] rules – wskaźnik na tablicę usuniętych przekierowań.
+ */
+
+static void collectRules(Trie_forward t, struct RemovedRules *rules)
+{
+    struct NodeStack stack = {NULL, 0, 0};
+
+    while (t != NULL)
+    {
+        for(int i = 0; i < t->sons.capacity; i++)
+        {
+            if (t->sons.tab[i] != NULL)
+                stackPush(&stack, t->sons.tab[i], 0, 0);
+        }
 
+        if (t->forwarding != NULL && rulesAdd(rules, t->source, t->forwarding))
+        {
+            poolRetain(t->source);
+            poolRetain(t->forwarding);
         }
 
+        t = stack.size > 0 ? stack.tab[--stack.size].node : NULL;
     }
+
+    free(stack.tab);
 }
 
+/** @brief Usuwa wierzchołek @p t i jego poddrzewo.
+ *
+ * Usuwa wierzchołek @p t i jego poddrzewo, a przekierowania, które
+ * znajdowały się w usuwanych wierzchołkach, dodaje do tablicy
+ * wskazywanej przez @p rules. Przechodzi poddrzewo za pomocą stosu, więc
+ * nie zależy od głębokości drzewa. Poddrzewa współdzielone z migawkami
+ * tylko tracą jedno odwołanie.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in] t – obiekt typu Trie_forward.
+ * @param[in,out] rules – wskaźnik na tablicę usuniętych przekierowań.
+ */
+
+static void removeSubtree(struct PhoneForward *pf, Trie_forward t, struct RemovedRules *rules)
+{
+    struct NodeStack stack = {NULL, 0, 0};
 
-/** @brief Usuwa jendo przekierowanie z obiektu typu Trie_reverse.
+    while (t != NULL)
+    {
+        if (t->refs > 1)
+        {
+            t->refs--;
+            collectRules(t, rules);
+            t = stack.size > 0 ? stack.tab[--stack.size].node : NULL;
+            continue;
+        }
+
+        for(int i = 0; i < t->sons.capacity; i++)
+        {
+            // Przy braku pamięci poddrzewo syna zostaje w arenie do usunięcia struktury
+            if (t->sons.tab[i] != NULL)
+                stackPush(&stack, t->sons.tab[i], 0, 0);
+        }
+
+        // Odwołania do numerów z puli przechodzą na tablicę rules
+        if (t->forwarding != NULL && rulesAdd(rules, t->source, t->forwarding))
+        {
+            t->forwarding = NULL;
+            t->source = NULL;
+        }
+
+        trieforDeleteNode(pf, t);
+
+        t = stack.size > 0 ? stack.tab[--stack.size].node : NULL;
+    }
+
+    free(stack.tab);
+}
+
+/** @brief Scala wierzchołek z jego jedynym synem.
  *
- * Usuwa przekierowanie z numeru wskazywanego przez @p num
- * na numer wskazywany przez @p num2
+ * Jeżeli wierzchołek zapisany w @p slot nie ma przekierowania i ma dokładnie
+ * jednego syna, to jest zastępowany tym synem, a ich etykiety są łączone.
  *
- * @param[in] trev – obiekt typu Trie_reverse.
- * @param[in] num – wskaźnik na numer, z którego przekierowujemy.
- * @param[in] num2 – wskaźnik na numer, który jest przekirowanie.
- * @return Wskaźnik na strukturę przechowującą numery,
- *         które były przekierowaniami w usuwanych wierzchołkach.
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in,out] slot – miejsce w tablicy synów, w którym zapisany jest
+ *                       niewspółdzielony wierzchołek.
  */
 
-static void trierevRemoveOne(Trie_reverse trev, const char *num, const char *num2)
+static void trieforCompress(struct PhoneForward *pf, void **slot)
 {
-    bool removeSub;
-    char *numAux;
-    Trie_reverse tAux = NULL, t = trev;
-    unsigned int depth, indeks = 0;
-    size_t len;
+    Trie_forward t = *slot;
 
-    numAux = (char *)num;
-    tAux = trev;
-    t = trev;
-    depth = 0;
-    indeks = 0;
-    len = strlen(num);
-    removeSub = true;
+    if (t->forwarding != NULL || t->sons.numberOfSons != 1)
+        return;
 
-    while(numAux[0] != '\0')
+    // Etykieta syna się zmienia, więc nie może być współdzielony
+    Trie_forward son = trieforOwn(pf, sonsOnlySlot(&t->sons));
+
+    if (son != NULL && labelJoin(&pf->arena, &t->label, &son->label))
     {
-        // Sprawdzam, czy już usunąłem to
-        if (t->sons[numAux[0] - zero] != NULL)
+        *slot = son;
+        trieforDeleteNode(pf, t);
+    }
+}
+
+/** @brief Usuwa przekierowania z obiektu typu Trie_forward.
+ *
+ * Usuwa wszystkie przekierowania, w których parametr @p num jest prefiksem
+ * parametru @p num1 użytego przy dodawaniu. Jeśli nie ma takich przekierowań
+ * lub napis nie reprezentuje numeru, nic nie robi. Usunięte przekierowania
+ * dodaje do tablicy @p rules, która przejmuje odwołania do ich numerów z puli.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in] t – niewspółdzielony obiekt typu Trie_forward.
+ * @param[in] num – wskaźnik na numer.
+ * @param[in,out] rules – wskaźnik na tablicę usuniętych przekierowań.
+ */
+
+static void trieforRemove(struct PhoneForward *pf, Trie_forward t, char *num, struct RemovedRules *rules)
+{
+    void **tSlot = NULL;
+
+    // Schodzenie po drzewie do krawędzi, na której kończy się num
+
+    while (true)
+    {
+        void **slot = sonsSlot(&t->sons, num[0] - zero);
+
+        if (slot == NULL)
+            return;
+
+        Trie_forward son = *slot;
+        size_t k = labelCommon(&son->label, num);
+
+        if (num[k] == '\0')
         {
-            if (len-1 == indeks)
-            {
-                if (tAux == NULL)
-                {
-                    tAux = t;
-                    depth = indeks;
-                }
-            }
-            else
-            {
-                if (t->sons[numAux[0] - zero]->reverse->size > 0)
-                    tAux = NULL;
-                else
-                {
-                    if (t->reverse->size == 0 && (t->sons[numAux[0] - zero]->numberOfSons == 1 || t->sons[numAux[0] - zero]->numberOfSons == 0) )
-                    {
-                        if (tAux == NULL)
-                        {
-                            tAux = t;
-                            depth = indeks;
-                        }
-                    }
-                    else
-                        tAux = NULL;
-                }
-            }
+            // Wszystkie numery w poddrzewie syna mają prefiks num
+            removeSubtree(pf, son, rules);
+            sonsRemove(&pf->arena, &t->sons, num[0] - zero);
+
+            if (tSlot != NULL)
+                trieforCompress(pf, tSlot);
+
+            return;
+        }
+
+        if (k < son->label.length)
+            return;
+
+        // Wierzchołki na ścieżce mogą się zmienić, więc nie mogą być współdzielone
+        son = trieforOwn(pf, slot);
+
+        if (son == NULL)
+            return;
+
+        tSlot = slot;
+        t = son;
+        num += k;
+    }
+}
+
+
+// Dostaje już poprawny numer
+
+/** @brief Wyznacza przekierowanie numeru bez alokowania pamięci.
+ * Szuka najdłuższego prefiksu @p num, dla którego istnieje przekierowanie,
+ * i zapisuje w @p view numer z puli, na który jest przekierowanie, oraz
+ * niedopasowany sufiks @p num. Jeśli numer nie został przekierowany, to
+ * prefiks jest pusty, a sufiksem jest cały @p num.
+ * @param[in] t  – obiekt typu Trie_forward;
+ * @param[in] num – wskaźnik na napis reprezentujący numer;
+ * @param[out] view – wskaźnik na strukturę, w której zapisywany jest wynik.
+ */
+
+static void trieforGetView(Trie_forward t, char const *num, struct PhoneForwardView *view)
+{
+    char const *forward = NULL;
+    char const *numAux = num;
+    char const *numAux2 = num;
+
+    while (true)
+    {
+        if (t->forwarding != NULL)
+        {
+            forward = t->forwarding;
+            numAux2 = numAux;
+        }
+
+        if (numAux[0] == '\0')
+            break;
+
+        Trie_forward son = trieforSon(t, numAux[0] - zero);
+
+        // Krawędź musi pasować w całości
+        if (son == NULL || labelCommon(&son->label, numAux) < son->label.length)
+            break;
+
+        numAux += son->label.length;
+        t = son;
+    }
+
+    view->prefix = forward == NULL ? "" : forward;
+    view->prefixLength = forward == NULL ? 0 : poolLength(forward);
+    view->suffix = numAux2;
+}
+
+/**
+ * @brief Wierzchołek na ścieżce przechodzonej przez @ref trieforGetBatch.
+ */
+
+struct BatchStep
+{
+    Trie_forward node; ///< wierzchołek drzewa
+    size_t depth; ///< liczba cyfr numeru dopasowanych do wierzchołka włącznie
+    char const *forward; ///< najgłębsze przekierowanie na ścieżce do wierzchołka lub NULL
+    size_t forwardDepth; ///< liczba cyfr numeru dopasowanych do wierzchołka z przekierowaniem @p forward
+};
+
+/** @brief Porównuje numery wskazywane przez elementy tablicy numerów.
+ *
+ * @param[in] a – wskaźnik na element tablicy wskaźników na numery.
+ * @param[in] b – wskaźnik na element tablicy wskaźników na numery.
+ * @return Wynik funkcji strcmp dla wskazywanych numerów.
+ */
+
+static int comparePointed(const void *a, const void *b)
+{
+    return strcmp(**(char const *const *const *) a, **(char const *const *const *) b);
+}
+
+/** @brief Wyznacza przekierowania wielu numerów naraz.
+ * Przechodzi numery w porządku leksykograficznym i trzyma na stosie ścieżkę
+ * w drzewie dla poprzedniego numeru, więc dla każdego numeru schodzi tylko
+ * poniżej najdłuższego prefiksu wspólnego z poprzednim numerem.
+ * @param[in] t – obiekt typu Trie_forward;
+ * @param[in] sorted – wskaźniki na poprawne numery, posortowane leksykograficznie;
+ * @param[in] count – liczba numerów w @p sorted;
+ * @param[in] nums – tablica numerów, na którą wskazują elementy @p sorted;
+ * @param[out] views – tablica wyników, indeksowana tak jak @p nums.
+ * @return Wartość @p true, jeśli wyznaczono przekierowania.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool trieforGetBatch(Trie_forward t, char const *const **sorted, size_t count,
+                            char const *const *nums, struct PhoneForwardView *views)
+{
+    size_t capacity = 16, size = 1;
+    struct BatchStep *path = malloc(capacity * sizeof(struct BatchStep));
+
+    if (path == NULL)
+        return false;
+
+    path[0] = (struct BatchStep){t, 0, NULL, 0};
+
+    char const *previous = "";
+
+    for(size_t i = 0; i < count; i++)
+    {
+        char const *num = *sorted[i];
+        size_t common = 0, matched = path[size - 1].depth;
+
+        // Wystarczy porównać cyfry dopasowane już do ścieżki w drzewie
+        while (common < matched && num[common] == previous[common])
+            common++;
+
+        // Zostają tylko wierzchołki, do których ścieżka jest prefiksem num
+        while (path[size - 1].depth > common)
+            size--;
+
+        while (true)
+        {
+            struct BatchStep *top = &path[size - 1];
+
+            if (num[top->depth] == '\0')
+                break;
+
+            Trie_forward son = trieforSon(top->node, num[top->depth] - zero);
+
+            // Krawędź musi pasować w całości
+            if (son == NULL || labelCommon(&son->label, num + top->depth) < son->label.length)
+                break;
+
+            if (size == capacity)
+            {
+                struct BatchStep *newPath = realloc(path, 2 * capacity * sizeof(struct BatchStep));
+
+                if (newPath == NULL)
+                {
+                    free(path);
+                    return false;
+                }
+
+                path = newPath;
+                capacity *= 2;
+                top = &path[size - 1];
+            }
+
+            size_t depth = top->depth + son->label.length;
+
+            if (son->forwarding != NULL)
+                path[size] = (struct BatchStep){son, depth, son->forwarding, depth};
+            else
+                path[size] = (struct BatchStep){son, depth, top->forward, top->forwardDepth};
+
+            size++;
+        }
+
+        struct BatchStep *top = &path[size - 1];
+        struct PhoneForwardView *view = &views[sorted[i] - nums];
+
+        view->prefix = top->forward == NULL ? "" : top->forward;
+        view->prefixLength = top->forward == NULL ? 0 : poolLength(top->forward);
+        view->suffix = num + top->forwardDepth;
+
+        previous = num;
+    }
+
+    free(path);
+
+    return true;
+}
+
+/** @brief Zwraca przekierowanie numeru wskazanego przez @p num.
+ *
+ * Zwraca numer z puli, na który przekierowywany jest dokładnie @p num,
+ * bez kopiowania go.
+ *
+ * @param[in] t – obiekt typu Trie_forward.
+ * @param[in] num – wskaźnik na numer.
+ * @return Wskaźnik na numer, jeżeli przekierowanie istnieje.
+ *         NULL w przeciwnym wypadku.
+ */
+
+static const char * trieforGetForward(Trie_forward t, char *num)
+{
+    char *numAux = num;
+
+    while(numAux[0] != '\0')
+    {
+        Trie_forward son = trieforSon(t, numAux[0] - zero);
+
+        if (son == NULL || labelCommon(&son->label, numAux) < son->label.length)
+            return NULL;
+
+        t = son;
+        numAux += son->label.length;
+    }
+
+    return t->forwarding;
+}
+
+////
+////
+////
+//ReverseEntry
+
+/**
+ * Maksymalna wysokość drzewa AVL numerów. Drzewo AVL o wysokości h ma co
+ * najmniej F(h+2)-1 węzłów, więc wysokość 64 wystarcza dla każdej liczby
+ * numerów mieszczącej się w pamięci.
+ */
+#define entryMaxHeight 64
+
+/**
+ * @brief Iterator po numerach drzewa AVL w kolejności rosnącej.
+ */
+
+struct EntryIterator
+{
+    struct ReverseEntry *stack[entryMaxHeight]; ///< węzły, których numery nie zostały jeszcze zwrócone
+    int size; ///< liczba węzłów na stosie
+};
+
+/** @brief Zwraca wysokość poddrzewa.
+ *
+ * @param[in] e – wskaźnik na korzeń poddrzewa lub NULL.
+ * @return Wysokość poddrzewa, 0 dla pustego poddrzewa.
+ */
+
+static inline int entryHeight(const struct ReverseEntry *e)
+{
+    return e == NULL ? 0 : e->height;
+}
+
+/** @brief Przelicza wysokość węzła na podstawie wysokości synów.
+ *
+ * @param[in,out] e – wskaźnik na węzeł.
+ */
+
+static inline void entryUpdate(struct ReverseEntry *e)
+{
+    int left = entryHeight(e->left), right = entryHeight(e->right);
+
+    e->height = (left > right ? left : right) + 1;
+}
+
+/** @brief Zapewnia, że węzeł drzewa AVL nie jest współdzielony z migawkami.
+ *
+ * Jeżeli węzeł zapisany w @p slot jest współdzielony, to zastępuje go tam
+ * kopią, która współdzieli z nim synów i numer z puli.
+ *
+ * @param[in,out] arena – arena, w której alokowane są węzły drzewa.
+ * @param[in,out] slot – miejsce, w którym zapisany jest niepusty węzeł.
+ * @return Niewspółdzielony węzeł zapisany w @p slot lub NULL, gdy nie udało
+ *         się zaalokować pamięci.
+ */
+
+static struct ReverseEntry *entryOwn(struct Arena *arena, struct ReverseEntry **slot)
+{
+    struct ReverseEntry *e = *slot;
+
+    if (e->refs == 1)
+        return e;
+
+    struct ReverseEntry *copy = arenaAlloc(arena, sizeof(struct ReverseEntry));
+
+    if (copy == NULL)
+        return NULL;
+
+    *copy = *e;
+    copy->refs = 1;
+    poolRetain(copy->number);
+
+    if (copy->left != NULL)
+        copy->left->refs++;
+
+    if (copy->right != NULL)
+        copy->right->refs++;
+
+    e->refs--;
+    *slot = copy;
+
+    return copy;
+}
+
+/** @brief Obraca poddrzewo w prawo.
+ *
+ * @param[in,out] e – wskaźnik na korzeń poddrzewa z niepustym lewym synem.
+ * @return Nowy korzeń poddrzewa.
+ */
+
+static struct ReverseEntry *entryRotateRight(struct ReverseEntry *e)
+{
+    struct ReverseEntry *left = e->left;
+
+    e->left = left->right;
+    left->right = e;
+    entryUpdate(e);
+    entryUpdate(left);
+
+    return left;
+}
+
+/** @brief Obraca poddrzewo w lewo.
+ *
+ * @param[in,out] e – wskaźnik na korzeń poddrzewa z niepustym prawym synem.
+ * @return Nowy korzeń poddrzewa.
+ */
+
+static struct ReverseEntry *entryRotateLeft(struct ReverseEntry *e)
+{
+    struct ReverseEntry *right = e->right;
+
+    e->right = right->left;
+    right->left = e;
+    entryUpdate(e);
+    entryUpdate(right);
+
+    return right;
+}
+
+/** @brief Przywraca zrównoważenie poddrzewa.
+ * Zakłada, że wysokości synów @p e różnią się co najwyżej o 2, a ich
+ * poddrzewa są zrównoważone. Obracane węzły, które są współdzielone
+ * z migawkami, są najpierw zastępowane kopiami; jeżeli nie uda się
+ * zaalokować kopii, poddrzewo zostaje niezrównoważone, ale poprawne.
+ *
+ * @param[in,out] arena – arena, w której alokowane są węzły drzewa.
+ * @param[in,out] e – wskaźnik na niewspółdzielony korzeń poddrzewa.
+ * @return Nowy korzeń poddrzewa.
+ */
+
+static struct ReverseEntry *entryBalance(struct Arena *arena, struct ReverseEntry *e)
+{
+    int balance = entryHeight(e->left) - entryHeight(e->right);
+
+    if (balance > 1 && entryOwn(arena, &e->left) != NULL)
+    {
+        if (entryHeight(e->left->left) < entryHeight(e->left->right))
+        {
+            if (entryOwn(arena, &e->left->right) == NULL)
+            {
+                entryUpdate(e);
+                return e;
+            }
+
+            e->left = entryRotateLeft(e->left);
+        }
+
+        return entryRotateRight(e);
+    }
+
+    if (balance < -1 && entryOwn(arena, &e->right) != NULL)
+    {
+        if (entryHeight(e->right->right) < entryHeight(e->right->left))
+        {
+            if (entryOwn(arena, &e->right->left) == NULL)
+            {
+                entryUpdate(e);
+                return e;
+            }
+
+            e->right = entryRotateRight(e->right);
+        }
+
+        return entryRotateLeft(e);
+    }
+
+    entryUpdate(e);
+
+    return e;
+}
+
+/** @brief Równoważy węzły na ścieżce od korzenia.
+ * Kończy, gdy poddrzewo węzła nie zmieniło się, bo wtedy wyższe węzły
+ * też są zrównoważone.
+ *
+ * @param[in,out] arena – arena, w której alokowane są węzły drzewa.
+ * @param[in,out] path – miejsca, w których zapisane są wskaźniki na
+ *                       niewspółdzielone węzły ścieżki, od korzenia w dół;
+ * @param[in] size – długość ścieżki.
+ */
+
+static void entryRebalance(struct Arena *arena, struct ReverseEntry **path[], int size)
+{
+    for(int i = size - 1; i >= 0; i--)
+    {
+        struct ReverseEntry *e = *path[i];
+        int height = e->height;
+
+        *path[i] = entryBalance(arena, e);
+
+        if (*path[i] == e && e->height == height)
+            break;
+    }
+}
+
+/** @brief Dodaje numer do drzewa AVL.
+ *
+ * @param[in,out] arena – arena, w której alokowane są węzły drzewa.
+ * @param[in,out] root – wskaźnik na miejsce, w którym zapisany jest korzeń drzewa.
+ * @param[in] num – wskaźnik na numer, którego nie ma jeszcze w drzewie.
+ * @return Wartość @p true, jeśli numer został dodany.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool entryInsert(struct Arena *arena, struct ReverseEntry **root, char const *num)
+{
+    struct ReverseEntry **path[entryMaxHeight];
+    struct ReverseEntry **slot = root;
+    int size = 0;
+
+    while (*slot != NULL)
+    {
+        // Węzły na ścieżce się zmieniają, więc nie mogą być współdzielone
+        if (entryOwn(arena, slot) == NULL)
+            return false;
+
+        path[size++] = slot;
+        slot = strcmp(num, (*slot)->number) < 0 ? &(*slot)->left : &(*slot)->right;
+    }
+
+    struct ReverseEntry *e = arenaAlloc(arena, sizeof(struct ReverseEntry));
+
+    if (e == NULL)
+        return false;
+
+    e->number = num;
+    e->left = e->right = NULL;
+    e->height = 1;
+    e->refs = 1;
+    *slot = e;
+
+    entryRebalance(arena, path, size);
+
+    return true;
+}
+
+/** @brief Usuwa numer z drzewa AVL.
+ *
+ * @param[in,out] arena – arena, w której alokowane są węzły drzewa.
+ * @param[in,out] root – wskaźnik na miejsce, w którym zapisany jest korzeń drzewa.
+ * @param[in] num – wskaźnik na numer.
+ * @return Wskaźnik na usunięty numer z drzewa lub NULL, jeżeli nie było
+ *         w nim numeru równego @p num albo nie udało się zaalokować
+ *         kopii współdzielonych węzłów.
+ */
+
+static char const *entryErase(struct Arena *arena, struct ReverseEntry **root, char const *num)
+{
+    struct ReverseEntry **path[entryMaxHeight];
+    struct ReverseEntry **slot = root;
+    int size = 0;
+
+    while (*slot != NULL)
+    {
+        if (entryOwn(arena, slot) == NULL)
+            return NULL;
+
+        int cmp = strcmp(num, (*slot)->number);
+
+        if (cmp == 0)
+            break;
+
+        path[size++] = slot;
+        slot = cmp < 0 ? &(*slot)->left : &(*slot)->right;
+    }
+
+    struct ReverseEntry *e = *slot;
+
+    if (e == NULL)
+        return NULL;
+
+    char const *erased = e->number;
+
+    if (e->left != NULL && e->right != NULL)
+    {
+        // Numer węzła zastępujemy następnikiem, a usuwamy węzeł następnika
+        path[size++] = slot;
+        slot = &e->right;
+
+        while (entryOwn(arena, slot) != NULL && (*slot)->left != NULL)
+        {
+            path[size++] = slot;
+            slot = &(*slot)->left;
+        }
+
+        if ((*slot)->refs > 1)
+            return NULL;
+
+        e->number = (*slot)->number;
+        e = *slot;
+    }
+
+    *slot = e->left != NULL ? e->left : e->right;
+    arenaFree(arena, e, sizeof(struct ReverseEntry));
+
+    entryRebalance(arena, path, size);
+
+    return erased;
+}
+
+/** @brief Odkłada na stos iteratora lewą ścieżkę poddrzewa.
+ *
+ * @param[in,out] it – wskaźnik na iterator.
+ * @param[in] e – korzeń poddrzewa lub NULL.
+ */
+
+static inline void entryPushLeft(struct EntryIterator *it, struct ReverseEntry *e)
+{
+    for(; e != NULL; e = e->left)
+        it->stack[it->size++] = e;
+}
+
+/** @brief Ustawia iterator na najmniejszym numerze drzewa.
+ *
+ * @param[out] it – wskaźnik na iterator.
+ * @param[in] root – korzeń drzewa AVL lub NULL.
+ */
+
+static inline void entryIterInit(struct EntryIterator *it, struct ReverseEntry *root)
+{
+    it->size = 0;
+    entryPushLeft(it, root);
+}
+
+/** @brief Zwraca kolejny numer drzewa w kolejności rosnącej.
+ *
+ * @param[in,out] it – wskaźnik na iterator.
+ * @return Wskaźnik na numer lub NULL, jeżeli zwrócono już wszystkie numery.
+ */
+
+static inline char const *entryIterNext(struct EntryIterator *it)
+{
+    if (it->size == 0)
+        return NULL;
+
+    struct ReverseEntry *e = it->stack[--it->size];
+
+    entryPushLeft(it, e->right);
+
+    return e->number;
+}
+
+/** @brief Zwalnia odwołanie do drzewa AVL.
+ * Usuwa węzły, do których nie ma już odwołań, i dla każdego ich numeru
+ * zwalnia odwołanie do niego w puli.
+ *
+ * @param[in,out] arena – arena, w której alokowane są węzły drzewa.
+ * @param[in,out] pool – pula, z której pochodzą numery.
+ * @param[in] root – korzeń drzewa AVL lub NULL.
+ */
+
+static void entryDestroy(struct Arena *arena, struct NumberPool *pool, struct ReverseEntry *root)
+{
+    // Na stosie jest co najwyżej jeden oczekujący węzeł na każdym poziomie drzewa
+    struct ReverseEntry *stack[entryMaxHeight + 1];
+    int size = 0;
+
+    if (root != NULL)
+        stack[size++] = root;
+
+    while (size > 0)
+    {
+        struct ReverseEntry *e = stack[--size];
+
+        if (--e->refs > 0)
+            continue;
+
+        if (e->right != NULL)
+            stack[size++] = e->right;
+
+        if (e->left != NULL)
+            stack[size++] = e->left;
+
+        poolRelease(pool, e->number);
+        arenaFree(arena, e, sizeof(struct ReverseEntry));
+    }
+}
+
+/** @brief Tworzy zrównoważone drzewo AVL z posortowanych numerów.
+ * Korzeniem jest środkowy numer, więc wysokości poddrzew różnią się
+ * co najwyżej o jeden, a głębokość rekurencji jest równa wysokości drzewa.
+ * Drzewo przejmuje odwołania do numerów.
+ *
+ * @param[in,out] arena – arena, w której alokowane są węzły drzewa.
+ * @param[in] numbers – numery z puli posortowane rosnąco, bez powtórzeń.
+ * @param[in] n – liczba numerów.
+ * @param[out] root – wskaźnik na miejsce, w którym zapisywany jest korzeń drzewa.
+ * @return Wartość @p true, jeśli utworzono drzewo.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool entryBuild(struct Arena *arena, char const *const *numbers, size_t n, struct ReverseEntry **root)
+{
+    *root = NULL;
+
+    if (n == 0)
+        return true;
+
+    struct ReverseEntry *e = arenaAlloc(arena, sizeof(struct ReverseEntry));
+
+    if (e == NULL)
+        return false;
+
+    e->number = numbers[n / 2];
+    e->left = e->right = NULL;
+    e->refs = 1;
+    *root = e;
+
+    if (!entryBuild(arena, numbers, n / 2, &e->left) || !entryBuild(arena, numbers + n / 2 + 1, n - n / 2 - 1, &e->right))
+        return false;
+
+    entryUpdate(e);
+
+    return true;
+}
+
+////
+////
+////
+//Trie_reverse
+
+/** @brief Zwraca syna wierzchołka @p t odpowiadającego cyfrze @p digit.
+ *
+ * @param[in] t – obiekt typu Trie_reverse.
+ * @param[in] digit – wartość cyfry.
+ * @return Syn lub NULL, jeżeli nie ma takiego syna.
+ */
+
+static inline Trie_reverse trierevSon(Trie_reverse t, int digit)
+{
+    return sonsGet(&t->sons, digit);
+}
+
+/** @brief Tworzy pusty obiekt typu Trie_reverse
+ *
+ * Tworzy pusty obiekt typu Trie_reverse, domyślnie ustawia
+ * wskaźniki na synów i reverse jako NULL.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowany jest wierzchołek.
+ * @return Pusty obiekt typu Trie_reverse lub NULL, gdy nie udało się
+ *         zaalokować pamięci.
+ */
+
+static Trie_reverse trierevNew(struct PhoneForward *pf)
+{
+    Trie_reverse t = arenaAlloc(&pf->arena, sizeof(struct Node_reverse));
+
+    if (t == NULL)
+        return NULL;
+
+    t->label.length = 0;
+    t->reverse = NULL;
+    t->reverseSize = 0;
+    t->refs = 1;
+    // Tablica synów jest alokowana dopiero przy dodaniu pierwszego syna
+    sonsInit(&t->sons);
+
+    return t;
+}
+
+/** @brief Dodaje numer do drzewa reverse wierzchołka.
+ * Dodaje numer z puli wskazywany przez @p num do drzewa numerów
+ * przekierowywanych na wierzchołek @p t. Jeżeli numer został dodany, to
+ * drzewo przejmuje odwołanie do niego.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowane jest drzewo.
+ * @param[in,out] t – obiekt typu Trie_reverse.
+ * @param[in] num – wskaźnik na numer z puli.
+ * @return Wartość @p true, jeśli numer został dodany.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool trierevAddNumber(struct PhoneForward *pf, Trie_reverse t, char const *num)
+{
+    if (!entryInsert(&pf->arena, &t->reverse, num))
+        return false;
+
+    t->reverseSize++;
+
+    return true;
+}
+
+/** @brief Zwalnia całe drzewo reverse wierzchołka.
+ * Zwalnia też odwołania do wszystkich numerów z drzewa.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano drzewo.
+ * @param[in,out] t – obiekt typu Trie_reverse.
+ */
+
+static void trierevFreeNumbers(struct PhoneForward *pf, Trie_reverse t)
+{
+    entryDestroy(&pf->arena, &pf->numbers, t->reverse);
+    t->reverse = NULL;
+    t->reverseSize = 0;
+}
+
+/** @brief Usuwa numer z drzewa reverse wierzchołka.
+ * Usuwa numer równy @p num z drzewa wierzchołka @p t i zwalnia odwołanie
+ * do niego.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano drzewo.
+ * @param[in,out] t – obiekt typu Trie_reverse.
+ * @param[in] num – wskaźnik na numer, który jest w drzewie.
+ */
+
+static void trierevRemoveNumber(struct PhoneForward *pf, Trie_reverse t, char const *num)
+{
+    char const *erased = entryErase(&pf->arena, &t->reverse, num);
+
+    if (erased != NULL)
+    {
+        poolRelease(&pf->numbers, erased);
+        t->reverseSize--;
+    }
+}
+
+/** @brief Dealokuje pojedynczy wierzchołek typu Trie_reverse
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołek.
+ * @param[in] t – obiekt typu Trie_reverse.
+ */
+
+static void trierevDeleteNode(struct PhoneForward *pf, Trie_reverse t)
+{
+    labelFree(&pf->arena, &t->label);
+    trierevFreeNumbers(pf, t);
+    arenaFree(&pf->arena, t->sons.tab, sizeof(void *) * t->sons.capacity);
+    arenaFree(&pf->arena, t, sizeof(struct Node_reverse));
+}
+
+/** @brief Zapewnia, że wierzchołek nie jest współdzielony z migawkami.
+ *
+ * Jeżeli wierzchołek zapisany w @p slot jest współdzielony, to zastępuje go
+ * tam kopią, która współdzieli z nim synów i drzewo reverse.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowane są wierzchołki.
+ * @param[in,out] slot – miejsce, w którym zapisany jest wierzchołek.
+ * @return Niewspółdzielony wierzchołek zapisany w @p slot lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+
+static Trie_reverse trierevOwn(struct PhoneForward *pf, void **slot)
+{
+    Trie_reverse t = *slot;
+
+    if (t->refs == 1)
+        return t;
+
+    Trie_reverse copy = arenaAlloc(&pf->arena, sizeof(struct Node_reverse));
+
+    if (copy == NULL)
+        return NULL;
+
+    *copy = *t;
+    copy->refs = 1;
+
+    if (!sonsCopy(&pf->arena, &copy->sons, &t->sons))
+    {
+        arenaFree(&pf->arena, copy, sizeof(struct Node_reverse));
+        return NULL;
+    }
+
+    if (!labelSet(&pf->arena, &copy->label, labelDigits(&t->label), t->label.length))
+    {
+        arenaFree(&pf->arena, copy->sons.tab, sizeof(void *) * copy->sons.capacity);
+        arenaFree(&pf->arena, copy, sizeof(struct Node_reverse));
+        return NULL;
+    }
+
+    for(int i = 0; i < copy->sons.capacity; i++)
+    {
+        Trie_reverse son = copy->sons.tab[i];
+
+        if (son != NULL)
+            son->refs++;
+    }
+
+    if (copy->reverse != NULL)
+        copy->reverse->refs++;
+
+    t->refs--;
+    *slot = copy;
+
+    return copy;
+}
+
+/** @brief Zwalnia odwołanie do drzewa Trie_reverse.
+ *
+ * Usuwa wierzchołki, do których nie ma już odwołań, razem z ich poddrzewami.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in] t – obiekt typu Trie_reverse.
+ */
+
+static void trierevRelease(struct PhoneForward *pf, Trie_reverse t)
+{
+    struct NodeStack stack = {NULL, 0, 0};
+
+    while (t != NULL)
+    {
+        if (--t->refs == 0)
+        {
+            for(int i = 0; i < t->sons.capacity; i++)
+            {
+                // Przy braku pamięci poddrzewo syna zostaje w arenie do usunięcia struktury
+                if (t->sons.tab[i] != NULL)
+                    stackPush(&stack, t->sons.tab[i], 0, 0);
+            }
+
+            trierevDeleteNode(pf, t);
+        }
+
+        t = stack.size > 0 ? stack.tab[--stack.size].node : NULL;
+    }
+
+    free(stack.tab);
+}
+
+/** @brief Wylicza maskę bitową cyfr napisu.
+ *
+ * @param[in] digits – wskaźnik na cyfry.
+ * @param[in] length – liczba cyfr.
+ * @return Maska, w której bit o numerze cyfry jest ustawiony, jeżeli ta cyfra występuje w napisie.
+ */
+
+static unsigned int digitMask(const char *digits, size_t length)
+{
+    unsigned int mask = 0;
+
+    for(size_t i = 0; i < length; i++)
+        mask |= 1u << (digits[i] - zero);
+
+    return mask;
+}
+
+/** @brief Sprawdza, czy któryś przodek wierzchołka ma niepuste drzewo reverse.
+ *
+ * @param[in] t – korzeń drzewa Trie_reverse.
+ * @param[in] num – wskaźnik na numer, który reprezentuje wierzchołek w drzewie.
+ * @return Wartość @p true, jeżeli któryś wierzchołek na ścieżce do @p num,
+ *         poza nim samym, ma niepuste drzewo reverse.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+
+static bool trierevCovered(Trie_reverse t, const char *num)
+{
+    while (num[0] != '\0')
+    {
+        if (t->reverse != NULL)
+            return true;
+
+        Trie_reverse son = trierevSon(t, num[0] - zero);
+
+        if (son == NULL || labelCommon(&son->label, num) < son->label.length)
+            return false;
+
+        t = son;
+        num += son->label.length;
+    }
+
+    return false;
+}
+
+/** @brief Dodaje wierzchołek do indeksu najpłytszych niepustych wierzchołków lub go usuwa.
+ *
+ * W trybie współbieżnym zakłada muteks indeksu. Jeżeli nie udało się
+ * zaalokować pamięci, indeks jest oznaczany jako nieaktualny i budowany
+ * od nowa przy następnym liczeniu. Nieaktualny indeks nie jest zmieniany.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą indeks.
+ * @param[in] depth – głębokość wierzchołka.
+ * @param[in] mask – maska cyfr na ścieżce do wierzchołka.
+ * @param[in] add – czy wierzchołek jest dodawany.
+ * @return Wartość @p true, jeśli indeks jest aktualny.
+ *         Wartość @p false, jeśli indeks jest nieaktualny.
+ */
+
+static bool shallowestUpdate(struct PhoneForward *pf, size_t depth, unsigned int mask, bool add)
+{
+    if (pf->shards != NULL)
+        pthread_mutex_lock(&pf->shards->shared);
+
+    if (pf->indexed && add)
+        pf->indexed = countIndexAdd(&pf->shallowest, depth, mask);
+    else if (pf->indexed)
+        countIndexRemove(&pf->shallowest, depth, mask);
+
+    bool indexed = pf->indexed;
+
+    if (pf->shards != NULL)
+        pthread_mutex_unlock(&pf->shards->shared);
+
+    return indexed;
+}
+
+/** @brief Oznacza indeks najpłytszych niepustych wierzchołków jako nieaktualny.
+ *
+ * W trybie współbieżnym zakłada muteks indeksu.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą indeks.
+ */
+
+static void shallowestInvalidate(struct PhoneForward *pf)
+{
+    if (pf->shards != NULL)
+        pthread_mutex_lock(&pf->shards->shared);
+
+    pf->indexed = false;
+
+    if (pf->shards != NULL)
+        pthread_mutex_unlock(&pf->shards->shared);
+}
+
+/** @brief Aktualizuje indeks najpłytszych niepustych wierzchołków.
+ *
+ * Wywoływana, gdy drzewo reverse wierzchołka @p t stało się niepuste
+ * (@p entering ma wartość @p true) lub puste. Jeżeli żaden przodek @p t nie
+ * ma przekierowań, to @p t zastępuje w indeksie najpłytsze niepuste
+ * wierzchołki swojego poddrzewa albo one zastępują @p t. Koszt jest
+ * proporcjonalny do liczby wierzchołków poddrzewa leżących nad nimi.
+ * Jeżeli nie udało się zaalokować pamięci, to indeks, zmieniony tylko
+ * częściowo, jest oznaczany jako nieaktualny (zob. @ref shallowestUpdate).
+ *
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą indeks.
+ * @param[in] t – obiekt typu Trie_reverse.
+ * @param[in] num – wskaźnik na numer, który reprezentuje @p t w drzewie.
+ * @param[in] entering – czy drzewo reverse @p t stało się niepuste.
+ */
+
+static void trierevUpdateShallowest(struct PhoneForward *pf, Trie_reverse t, const char *num, bool entering)
+{
+    if (trierevCovered(pf->trev, num))
+        return;
+
+    size_t depth = strlen(num);
+    unsigned int mask = digitMask(num, depth);
+    struct NodeStack stack = {NULL, 0, 0};
+    bool ok = shallowestUpdate(pf, depth, mask, entering) && stackPush(&stack, t, depth, mask);
+
+    while (ok && stack.size > 0)
+    {
+        struct NodeStackItem item = stack.tab[--stack.size];
+        Trie_reverse v = item.node;
+
+        if (v != t && v->reverse != NULL)
+        {
+            ok = shallowestUpdate(pf, item.depth, item.mask, !entering);
+
+            continue;
+        }
+
+        for(int i = 0; ok && i < v->sons.capacity; i++)
+        {
+            Trie_reverse son = v->sons.tab[i];
+
+            if (son != NULL)
+                ok = stackPush(&stack, son, item.depth + son->label.length,
+                               item.mask | digitMask(labelDigits(&son->label), son->label.length));
+        }
+    }
+
+    free(stack.tab);
+
+    if (!ok)
+        shallowestInvalidate(pf);
+}
+
+/** @brief Buduje indeks najpłytszych niepustych wierzchołków drzewa.
+ *
+ * @param[in] t – korzeń drzewa typu Trie_reverse.
+ * @param[out] index – wskaźnik na indeks, który nie był jeszcze zainicjowany.
+ * @return Wartość @p true, jeśli zbudowano indeks.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci (indeks
+ *         jest wtedy pusty).
+ */
+
+static bool trierevIndex(Trie_reverse t, struct CountIndex *index)
+{
+    struct NodeStack stack = {NULL, 0, 0};
+    bool ok = stackPush(&stack, t, 0, 0);
+
+    countIndexInit(index);
+
+    while (ok && stack.size > 0)
+    {
+        struct NodeStackItem item = stack.tab[--stack.size];
+        Trie_reverse v = item.node;
+
+        if (v->reverse != NULL)
+        {
+            ok = countIndexAdd(index, item.depth, item.mask);
+            continue;
+        }
+
+        for(int i = 0; ok && i < v->sons.capacity; i++)
+        {
+            Trie_reverse son = v->sons.tab[i];
+
+            if (son != NULL)
+                ok = stackPush(&stack, son, item.depth + son->label.length,
+                               item.mask | digitMask(labelDigits(&son->label), son->label.length));
+        }
+    }
+
+    free(stack.tab);
+
+    if (!ok)
+        countIndexDestroy(index);
+
+    return ok;
+}
+
+/** @brief Dodaje przekierowanie.
+ *
+ * Dodaje przekierowanie z numeru wskazywanego przez @p num1
+ * na numer wskazywany przez @p num2 do @p t. Jeżeli @p num1 kończy się
+ * w środku krawędzi, to krawędź jest rozdzielana nowym wierzchołkiem.
+ * Współdzielone wierzchołki na ścieżce są zastępowane kopiami.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowane są wierzchołki.
+ * @param[in] t – niewspółdzielony obiekt typu Trie_reverse.
+ * @param[in] num1 – wskaźnik na numer, na który jest przekierowanie.
+ * @param[in] num2 – wskaźnik na numer z puli, który jest przekierowywany na @p num1;
+ *                   jeżeli przekierowanie zostanie dodane, to drzewo przejmuje
+ *                   odwołanie do niego
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane
+ *         Wartość @p false, jeśli przekierowanie nie zostało dodane
+ */
+
+static bool trierevAdd(struct PhoneForward *pf, Trie_reverse t, char *num1, char const *num2)
+{
+    char *num = num1;
+
+    while (num1[0] != '\0')
+    {
+        void **slot = sonsSlot(&t->sons, num1[0] - zero);
+
+        if (slot == NULL)
+        {
+            // Cała reszta numeru staje się etykietą nowego liścia
+            Trie_reverse son = trierevNew(pf);
+
+            if (son == NULL || !labelSet(&pf->arena, &son->label, num1, strlen(num1))
+                || !sonsAdd(&pf->arena, &t->sons, num1[0] - zero, son))
+            {
+                if (son != NULL)
+                    trierevDeleteNode(pf, son);
+
+                return false;
+            }
+
+            t = son;
+            break;
+        }
+
+        Trie_reverse son = trierevOwn(pf, slot);
+
+        if (son == NULL)
+            return false;
+
+        size_t k = labelCommon(&son->label, num1);
+
+        if (k < son->label.length)
+        {
+            // Rozdziela krawędź, nowy wierzchołek dostaje wspólny początek etykiety
+            Trie_reverse mid = trierevNew(pf);
+            struct TrieLabel rest;
+            int digit = labelDigits(&son->label)[k] - zero;
+
+            if (mid == NULL || !labelSet(&pf->arena, &mid->label, num1, k))
+            {
+                if (mid != NULL)
+                    trierevDeleteNode(pf, mid);
+
+                return false;
+            }
+
+            if (!labelSet(&pf->arena, &rest, labelDigits(&son->label) + k, son->label.length - k))
+            {
+                trierevDeleteNode(pf, mid);
+                return false;
+            }
+
+            if (!sonsAdd(&pf->arena, &mid->sons, digit, son))
+            {
+                labelFree(&pf->arena, &rest);
+                trierevDeleteNode(pf, mid);
+                return false;
+            }
+
+            labelFree(&pf->arena, &son->label);
+            son->label = rest;
+            *slot = mid;
+            son = mid;
+        }
+
+        t = son;
+        num1 += k;
+    }
+
+    if (!trierevAddNumber(pf, t, num2))
+        return false;
+
+    if (t->reverseSize == 1)
+        trierevUpdateShallowest(pf, t, num, true);
+
+    return true;
+}
+
+
+/** @brief Scala wierzchołek z jego jedynym synem.
+ *
+ * Jeżeli wierzchołek zapisany w @p slot nie ma numerów w drzewie reverse
+ * i ma dokładnie jednego syna, to jest zastępowany tym synem, a ich
+ * etykiety są łączone.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in,out] slot – miejsce w tablicy synów, w którym zapisany jest wierzchołek.
+ */
+
+static void trierevCompress(struct PhoneForward *pf, void **slot)
+{
+    Trie_reverse t = *slot;
+
+    if (t->reverse != NULL || t->sons.numberOfSons != 1)
+        return;
+
+    // Etykieta syna się zmienia, więc nie może być współdzielony
+    Trie_reverse son = trierevOwn(pf, sonsOnlySlot(&t->sons));
+
+    if (son != NULL && labelJoin(&pf->arena, &t->label, &son->label))
+    {
+        *slot = son;
+        trierevDeleteNode(pf, t);
+    }
+}
+
+/** @brief Znajduje wierzchołek odpowiadający numerowi @p num.
+ *
+ * Współdzielone wierzchołki na ścieżce są zastępowane kopiami, bo wywołujący
+ * zmienia znaleziony wierzchołek i jego ojca.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowane są wierzchołki.
+ * @param[in] t – niewspółdzielony korzeń drzewa typu Trie_reverse.
+ * @param[in] num – wskaźnik na numer.
+ * @param[out] parentSlot – miejsce, w którym zapisany jest ojciec znalezionego
+ *                          wierzchołka lub NULL, jeżeli ojcem jest korzeń.
+ * @param[out] slot – miejsce, w którym zapisany jest znaleziony wierzchołek.
+ * @return Znaleziony wierzchołek lub NULL, jeżeli nie ma go w drzewie albo
+ *         nie udało się zaalokować pamięci.
+ */
+
+static Trie_reverse trierevFind(struct PhoneForward *pf, Trie_reverse t, const char *num,
+                                void ***parentSlot, void ***slot)
+{
+    *parentSlot = NULL;
+    *slot = NULL;
+
+    while (num[0] != '\0')
+    {
+        void **sonSlot = sonsSlot(&t->sons, num[0] - zero);
+
+        if (sonSlot == NULL)
+            return NULL;
+
+        Trie_reverse son = *sonSlot;
+
+        if (labelCommon(&son->label, num) < son->label.length)
+            return NULL;
+
+        son = trierevOwn(pf, sonSlot);
+
+        if (son == NULL)
+            return NULL;
+
+        *parentSlot = *slot;
+        *slot = sonSlot;
+        t = son;
+        num += son->label.length;
+    }
+
+    return t;
+}
+
+/** @brief Usuwa niepotrzebny wierzchołek po opróżnieniu jego drzewa reverse.
+ *
+ * Wierzchołek bez synów jest usuwany z drzewa (a jego ojciec ewentualnie
+ * scalany z pozostałym synem), a wierzchołek z jednym synem jest z nim scalany.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in] trev – niewspółdzielony korzeń drzewa typu Trie_reverse.
+ * @param[in,out] parentSlot – miejsce, w którym zapisany jest ojciec wierzchołka
+ *                             lub NULL, jeżeli ojcem jest korzeń.
+ * @param[in,out] slot – miejsce, w którym zapisany jest wierzchołek.
+ */
+
+static void trierevPrune(struct PhoneForward *pf, Trie_reverse trev, void **parentSlot, void **slot)
+{
+    Trie_reverse t = *slot;
+
+    if (t->reverse != NULL)
+        return;
+
+    if (t->sons.numberOfSons == 0)
+    {
+        Trie_reverse parent = parentSlot != NULL ? *parentSlot : trev;
+
+        sonsRemove(&pf->arena, &parent->sons, labelDigits(&t->label)[0] - zero);
+        trierevDeleteNode(pf, t);
+
+        if (parentSlot != NULL)
+            trierevCompress(pf, parentSlot);
+    }
+    else
+    {
+        trierevCompress(pf, slot);
+    }
+}
+
+/** @brief Usuwa przekierowania z obiektu typu Trie_reverse.
+ *
+ * Dla każdego przekierowania z tablicy @p rules usuwa jego numer
+ * przekierowywany z drzewa reverse wierzchołka, na który było
+ * przekierowanie. Koszt jest proporcjonalny do liczby usuwanych przekierowań.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in] trev – niewspółdzielony obiekt typu Trie_reverse.
+ * @param[in] rules – wskaźnik na tablicę przekierowań usuniętych z drzewa Trie_forward.
+ */
+
+static void trierevRemove(struct PhoneForward *pf, Trie_reverse trev, const struct RemovedRules *rules)
+{
+    for(size_t k = 0; k < rules->size; k++)
+    {
+        void **parentSlot, **slot;
+        Trie_reverse t = trierevFind(pf, trev, rules->tab[k].target, &parentSlot, &slot);
+
+        if (t == NULL || t->reverse == NULL)
+            continue;
+
+        trierevRemoveNumber(pf, t, rules->tab[k].source);
+
+        if (t->reverse == NULL)
+            trierevUpdateShallowest(pf, t, rules->tab[k].target, false);
+
+        //Usuwanie niepotrzebnych wierzchołków
+
+        trierevPrune(pf, trev, parentSlot, slot);
+    }
+}
+
+/** @brief Usuwa jendo przekierowanie z obiektu typu Trie_reverse.
+ *
+ * Usuwa przekierowanie z numeru wskazywanego przez @p num
+ * na numer wskazywany przez @p num2
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie zaalokowano wierzchołki.
+ * @param[in] trev – niewspółdzielony obiekt typu Trie_reverse.
+ * @param[in] num – wskaźnik na numer, na który przekierowujemy.
+ * @param[in] num2 – wskaźnik na numer z puli, który jest przekierowywany.
+ */
+
+static void trierevRemoveOne(struct PhoneForward *pf, Trie_reverse trev, const char *num, const char *num2)
+{
+    void **parentSlot, **slot;
+    Trie_reverse t = trierevFind(pf, trev, num, &parentSlot, &slot);
+
+    if (t == NULL || t->reverse == NULL)
+        return;
+
+    trierevRemoveNumber(pf, t, num2);
+
+    if (t->reverse == NULL)
+        trierevUpdateShallowest(pf, t, num, false);
+
+    //Usuwanie niepotrzebnych wierzchołków
+
+    trierevPrune(pf, trev, parentSlot, slot);
+}
+
+
+/**
+ * @brief Kandydat na wynik zapytania reverse.
+ *
+ * Reprezentuje numer @p source, po którym następuje @p suffix, bez
+ * tworzenia go w pamięci.
+ */
+
+struct ReverseCandidate
+{
+    char const *source; ///< numer przekierowywany na prefiks zapytania
+    size_t sourceLength; ///< długość @p source
+    char const *suffix; ///< niedopasowana końcówka numeru z zapytania
+    size_t suffixLength; ///< długość @p suffix
+};
+
+/** @brief Zwraca znak kandydata o zadanym indeksie.
+ *
+ * @param[in] c – wskaźnik na kandydata.
+ * @param[in] i – indeks znaku, nie większy niż długość kandydata.
+ * @return Znak kandydata lub '\0', jeżeli @p i jest równe jego długości.
+ */
+
+static inline unsigned char candidateAt(const struct ReverseCandidate *c, size_t i)
+{
+    return i < c->sourceLength ? c->source[i] : c->suffix[i - c->sourceLength];
+}
+
+/** @brief Porównuje leksykograficznie dwóch kandydatów.
+ *
+ * @param[in] a – wskaźnik na kandydata.
+ * @param[in] b – wskaźnik na kandydata.
+ * @return Wartość mniejszą od 0, jeżeli a < b.
+ *         Wartość 0, jeżeli a = b.
+ *         Wartość większą od 0, jeżeli a > b.
+ */
+
+static int compareCandidates(const struct ReverseCandidate *a, const struct ReverseCandidate *b)
+{
+    size_t i = a->sourceLength < b->sourceLength ? a->sourceLength : b->sourceLength;
+    int result = memcmp(a->source, b->source, i);
+
+    if (result != 0)
+        return result;
+
+    while (true)
+    {
+        unsigned char x = candidateAt(a, i), y = candidateAt(b, i);
+
+        if (x != y)
+            return x < y ? -1 : 1;
+
+        if (x == '\0')
+            return 0;
+
+        i++;
+    }
+}
+
+/** @brief Sortuje kandydatów, scalając posortowane serie.
+ *
+ * Dzieli tablicę na maksymalne posortowane serie i scala sąsiednie serie
+ * parami, aż zostanie jedna. Numery z drzew reverse są dodawane w porządku
+ * rosnącym, więc serii jest niewiele więcej niż wierzchołków na ścieżce
+ * zapytania.
+ *
+ * @param[in,out] cand – tablica kandydatów.
+ * @param[in] n – liczba kandydatów.
+ * @return Wartość @p true, jeśli posortowano kandydatów.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool sortCandidates(struct ReverseCandidate *cand, size_t n)
+{
+    struct ReverseCandidate *tmp = malloc(sizeof(struct ReverseCandidate) * n);
+    size_t *runs = malloc(sizeof(size_t) * (n + 1));
+
+    if (tmp == NULL || runs == NULL)
+    {
+        free(tmp);
+        free(runs);
+        return false;
+    }
+
+    size_t runCount = 0;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        if (i == 0 || compareCandidates(&cand[i - 1], &cand[i]) > 0)
+            runs[runCount++] = i;
+    }
+
+    runs[runCount] = n;
+
+    struct ReverseCandidate *src = cand, *dst = tmp;
+
+    while (runCount > 1)
+    {
+        size_t newCount = 0;
+
+        for(size_t r = 0; r < runCount; r += 2)
+        {
+            size_t lo = runs[r], mid = runs[r + 1];
+            size_t hi = r + 2 <= runCount ? runs[r + 2] : mid;
+            size_t i = lo, j = mid, k = lo;
+
+            while (i < mid && j < hi)
+            {
+                if (compareCandidates(&src[j], &src[i]) < 0)
+                    dst[k++] = src[j++];
+                else
+                    dst[k++] = src[i++];
+            }
+
+            memcpy(dst + k, src + i, sizeof(struct ReverseCandidate) * (mid - i));
+            k += mid - i;
+            memcpy(dst + k, src + j, sizeof(struct ReverseCandidate) * (hi - j));
+
+            runs[newCount++] = lo;
+        }
+
+        runs[newCount] = n;
+        runCount = newCount;
+
+        struct ReverseCandidate *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != cand)
+        memcpy(cand, src, sizeof(struct ReverseCandidate) * n);
+
+    free(tmp);
+    free(runs);
+
+    return true;
+}
+
+/** @brief Zapewnia miejsce na @p needed kandydatów.
+ *
+ * @param[in,out] cand – wskaźnik na tablicę kandydatów.
+ * @param[in,out] capacity – wskaźnik na rozmiar tablicy.
+ * @param[in] needed – potrzebna liczba kandydatów.
+ * @return Wartość @p true, jeśli tablica mieści @p needed kandydatów.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci (tablica
+ *         się wtedy nie zmienia).
+ */
+
+static bool candidatesReserve(struct ReverseCandidate **cand, size_t *capacity, size_t needed)
+{
+    if (needed <= *capacity)
+        return true;
+
+    size_t newCapacity = *capacity;
+
+    while (needed > newCapacity)
+        newCapacity *= 2;
+
+    struct ReverseCandidate *newCand = realloc(*cand, sizeof(struct ReverseCandidate) * newCapacity);
+
+    if (newCand == NULL)
+        return false;
+
+    *cand = newCand;
+    *capacity = newCapacity;
+
+    return true;
+}
+
+/** @brief Tworzy wynik zapytania reverse z kandydatów.
+ *
+ * Sortuje kandydatów i tworzy każdy z różnych numerów tylko raz.
+ * Zwalnia tablicę @p cand.
+ *
+ * @param[in] cand – tablica kandydatów.
+ * @param[in] size – liczba kandydatów.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+
+static struct PhoneNumbers *candidatesNumbers(struct ReverseCandidate *cand, size_t size)
+{
+    struct PhoneNumbers *numbers = NULL;
+
+    if (sortCandidates(cand, size))
+        numbers = phnumNew(size);
+
+    if (numbers == NULL || numbers->tab == NULL)
+    {
+        free(cand);
+        phnumDelete(numbers);
+        return NULL;
+    }
+
+    for(size_t i = 0; i < size; i++)
+    {
+        // Równe numery są po posortowaniu sąsiednie
+        if (i > 0 && compareCandidates(&cand[i - 1], &cand[i]) == 0)
+            continue;
+
+        char *number = malloc(cand[i].sourceLength + cand[i].suffixLength + 1);
+
+        if (number == NULL)
+        {
+            free(cand);
+            phnumDelete(numbers);
+            return NULL;
+        }
+
+        memcpy(number, cand[i].source, cand[i].sourceLength);
+        memcpy(number + cand[i].sourceLength, cand[i].suffix, cand[i].suffixLength + 1);
+        numbers->tab[numbers->size++] = number;
+    }
+
+    free(cand);
+
+    return numbers;
+}
+
+/** @brief Wyznacza przekierowania na prefiksy danego numeru w drzewie @p t.
+ * Wyznacza wszystkie przekierowania na pefiksy danego numeru @p num. Wynikowy ciąg zawiera też
+ * dany numer. Wynikowe numery są posortowane leksykograficznie i nie mogą się
+ * powtarzać. Kandydaci są zbierani z drzew reverse wierzchołków
+ * na ścieżce @p num, scalani bez tworzenia numerów, a każdy wynikowy numer
+ * jest tworzony tylko raz. Alokuje strukturę @p PhoneNumbers, która musi być
+ * zwolniona za pomocą funkcji @ref phnumDelete.
+ * @param[in] t  – obiket typu Trie_reverse.
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+
+static struct PhoneNumbers *trierevReverse(Trie_reverse t, char *num)
+{
+    size_t len = strlen(num), size = 1, capacity = 16;
+    struct ReverseCandidate *cand = malloc(sizeof(struct ReverseCandidate) * capacity);
+
+    if (cand == NULL)
+        return NULL;
+
+    cand[0] = (struct ReverseCandidate){num, len, num + len, 0};
+
+    char *numAux = num;
+
+    while(numAux[0] != '\0')
+    {
+        Trie_reverse son = trierevSon(t, numAux[0] - zero);
+
+        // Krawędź musi pasować w całości
+        if (son == NULL || labelCommon(&son->label, numAux) < son->label.length)
+            break;
+
+        t = son;
+        numAux += son->label.length;
+
+        if (t->reverse == NULL)
+            continue;
+
+        if (!candidatesReserve(&cand, &capacity, size + t->reverseSize))
+        {
+            free(cand);
+            return NULL;
+        }
+
+        size_t suffixLength = len - (numAux - num);
+
+        struct EntryIterator it;
+        char const *source;
+
+        entryIterInit(&it, t->reverse);
+
+        while ((source = entryIterNext(&it)) != NULL)
+            cand[size++] = (struct ReverseCandidate){source, poolLength(source), numAux, suffixLength};
+    }
+
+    return candidatesNumbers(cand, size);
+}
+
+///////
+///////
+///////
+// FrozenForward
+
+// Układ bloku jest formatem pliku, więc struktury nie mogą mieć niejawnego wyrównania
+_Static_assert(sizeof(struct FrozenForward) == 96, "FrozenForward layout");
+_Static_assert(sizeof(struct FrozenCountEntry) == 24, "FrozenCountEntry layout");
+_Static_assert(sizeof(struct FrozenNode) == 24, "FrozenNode layout");
+_Static_assert(sizeof(struct FrozenNumber) == 8, "FrozenNumber layout");
+
+/** @brief Zwraca wskaźnik na miejsce bloku zamrożonej struktury.
+ *
+ * @param[in] f – wskaźnik na nagłówek zamrożonej struktury.
+ * @param[in] offset – położenie liczone od początku bloku.
+ * @return Wskaźnik na miejsce bloku.
+ */
+
+static inline const void *frozenAt(const struct FrozenForward *f, uint64_t offset)
+{
+    return (const char *)f + offset;
+}
+
+/** @brief Zwraca syna wierzchołka zamrożonego drzewa odpowiadającego cyfrze @p digit.
+ *
+ * @param[in] nodes – tablica wierzchołków drzewa.
+ * @param[in] t – wskaźnik na wierzchołek z tablicy @p nodes.
+ * @param[in] digit – wartość cyfry.
+ * @return Wskaźnik na syna lub NULL, jeżeli nie ma takiego syna.
+ */
+
+static inline const struct FrozenNode *frozenSon(const struct FrozenNode *nodes, const struct FrozenNode *t,
+                                                 int digit)
+{
+    unsigned int bit = 1u << digit;
+
+    if ((t->sonMask & bit) == 0)
+        return NULL;
+
+    // Synowie leżą obok siebie, więc indeks syna to liczba mniejszych cyfr synów
+    return &nodes[t->sons + __builtin_popcount(t->sonMask & (bit - 1))];
+}
+
+/** @brief Sprawdza, czy etykieta wierzchołka zamrożonego drzewa jest prefiksem @p num.
+ *
+ * @param[in] labels – tablica etykiet.
+ * @param[in] t – wskaźnik na wierzchołek, którego pierwsza cyfra etykiety
+ *                jest równa pierwszej cyfrze @p num.
+ * @param[in] num – wskaźnik na numer.
+ * @return Wartość @p true, jeżeli etykieta jest prefiksem @p num.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+
+static inline bool frozenMatch(const char *labels, const struct FrozenNode *t, const char *num)
+{
+    const char *digits = labels + t->label;
+
+    // Koniec numeru ('\0') nie jest równy żadnej cyfrze, więc nie trzeba znać jego długości
+    for(uint32_t i = 1; i < t->labelLength; i++)
+    {
+        if (digits[i] != num[i])
+            return false;
+    }
+
+    return true;
+}
+
+/** @brief Wyznacza przekierowanie numeru w zamrożonej strukturze.
+ * Działa tak jak @ref trieforGetView.
+ * @param[in] f  – wskaźnik na nagłówek zamrożonej struktury;
+ * @param[in] num – wskaźnik na napis reprezentujący numer;
+ * @param[out] view – wskaźnik na strukturę, w której zapisywany jest wynik.
+ */
+
+static void frozenGetView(const struct FrozenForward *f, char const *num, struct PhoneForwardView *view)
+{
+    const struct FrozenNode *nodes = frozenAt(f, f->forwardOffset);
+    const char *labels = frozenAt(f, f->labelsOffset);
+    const struct FrozenNode *t = nodes, *forward = NULL;
+    char const *numAux = num;
+    char const *numAux2 = num;
+
+    while (true)
+    {
+        if (t->valueLength != 0)
+        {
+            forward = t;
+            numAux2 = numAux;
+        }
+
+        if (numAux[0] == '\0')
+            break;
+
+        const struct FrozenNode *son = frozenSon(nodes, t, numAux[0] - zero);
+
+        if (son == NULL || !frozenMatch(labels, son, numAux))
+            break;
+
+        numAux += son->labelLength;
+        t = son;
+    }
+
+    view->prefix = forward == NULL ? "" : (const char *)frozenAt(f, f->numbersOffset) + forward->value;
+    view->prefixLength = forward == NULL ? 0 : forward->valueLength;
+    view->suffix = numAux2;
+}
+
+/** @brief Wyznacza przekierowania na dany numer w zamrożonej strukturze.
+ * Działa tak jak @ref trierevReverse.
+ * @param[in] f  – wskaźnik na nagłówek zamrożonej struktury;
+ * @param[in] num – wskaźnik na napis reprezentujący numer.
+ * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+
+static struct PhoneNumbers *frozenReverse(const struct FrozenForward *f, char const *num)
+{
+    const struct FrozenNode *nodes = frozenAt(f, f->reverseOffset);
+    const struct FrozenNumber *sources = frozenAt(f, f->sourcesOffset);
+    const char *labels = frozenAt(f, f->labelsOffset);
+    const char *numbers = frozenAt(f, f->numbersOffset);
+    size_t len = strlen(num), size = 1, capacity = 16;
+    struct ReverseCandidate *cand = malloc(sizeof(struct ReverseCandidate) * capacity);
+
+    if (cand == NULL)
+        return NULL;
+
+    cand[0] = (struct ReverseCandidate){num, len, num + len, 0};
+
+    const struct FrozenNode *t = nodes;
+    char const *numAux = num;
+
+    while(numAux[0] != '\0')
+    {
+        const struct FrozenNode *son = frozenSon(nodes, t, numAux[0] - zero);
+
+        if (son == NULL || !frozenMatch(labels, son, numAux))
+            break;
+
+        t = son;
+        numAux += son->labelLength;
+
+        if (t->valueLength == 0)
+            continue;
+
+        if (!candidatesReserve(&cand, &capacity, size + t->valueLength))
+        {
+            free(cand);
+            return NULL;
+        }
+
+        size_t suffixLength = len - (numAux - num);
+
+        // Numery wierzchołka są posortowane, więc tworzą jedną serię
+        for(uint32_t i = 0; i < t->valueLength; i++)
+        {
+            const struct FrozenNumber *source = &sources[t->value + i];
+
+            cand[size++] = (struct ReverseCandidate){numbers + source->offset, source->length, numAux, suffixLength};
+        }
+    }
+
+    return candidatesNumbers(cand, size);
+}
+
+/**
+ * @brief Wierzchołki drzewa w kolejności przechodzenia wszerz.
+ */
+
+struct FrozenQueue
+{
+    void **tab; ///< wierzchołki drzewa Trie_forward lub Trie_reverse
+    size_t size; ///< liczba wierzchołków
+    size_t capacity; ///< rozmiar tablicy @p tab
+    size_t labels; ///< suma długości etykiet wierzchołków
+    size_t sources; ///< suma rozmiarów drzew reverse wierzchołków
+};
+
+/** @brief Zwraca etykietę wierzchołka drzewa Trie_forward lub Trie_reverse.
+ *
+ * @param[in] node – wierzchołek drzewa.
+ * @param[in] reverse – czy @p node jest wierzchołkiem drzewa Trie_reverse.
+ * @return Wskaźnik na etykietę.
+ */
+
+static inline const struct TrieLabel *frozenLabel(const void *node, bool reverse)
+{
+    return reverse ? &((const struct Node_reverse *)node)->label : &((const struct Node_forward *)node)->label;
+}
+
+/** @brief Zwraca synów wierzchołka drzewa Trie_forward lub Trie_reverse.
+ *
+ * @param[in] node – wierzchołek drzewa.
+ * @param[in] reverse – czy @p node jest wierzchołkiem drzewa Trie_reverse.
+ * @return Wskaźnik na synów.
+ */
+
+static inline const struct TrieSons *frozenSons(const void *node, bool reverse)
+{
+    return reverse ? &((const struct Node_reverse *)node)->sons : &((const struct Node_forward *)node)->sons;
+}
+
+/** @brief Ustawia wierzchołki drzewa w kolejności przechodzenia wszerz.
+ *
+ * Synowie każdego wierzchołka są dodawani w kolejności rosnących cyfr.
+ *
+ * @param[in] root – korzeń drzewa.
+ * @param[in] reverse – czy @p root jest korzeniem drzewa Trie_reverse.
+ * @param[out] queue – wskaźnik na kolejkę; jej tablicę trzeba zwolnić także
+ *                     wtedy, gdy nie udało się jej wypełnić.
+ * @return Wartość @p true, jeśli ustawiono wierzchołki.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool frozenQueue(void *root, bool reverse, struct FrozenQueue *queue)
+{
+    *queue = (struct FrozenQueue){malloc(sizeof(void *) * 64), 1, 64, 0, 0};
+
+    if (queue->tab == NULL)
+        return false;
+
+    queue->tab[0] = root;
+
+    for(size_t i = 0; i < queue->size; i++)
+    {
+        const struct TrieSons *sons = frozenSons(queue->tab[i], reverse);
+
+        queue->labels += frozenLabel(queue->tab[i], reverse)->length;
+
+        if (reverse)
+            queue->sources += ((Trie_reverse)queue->tab[i])->reverseSize;
+
+        if (queue->size + sons->capacity > queue->capacity)
+        {
+            void **tab = realloc(queue->tab, sizeof(void *) * 2 * queue->capacity);
+
+            if (tab == NULL)
+                return false;
+
+            queue->tab = tab;
+            queue->capacity *= 2;
+        }
+
+        // Mała tablica synów jest posortowana według cyfr, a pełna indeksowana cyfrą
+        for(int j = 0; j < sons->capacity; j++)
+        {
+            if (sons->tab[j] != NULL)
+                queue->tab[queue->size++] = sons->tab[j];
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Stan budowania zamrożonej struktury.
+ */
+
+struct FrozenBuilder
+{
+    const struct NumberPool *pool; ///< pula numerów zamrażanej struktury
+    const uint32_t *positions; ///< położenia numerów w tablicy numerów, indeksowane pozycjami numerów w puli
+    char *labels; ///< tablica etykiet
+    size_t labelsSize; ///< liczba cyfr zapisanych w tablicy etykiet
+    struct FrozenNumber *sources; ///< tablica numerów przekierowywanych
+    size_t sourcesSize; ///< liczba zapisanych numerów przekierowywanych
+};
+
+/** @brief Zwraca numer z puli jako numer zamrożonej struktury.
+ *
+ * @param[in] b – wskaźnik na stan budowania.
+ * @param[in] num – wskaźnik na numer z puli.
+ * @return Położenie i długość numeru w tablicy numerów.
+ */
+
+static inline struct FrozenNumber frozenNumber(const struct FrozenBuilder *b, char const *num)
+{
+    return (struct FrozenNumber){b->positions[poolPosition(b->pool, num)], poolLength(num)};
+}
+
+/** @brief Zapisuje wierzchołki drzewa w zamrożonej strukturze.
+ *
+ * @param[in,out] b – wskaźnik na stan budowania.
+ * @param[in] queue – wierzchołki drzewa w kolejności przechodzenia wszerz.
+ * @param[in] reverse – czy wierzchołki należą do drzewa Trie_reverse.
+ * @param[out] nodes – tablica wierzchołków zamrożonego drzewa.
+ */
+
+static void frozenFill(struct FrozenBuilder *b, const struct FrozenQueue *queue, bool reverse,
+                       struct FrozenNode *nodes)
+{
+    // Synowie kolejnych wierzchołków leżą w kolejce kolejno, zaczynając od drugiego miejsca
+    size_t next = 1;
+
+    for(size_t i = 0; i < queue->size; i++)
+    {
+        const struct TrieLabel *label = frozenLabel(queue->tab[i], reverse);
+        const struct TrieSons *sons = frozenSons(queue->tab[i], reverse);
+        struct FrozenNode *v = &nodes[i];
+
+        memcpy(b->labels + b->labelsSize, labelDigits(label), label->length);
+        v->label = b->labelsSize;
+        v->labelLength = label->length;
+        b->labelsSize += label->length;
+
+        v->sons = next;
+        v->sonMask = 0;
+
+        for(int j = 0; j < sons->capacity; j++)
+        {
+            void *son = sons->tab[j];
+
+            if (son != NULL)
+            {
+                v->sonMask |= 1u << (labelDigits(frozenLabel(son, reverse))[0] - zero);
+                next++;
+            }
+        }
+
+        if (!reverse)
+        {
+            char const *forwarding = ((Trie_forward)queue->tab[i])->forwarding;
+            struct FrozenNumber number = {0, 0};
+
+            if (forwarding != NULL)
+                number = frozenNumber(b, forwarding);
+
+            v->value = number.offset;
+            v->valueLength = number.length;
+        }
+        else
+        {
+            Trie_reverse t = queue->tab[i];
+            struct EntryIterator it;
+            char const *source;
+
+            v->value = b->sourcesSize;
+            v->valueLength = t->reverseSize;
+
+            entryIterInit(&it, t->reverse);
+
+            while ((source = entryIterNext(&it)) != NULL)
+                b->sources[b->sourcesSize++] = frozenNumber(b, source);
+        }
+    }
+}
+
+/** @brief Składa blok zamrożonej struktury.
+ *
+ * @param[in] pf – wskaźnik na strukturę, która nie jest migawką i ma
+ *                 zbudowany indeks najpłytszych wierzchołków.
+ * @param[in] forward – wierzchołki drzewa tfor w kolejności przechodzenia wszerz.
+ * @param[in] reverse – wierzchołki drzewa trev w kolejności przechodzenia wszerz.
+ * @param[out] positions – tablica o rozmiarze tablicy haszującej puli, w której
+ *                         zapisywane są położenia numerów.
+ * @return Wskaźnik na nagłówek bloku lub NULL, gdy nie udało się
+ *         zaalokować pamięci lub tablice nie mieszczą się w zakresie położeń.
+ */
+
+static struct FrozenForward *frozenAssemble(const struct PhoneForward *pf, const struct FrozenQueue *forward,
+                                            const struct FrozenQueue *reverse, uint32_t *positions)
+{
+    const struct NumberPool *pool = &pf->numbers;
+
+    // Numery z puli trafiają do tablicy numerów w kolejności z tablicy haszującej puli
+    size_t numbersSize = 0;
+
+    for(size_t i = 0; i < pool->capacity; i++)
+    {
+        if (pool->table[i] != NULL)
+        {
+            positions[i] = numbersSize;
+            numbersSize += pool->table[i]->length + 1;
+        }
+    }
+
+    size_t labelsSize = forward->labels + reverse->labels;
+
+    if (numbersSize > UINT32_MAX || labelsSize > UINT32_MAX || forward->size > UINT32_MAX
+        || reverse->size > UINT32_MAX || reverse->sources > UINT32_MAX)
+        return NULL;
+
+    uint64_t countOffset = sizeof(struct FrozenForward);
+    uint64_t forwardOffset = countOffset + sizeof(struct FrozenCountEntry) * pf->shallowest.size;
+    uint64_t reverseOffset = forwardOffset + sizeof(struct FrozenNode) * forward->size;
+    uint64_t sourcesOffset = reverseOffset + sizeof(struct FrozenNode) * reverse->size;
+    uint64_t labelsOffset = sourcesOffset + sizeof(struct FrozenNumber) * reverse->sources;
+    uint64_t numbersOffset = labelsOffset + labelsSize;
+    uint64_t size = numbersOffset + numbersSize;
+
+    // Wyzerowane bajty wyrównania sprawiają, że te same przekierowania dają ten sam blok
+    struct FrozenForward *f = calloc(1, size);
+
+    if (f == NULL)
+        return NULL;
+
+    *f = (struct FrozenForward){frozenMagic, frozenVersion, frozenByteOrder, 0, size, 0, countOffset,
+                                forwardOffset, reverseOffset, sourcesOffset, labelsOffset, numbersOffset,
+                                pf->shallowest.size, forward->size, reverse->size, reverse->sources};
+
+    struct FrozenCountEntry *entries = (struct FrozenCountEntry *)((char *)f + countOffset);
+    size_t entriesSize = 0;
+
+    for(size_t i = 0; i < pf->shallowest.capacity; i++)
+    {
+        const struct CountIndexEntry *e = &pf->shallowest.table[i];
+
+        if (e->count != 0)
+        {
+            entries[entriesSize].depth = e->depth;
+            entries[entriesSize].mask = e->mask;
+            entries[entriesSize].count = e->count;
+            entriesSize++;
+        }
+    }
+
+    char *numbers = (char *)f + numbersOffset;
+
+    for(size_t i = 0; i < pool->capacity; i++)
+    {
+        if (pool->table[i] != NULL)
+            memcpy(numbers + positions[i], pool->table[i]->digits, pool->table[i]->length + 1);
+    }
+
+    struct FrozenBuilder b = {pool, positions, (char *)f + labelsOffset, 0,
+                              (struct FrozenNumber *)((char *)f + sourcesOffset), 0};
+
+    frozenFill(&b, forward, false, (struct FrozenNode *)((char *)f + forwardOffset));
+    frozenFill(&b, reverse, true, (struct FrozenNode *)((char *)f + reverseOffset));
+
+    return f;
+}
+
+/** @brief Buduje zamrożoną strukturę z przekierowaniami @p pf.
+ *
+ * @param[in] pf – wskaźnik na strukturę, która nie jest migawką i ma
+ *                 zbudowany indeks najpłytszych wierzchołków.
+ * @return Wskaźnik na nagłówek bloku zamrożonej struktury lub NULL, gdy nie
+ *         udało się zaalokować pamięci lub tablice nie mieszczą się
+ *         w zakresie położeń.
+ */
+
+static struct FrozenForward *frozenBuild(const struct PhoneForward *pf)
+{
+    struct FrozenQueue forward = {NULL, 0, 0, 0, 0}, reverse = {NULL, 0, 0, 0, 0};
+    uint32_t *positions = malloc(sizeof(uint32_t) * (pf->numbers.capacity > 0 ? pf->numbers.capacity : 1));
+    struct FrozenForward *f = NULL;
+
+    if (positions != NULL && frozenQueue(pf->tfor, false, &forward) && frozenQueue(pf->trev, true, &reverse))
+        f = frozenAssemble(pf, &forward, &reverse, positions);
+
+    free(positions);
+    free(forward.tab);
+    free(reverse.tab);
+
+    return f;
+}
+
+/** @brief Dodaje bajty do wartości funkcji haszującej FNV-1a.
+ *
+ * Bajty są dodawane słowami 64-bitowymi, a tylko ostatnie pojedynczo.
+ * Każdy krok jest odwracalny, więc zmiana jednego słowa zawsze zmienia
+ * wynik, a liczenie jest kilka razy szybsze niż po jednym bajcie.
+ *
+ * @param[in] hash – wartość funkcji haszującej poprzednich bajtów.
+ * @param[in] data – wskaźnik na bajty.
+ * @param[in] size – liczba bajtów.
+ * @return Wartość funkcji haszującej po dodaniu bajtów.
+ */
+
+static uint64_t frozenHash(uint64_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    size_t i = 0;
+
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+
+        memcpy(&word, bytes + i, sizeof(uint64_t));
+        hash ^= word;
+        hash *= 1099511628211ull;
+    }
+
+    for(; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
+
+/** @brief Wylicza sumę kontrolną bloku zamrożonej struktury.
+ *
+ * @param[in] f – wskaźnik na nagłówek bloku o rozmiarze @p f->size.
+ * @return Wartość funkcji haszującej FNV-1a bloku z polem @p checksum równym 0.
+ */
+
+static uint64_t frozenChecksum(const struct FrozenForward *f)
+{
+    struct FrozenForward header = *f;
+
+    header.checksum = 0;
+
+    uint64_t hash = frozenHash(14695981039346656037ull, &header, sizeof(struct FrozenForward));
+
+    return frozenHash(hash, (const char *)f + sizeof(struct FrozenForward), f->size - sizeof(struct FrozenForward));
+}
+
+/** @brief Sprawdza, czy tablica znaków zawiera tylko cyfry i ewentualnie znaki '\0'.
+ *
+ * @param[in] chars – wskaźnik na tablicę znaków.
+ * @param[in] size – rozmiar tablicy.
+ * @param[in] terminated – czy tablica składa się z napisów zakończonych znakiem '\0'.
+ * @return Wartość @p true, jeżeli tablica jest poprawna.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+
+static bool frozenCharsValid(const char *chars, uint64_t size, bool terminated)
+{
+    for(uint64_t i = 0; i < size; i++)
+    {
+        bool digit = chars[i] >= zero && chars[i] < zero + numberOfDigits;
+
+        if (!digit && !(terminated && chars[i] == '\0'))
+            return false;
+    }
+
+    return !terminated || size == 0 || chars[size - 1] == '\0';
+}
+
+/** @brief Sprawdza, czy numer zamrożonej struktury leży w tablicy numerów.
+ *
+ * @param[in] numbers – tablica numerów, w której są tylko cyfry i znaki '\0'.
+ * @param[in] size – rozmiar tablicy numerów.
+ * @param[in] offset – położenie numeru.
+ * @param[in] length – długość numeru.
+ * @return Wartość @p true, jeżeli pod położeniem @p offset jest niepusty numer
+ *         długości @p length.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+
+static bool frozenNumberValid(const char *numbers, uint64_t size, uint32_t offset, uint32_t length)
+{
+    return length > 0 && (uint64_t)offset + length < size && numbers[offset + length] == '\0'
+           && memchr(numbers + offset, '\0', length) == NULL;
+}
+
+/** @brief Sprawdza wierzchołki zamrożonego drzewa.
+ *
+ * Sprawdza, czy synowie wierzchołków leżą tak, jak w kolejności przechodzenia
+ * wszerz, etykiety i numery leżą w swoich tablicach, pierwsze cyfry etykiet
+ * synów zgadzają się z maską, a numery przekierowywane na wierzchołek są
+ * posortowane rosnąco.
+ *
+ * @param[in] f – wskaźnik na nagłówek bloku z poprawnymi położeniami tablic.
+ * @param[in] reverse – czy sprawdzane jest drzewo trev (a nie tfor).
+ * @return Wartość @p true, jeżeli drzewo jest poprawne.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+
+static bool frozenTreeValid(const struct FrozenForward *f, bool reverse)
+{
+    const struct FrozenNode *nodes = frozenAt(f, reverse ? f->reverseOffset : f->forwardOffset);
+    const struct FrozenNumber *sources = frozenAt(f, f->sourcesOffset);
+    const char *labels = frozenAt(f, f->labelsOffset);
+    const char *numbers = frozenAt(f, f->numbersOffset);
+    uint64_t labelsSize = f->numbersOffset - f->labelsOffset, numbersSize = f->size - f->numbersOffset;
+    uint32_t size = reverse ? f->reverseSize : f->forwardSize;
+    uint64_t next = 1, nextSource = 0;
+
+    if (size == 0 || nodes[0].labelLength != 0)
+        return false;
+
+    for(uint32_t i = 0; i < size; i++)
+    {
+        const struct FrozenNode *v = &nodes[i];
+
+        if (v->sons != next || (v->sonMask >> numberOfDigits) != 0 || v->pad != 0
+            || (uint64_t)v->label + v->labelLength > labelsSize)
+            return false;
+
+        next += __builtin_popcount(v->sonMask);
+
+        if (next > size)
+            return false;
+
+        for(int digit = 0, k = 0; digit < numberOfDigits; digit++)
+        {
+            if ((v->sonMask & (1u << digit)) == 0)
+                continue;
+
+            const struct FrozenNode *son = &nodes[v->sons + k++];
+
+            if (son->labelLength == 0 || son->label >= labelsSize || labels[son->label] != zero + digit)
+                return false;
+        }
+
+        if (!reverse)
+        {
+            if (v->valueLength != 0 && !frozenNumberValid(numbers, numbersSize, v->value, v->valueLength))
+                return false;
+
+            continue;
+        }
+
+        if (v->value != nextSource || nextSource + v->valueLength > f->sourcesSize)
+            return false;
+
+        nextSource += v->valueLength;
+
+        for(uint32_t j = 0; j < v->valueLength; j++)
+        {
+            const struct FrozenNumber *source = &sources[v->value + j];
+
+            if (!frozenNumberValid(numbers, numbersSize, source->offset, source->length))
+                return false;
+
+            // Drzewa AVL są budowane przy wczytywaniu z posortowanych numerów
+            if (j > 0 && strcmp(numbers + source[-1].offset, numbers + source->offset) >= 0)
+                return false;
+        }
+    }
+
+    return next == size && (!reverse || nextSource == f->sourcesSize);
+}
+
+/** @brief Sprawdza nagłówek bloku zamrożonej struktury.
+ *
+ * Sprawdza w czasie stałym wersję, rozmiar i położenia tablic, ale nie
+ * ich zawartość.
+ *
+ * @param[in] f – wskaźnik na blok o rozmiarze @p size, nie mniejszym od rozmiaru nagłówka.
+ * @param[in] size – rozmiar bloku w bajtach.
+ * @return Wartość @p true, jeżeli nagłówek jest poprawny.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+
+static bool frozenHeaderValid(const struct FrozenForward *f, uint64_t size)
+{
+    // Położenia tablic muszą być takie, jakie wylicza frozenAssemble
+    return f->magic == frozenMagic && f->version == frozenVersion && f->byteOrder == frozenByteOrder
+           && f->pad == 0 && f->size == size && f->countOffset == sizeof(struct FrozenForward)
+           && f->forwardOffset == f->countOffset + (uint64_t)f->countSize * sizeof(struct FrozenCountEntry)
+           && f->reverseOffset == f->forwardOffset + (uint64_t)f->forwardSize * sizeof(struct FrozenNode)
+           && f->sourcesOffset == f->reverseOffset + (uint64_t)f->reverseSize * sizeof(struct FrozenNode)
+           && f->labelsOffset == f->sourcesOffset + (uint64_t)f->sourcesSize * sizeof(struct FrozenNumber)
+           && f->labelsOffset <= f->numbersOffset && f->numbersOffset <= size
+           && f->forwardSize > 0 && f->reverseSize > 0;
+}
+
+/** @brief Sprawdza blok zamrożonej struktury.
+ *
+ * Po sprawdzeniu zapytania do bloku odczytują tylko jego pamięć.
+ *
+ * @param[in] f – wskaźnik na blok o rozmiarze @p size, nie mniejszym od rozmiaru nagłówka.
+ * @param[in] size – rozmiar bloku w bajtach.
+ * @return Wartość @p true, jeżeli blok jest poprawny.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+
+static bool frozenValid(const struct FrozenForward *f, uint64_t size)
+{
+    if (!frozenHeaderValid(f, size))
+        return false;
+
+    const struct FrozenCountEntry *entries = frozenAt(f, f->countOffset);
+
+    for(uint32_t i = 0; i < f->countSize; i++)
+    {
+        if (entries[i].count == 0 || (entries[i].mask >> numberOfDigits) != 0 || entries[i].pad != 0)
+            return false;
+    }
+
+    return frozenCharsValid(frozenAt(f, f->labelsOffset), f->numbersOffset - f->labelsOffset, false)
+           && frozenCharsValid(frozenAt(f, f->numbersOffset), size - f->numbersOffset, true)
+           && frozenTreeValid(f, false) && frozenTreeValid(f, true);
+}
+
+/** @brief Zapisuje blok zamrożonej struktury w pliku.
+ *
+ * @param[in] f – wskaźnik na nagłówek bloku.
+ * @param[in] path – ścieżka pliku.
+ * @param[in] durable – czy utrwalić plik na dysku przed zamknięciem.
+ * @return Wartość @p true, jeśli zapisano blok.
+ *         Wartość @p false, jeśli wystąpił błąd zapisu.
+ */
+
+static bool frozenWrite(const struct FrozenForward *f, char const *path, bool durable)
+{
+    struct FrozenForward header = *f;
+    size_t rest = f->size - sizeof(struct FrozenForward);
+    FILE *file = fopen(path, "wb");
+
+    if (file == NULL)
+        return false;
+
+    header.checksum = frozenChecksum(f);
+
+    bool written = fwrite(&header, sizeof(struct FrozenForward), 1, file) == 1
+                   && fwrite((const char *)f + sizeof(struct FrozenForward), 1, rest, file) == rest
+                   && (!durable || (fflush(file) == 0 && fsync(fileno(file)) == 0));
+    bool closed = fclose(file) == 0;
+
+    return written && closed;
+}
+
+/** @brief Atomowo zastępuje plik blokiem zamrożonej struktury.
+ *
+ * Blok jest utrwalany w pliku tymczasowym, który następnie zastępuje plik
+ * @p path, więc po przerwaniu w dowolnym momencie plik @p path zawiera stary
+ * albo nowy blok. Na koniec utrwalany jest katalog, żeby zmiana nazwy
+ * przetrwała awarię.
+ *
+ * @param[in] f – wskaźnik na nagłówek bloku.
+ * @param[in] path – ścieżka pliku.
+ * @return Wartość @p true, jeśli zastąpiono plik.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci lub
+ *         wystąpił błąd zapisu.
+ */
+
+static bool frozenReplace(const struct FrozenForward *f, char const *path)
+{
+    size_t length = strlen(path);
+    char *temporary = malloc(length + sizeof(".tmp"));
+
+    if (temporary == NULL)
+        return false;
+
+    memcpy(temporary, path, length);
+    memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+
+    bool result = frozenWrite(f, temporary, true) && rename(temporary, path) == 0;
+
+    if (!result)
+        unlink(temporary);
+
+    // Katalog pliku to wszystko przed ostatnim '/' (lub bieżący katalog)
+    char *slash = strrchr(temporary, '/');
+
+    if (slash != NULL)
+        slash[1] = '\0';
+    else
+        strcpy(temporary, ".");
+
+    int fd = result ? open(temporary, O_RDONLY) : -1;
+
+    result = result && fd >= 0 && fsync(fd) == 0;
+
+    if (fd >= 0)
+        close(fd);
+
+    free(temporary);
+
+    return result;
+}
+
+/** @brief Wczytuje blok zamrożonej struktury z pliku.
+ *
+ * @param[in] path – ścieżka pliku.
+ * @return Wskaźnik na nagłówek sprawdzonego bloku lub NULL, jeśli nie udało
+ *         się odczytać pliku, plik jest niepoprawny lub nie udało się
+ *         zaalokować pamięci.
+ */
+
+static struct FrozenForward *frozenRead(char const *path)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL)
+        return NULL;
+
+    struct FrozenForward header;
+    struct FrozenForward *f = NULL;
+    bool valid = fread(&header, sizeof(struct FrozenForward), 1, file) == 1 && header.magic == frozenMagic
+                 && header.version == frozenVersion && header.byteOrder == frozenByteOrder
+                 && header.size >= sizeof(struct FrozenForward);
+
+    // Rozmiar z nagłówka jest sprawdzany z rozmiarem pliku, zanim zostanie zaalokowany
+    if (valid && fseek(file, 0, SEEK_END) == 0)
+    {
+        long length = ftell(file);
+
+        valid = length >= 0 && (uint64_t)length == header.size && header.size <= SIZE_MAX
+                && fseek(file, sizeof(struct FrozenForward), SEEK_SET) == 0;
+
+        if (valid)
+            f = malloc(header.size);
+    }
+
+    if (f != NULL)
+    {
+        size_t rest = header.size - sizeof(struct FrozenForward);
+
+        *f = header;
+
+        if (fread((char *)f + sizeof(struct FrozenForward), 1, rest, file) != rest
+            || frozenChecksum(f) != header.checksum || !frozenValid(f, header.size))
+        {
+            free(f);
+            f = NULL;
+        }
+    }
+
+    fclose(file);
+
+    return f;
+}
+
+/**
+ * @brief Wierzchołek odtwarzany z zamrożonego drzewa.
+ */
+
+struct FrozenThawItem
+{
+    void *node; ///< utworzony wierzchołek drzewa Trie_forward lub Trie_reverse
+    uint32_t index; ///< indeks wierzchołka w tablicy wierzchołków zamrożonego drzewa
+    size_t depth; ///< liczba cyfr na ścieżce od korzenia do wierzchołka
+};
+
+/** @brief Ustawia przekierowania odtwarzanego wierzchołka.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę, w której arenie alokowane są wierzchołki.
+ * @param[in] f – wskaźnik na nagłówek sprawdzonego bloku.
+ * @param[in] v – wskaźnik na wierzchołek zamrożonego drzewa.
+ * @param[in,out] node – odtwarzany wierzchołek.
+ * @param[in] reverse – czy odtwarzane jest drzewo trev (a nie tfor).
+ * @param[in] path – ścieżka od korzenia do wierzchołka zakończona znakiem '\0'
+ *                   (tylko dla drzewa tfor).
+ * @param[in,out] sorted – tablica na numery drzewa reverse wierzchołka,
+ *                         mieszcząca co najmniej @p v->valueLength numerów.
+ * @return Wartość @p true, jeśli ustawiono przekierowania.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool frozenThawValue(struct PhoneForward *pf, const struct FrozenForward *f, const struct FrozenNode *v,
+                            void *node, bool reverse, const char *path, char const **sorted)
+{
+    const char *numbers = frozenAt(f, f->numbersOffset);
+
+    if (v->valueLength == 0)
+        return true;
+
+    if (!reverse)
+    {
+        Trie_forward t = node;
+
+        t->forwarding = poolIntern(&pf->numbers, numbers + v->value);
+        t->source = poolIntern(&pf->numbers, path);
+
+        return t->forwarding != NULL && t->source != NULL;
+    }
+
+    const struct FrozenNumber *sources = frozenAt(f, f->sourcesOffset);
+    Trie_reverse t = node;
+
+    for(uint32_t i = 0; i < v->valueLength; i++)
+    {
+        sorted[i] = poolIntern(&pf->numbers, numbers + sources[v->value + i].offset);
+
+        if (sorted[i] == NULL)
+            return false;
+    }
+
+    t->reverseSize = v->valueLength;
+
+    return entryBuild(&pf->arena, sorted, v->valueLength, &t->reverse);
+}
+
+/** @brief Odtwarza drzewo z zamrożonej struktury.
+ *
+ * Przechodzi zamrożone drzewo w głąb i dla każdego wierzchołka tworzy od
+ * razu tablicę synów właściwego rozmiaru, więc żaden wierzchołek nie jest
+ * wyszukiwany ani przebudowywany.
+ *
+ * @param[in,out] pf – wskaźnik na strukturę z pustymi drzewami.
+ * @param[in] f – wskaźnik na nagłówek sprawdzonego bloku.
+ * @param[in] reverse – czy odtwarzane jest drzewo trev (a nie tfor).
+ * @return Wartość @p true, jeśli odtworzono drzewo.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci (drzewo
+ *         jest wtedy niekompletne).
+ */
+
+static bool frozenThaw(struct PhoneForward *pf, const struct FrozenForward *f, bool reverse)
+{
+    const struct FrozenNode *nodes = frozenAt(f, reverse ? f->reverseOffset : f->forwardOffset);
+    const char *labels = frozenAt(f, f->labelsOffset);
+    size_t capacity = 64, pathCapacity = 64, sortedCapacity = 16, size = 1;
+    struct FrozenThawItem *stack = malloc(sizeof(struct FrozenThawItem) * capacity);
+    char *path = malloc(pathCapacity);
+    char const **sorted = malloc(sizeof(char const *) * sortedCapacity);
+    bool ok = stack != NULL && path != NULL && sorted != NULL;
+
+    if (ok)
+        stack[0] = (struct FrozenThawItem){reverse ? (void *)pf->trev : (void *)pf->tfor, 0, 0};
+
+    while (ok && size > 0)
+    {
+        struct FrozenThawItem item = stack[--size];
+        const struct FrozenNode *v = &nodes[item.index];
+        struct TrieSons *sons = reverse ? &((Trie_reverse)item.node)->sons : &((Trie_forward)item.node)->sons;
+        int count = __builtin_popcount(v->sonMask);
+
+        // Rodzeństwo jest zdejmowane ze stosu po całym poddrzewie brata, a jego
+        // etykiety są zapisywane za ścieżką do wspólnego ojca, więc ta się nie zmienia
+        if (item.depth + 1 > pathCapacity || v->valueLength > sortedCapacity || size + count > capacity)
+        {
+            while (item.depth + 1 > pathCapacity)
+                pathCapacity *= 2;
+
+            while (v->valueLength > sortedCapacity)
+                sortedCapacity *= 2;
+
+            while (size + count > capacity)
+                capacity *= 2;
+
+            char *newPath = realloc(path, pathCapacity);
+            char const **newSorted = newPath != NULL ? realloc(sorted, sizeof(char const *) * sortedCapacity) : NULL;
+            struct FrozenThawItem *newStack = newSorted != NULL ? realloc(stack, sizeof(struct FrozenThawItem) * capacity) : NULL;
+
+            path = newPath != NULL ? newPath : path;
+            sorted = newSorted != NULL ? newSorted : sorted;
+            stack = newStack != NULL ? newStack : stack;
+            ok = newStack != NULL;
+
+            if (!ok)
+                break;
+        }
+
+        memcpy(path + item.depth - v->labelLength, labels + v->label, v->labelLength);
+        path[item.depth] = '\0';
+
+        ok = frozenThawValue(pf, f, v, item.node, reverse, path, sorted);
+
+        if (ok && count > 0)
+            ok = sonsResize(&pf->arena, sons, count <= smallSons ? smallSons : numberOfDigits);
+
+        for(int k = 0; ok && k < count; k++)
+        {
+            const struct FrozenNode *w = &nodes[v->sons + k];
+            void *son = reverse ? (void *)trierevNew(pf) : (void *)trieforNew(pf);
+
+            if (son == NULL)
+            {
+                ok = false;
+                break;
+            }
+
+            struct TrieLabel *label = reverse ? &((Trie_reverse)son)->label : &((Trie_forward)son)->label;
+
+            ok = labelSet(&pf->arena, label, labels + w->label, w->labelLength)
+                 && sonsAdd(&pf->arena, sons, labels[w->label] - zero, son);
+
+            stack[size++] = (struct FrozenThawItem){son, v->sons + k, item.depth + w->labelLength};
+        }
+    }
+
+    free(stack);
+    free(path);
+    free(sorted);
+
+    return ok;
+}
+
+/** @brief Odtwarza przekierowania z zamrożonej struktury.
+ *
+ * @param[in,out] pf – wskaźnik na nową strukturę bez przekierowań.
+ * @param[in] f – wskaźnik na nagłówek sprawdzonego bloku.
+ * @return Wartość @p true, jeśli odtworzono przekierowania.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+
+static bool frozenLoad(struct PhoneForward *pf, const struct FrozenForward *f)
+{
+    const char *numbers = frozenAt(f, f->numbersOffset);
+    size_t count = 0;
+
+    for(uint64_t i = 0; i < f->size - f->numbersOffset; i++)
+        count += numbers[i] == '\0';
+
+    // Pula od razu mieści wszystkie numery, więc nie jest przebudowywana
+    return poolReserve(&pf->numbers, count) && frozenThaw(pf, f, false) && frozenThaw(pf, f, true)
+           && trierevIndex(pf->trev, &pf->shallowest);
+}
+
+
+// PhoneForward
+
+/** @brief Sprawdza, czy @p s wskazuje na poprawny numer.
+ *
+ * @param[in] s  – wskaźnik na ciąg znaków.
+ * @return Wartość @p true, jeżeli @p s wskazuje na poprawny numer.
+ *         Wartośc @p false w przeciwnym wypadku.
+ */
+
+static bool is_number(char const *s)
+{
+    if (s == NULL)
+        return false;
+
+    size_t len = strlen(s);
+
+    for(unsigned int i = 0; i < len; i++)
+    {
+        if (s[i] < zero || s[i] > zero + numberOfDigits - 1)
+            return false;
+    }
+
+    return (len > 0);
+}
+
+
+
+// NonTrivialCount
+
+/** @brief Podnosi @p basis do potęgi @p idx.
+ *
+ * @param[in] basis  – podstawa.
+ * @param[in] idx  – wykładnik.
+ * @return Zwraca wartość modulo rozmiar zakres size_t.
+ */
+
+size_t power(size_t basis, size_t idx)
+{
+    size_t result = 1, aux = basis;
+
+    while(idx > 0){
+
+        if (idx % 2 == 1)
+            result *= aux;
+
+        aux*=aux;
+        idx /= 2;
+    }
+
+    return result;
+}
+
+/** @brief Sumuje nietrywialne numery z części tablicy indeksu.
+ *
+ * @param[in] index – wskaźnik na indeks najpłytszych niepustych wierzchołków.
+ * @param[in] from – indeks pierwszego miejsca tablicy.
+ * @param[in] to – indeks za ostatnim miejscem tablicy.
+ * @param[in] mask – maska bitowa cyfr ze zbioru.
+ * @param[in] len – długość numerów.
+ * @param[in] basis – liczba cyfr w zbiorze.
+ * @return Suma mod 2^(liczba bitów size_t).
+ */
+
+static size_t countRange(const struct CountIndex *index, size_t from, size_t to,
+                         unsigned int mask, size_t len, size_t basis)
+{
+    size_t result = 0;
+
+    for(size_t i = from; i < to; i++)
+    {
+        const struct CountIndexEntry *e = &index->table[i];
+
+        if (e->count != 0 && e->depth <= len && (e->mask & ~mask) == 0)
+            result += e->count * power(basis, len - e->depth);
+    }
+
+    return result;
+}
+
+/** @brief Sumuje nietrywialne numery z części tablicy grup zamrożonej struktury.
+ *
+ * @param[in] entries – tablica grup zamrożonej struktury.
+ * @param[in] from – indeks pierwszej grupy.
+ * @param[in] to – indeks za ostatnią grupą.
+ * @param[in] mask – maska bitowa cyfr ze zbioru.
+ * @param[in] len – długość numerów.
+ * @param[in] basis – liczba cyfr w zbiorze.
+ * @return Suma mod 2^(liczba bitów size_t).
+ */
+
+static size_t countFrozenRange(const struct FrozenCountEntry *entries, size_t from, size_t to,
+                               unsigned int mask, size_t len, size_t basis)
+{
+    size_t result = 0;
+
+    for(size_t i = from; i < to; i++)
+    {
+        const struct FrozenCountEntry *e = &entries[i];
+
+        if (e->depth <= len && (e->mask & ~mask) == 0)
+            result += (size_t)e->count * power(basis, len - e->depth);
+    }
+
+    return result;
+}
+
+/**
+ * @brief Wspólne dane wątków liczących nietrywialne numery.
+ * Liczone są grupy z tablicy indeksu albo, jeżeli @p frozen nie ma wartości
+ * NULL, z tablicy grup zamrożonej struktury.
+ */
+
+struct CountTask
+{
+    const struct CountIndex *index; ///< indeks najpłytszych niepustych wierzchołków
+    const struct FrozenCountEntry *frozen; ///< grupy zamrożonej struktury lub NULL
+    size_t size; ///< rozmiar liczonej tablicy
+    unsigned int mask; ///< maska bitowa cyfr ze zbioru
+    size_t len; ///< długość numerów
+    size_t basis; ///< liczba cyfr w zbiorze
+    atomic_size_t next; ///< początek kolejnej nieprzydzielonej części tablicy
+};
+
+/** @brief Sumuje nietrywialne numery z części liczonej tablicy.
+ *
+ * @param[in] task – wskaźnik na zadanie.
+ * @param[in] from – indeks pierwszego miejsca tablicy.
+ * @param[in] to – indeks za ostatnim miejscem tablicy.
+ * @return Suma mod 2^(liczba bitów size_t).
+ */
+
+static size_t countTaskRange(const struct CountTask *task, size_t from, size_t to)
+{
+    if (task->frozen != NULL)
+        return countFrozenRange(task->frozen, from, to, task->mask, task->len, task->basis);
+
+    return countRange(task->index, from, to, task->mask, task->len, task->basis);
+}
+
+/** @brief Liczy kolejne części tablicy indeksu, dopóki są nieprzydzielone.
+ * Wątki biorą części po kolei, więc szybsze wątki liczą ich więcej.
+ *
+ * @param[in,out] task – wskaźnik na zadanie.
+ * @return Suma z części tablicy policzonych przez wątek.
+ */
+
+static size_t countChunks(struct CountTask *task)
+{
+    size_t result = 0;
+
+    while (true)
+    {
+        size_t from = atomic_fetch_add(&task->next, countChunk);
+
+        if (from >= task->size)
+            break;
+
+        size_t to = from + countChunk < task->size ? from + countChunk : task->size;
+
+        result += countTaskRange(task, from, to);
+    }
+
+    return result;
+}
+
+/** @brief Pętla wątku puli liczącej nietrywialne numery.
+ * Wątek dołącza do każdego zadania, które zastanie otwarte, i kończy się,
+ * gdy pula jest usuwana.
+ *
+ * @param[in,out] arg – wskaźnik na pulę.
+ * @return NULL.
+ */
+
+static void *countPoolWork(void *arg)
+{
+    struct CountPool *pool = arg;
+    unsigned long long seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+
+    while (true)
+    {
+        while (!pool->stop && (pool->task == NULL || pool->round == seen))
+            pthread_cond_wait(&pool->start, &pool->lock);
+
+        if (pool->stop)
+            break;
+
+        struct CountTask *task = pool->task;
+
+        seen = pool->round;
+        pool->running++;
+        pthread_mutex_unlock(&pool->lock);
+
+        size_t result = countChunks(task);
+
+        pthread_mutex_lock(&pool->lock);
+        pool->result += result;
+
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+/** @brief Kończy wątki puli i zwalnia ją.
+ * Nic nie robi, jeśli @p pool ma wartość NULL.
+ *
+ * @param[in] pool – wskaźnik na pulę, która nie liczy żadnego zadania.
+ */
+
+static void countPoolDelete(struct CountPool *pool)
+{
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for(unsigned int i = 0; i < pool->threads; i++)
+        pthread_join(pool->workers[i], NULL);
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_mutex_destroy(&pool->owner);
+    free(pool);
+}
+
+/** @brief Tworzy pulę wątków liczących nietrywialne numery.
+ * Jeżeli nie uda się utworzyć któregoś wątku, pula ma ich mniej.
+ *
+ * @param[in] threads – liczba wątków puli, dodatnia.
+ * @return Wskaźnik na pulę lub NULL, gdy nie udało się zaalokować pamięci
+ *         lub utworzyć żadnego wątku.
+ */
+
+static struct CountPool *countPoolNew(unsigned int threads)
+{
+    struct CountPool *pool = malloc(sizeof(struct CountPool) + sizeof(pthread_t) * threads);
+
+    if (pool == NULL)
+        return NULL;
+
+    pool->task = NULL;
+    pool->round = 0;
+    pool->running = 0;
+    pool->result = 0;
+    pool->stop = false;
+    pool->threads = 0;
+
+    bool ok = pthread_mutex_init(&pool->owner, NULL) == 0;
+
+    ok = ok && pthread_mutex_init(&pool->lock, NULL) == 0;
+    ok = ok && pthread_cond_init(&pool->start, NULL) == 0;
+    ok = ok && pthread_cond_init(&pool->done, NULL) == 0;
+
+    if (!ok)
+    {
+        free(pool);
+        return NULL;
+    }
+
+    while (pool->threads < threads
+           && pthread_create(&pool->workers[pool->threads], NULL, countPoolWork, pool) == 0)
+        pool->threads++;
+
+    if (pool->threads == 0)
+    {
+        countPoolDelete(pool);
+        return NULL;
+    }
+
+    return pool;
+}
+
+/** @brief Liczy nietrywialne numery, dzieląc tablicę indeksu między wątki puli.
+ * Jeżeli pula liczy zadanie innego wątku, liczy w jednym wątku. Sumy
+ * częściowe są dodawane mod 2^(liczba bitów size_t), więc wynik jest taki
+ * sam jak przy liczeniu w jednym wątku.
+ *
+ * @param[in,out] task – wskaźnik na zadanie z wyzerowanym @p next.
+ * @param[in,out] pool – wskaźnik na pulę.
+ * @return Liczba nietrywialnych numerów mod 2^(liczba bitów size_t).
+ */
+
+static size_t countParallel(struct CountTask *task, struct CountPool *pool)
+{
+    if (pthread_mutex_trylock(&pool->owner) != 0)
+        return countTaskRange(task, 0, task->size);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->task = task;
+    pool->result = 0;
+    pool->round++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Wątek wywołujący też liczy
+    size_t result = countChunks(task);
+
+    // Po zamknięciu zadania nowe wątki już do niego nie dołączą, więc
+    // wystarczy poczekać na te, które liczą
+    pthread_mutex_lock(&pool->lock);
+    pool->task = NULL;
+
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+
+    result += pool->result;
+    pthread_mutex_unlock(&pool->lock);
+    pthread_mutex_unlock(&pool->owner);
+
+    return result;
+}
+
+
+
+// Funkcje z phone_forward.h
+
+/** @brief Tworzy blokady części drzew.
+ * @return Wskaźnik na blokady lub NULL, gdy nie udało się ich utworzyć.
+ */
+static struct ShardLocks *shardsNew(void)
+{
+    struct ShardLocks *s = malloc(sizeof(struct ShardLocks));
+
+    if (s == NULL)
+        return NULL;
+
+    bool ok = true;
+
+    for(int i = 0; i < numberOfShards; i++)
+    {
+        ok &= pthread_mutex_init(&s->forward[i], NULL) == 0;
+        ok &= pthread_mutex_init(&s->reverse[i], NULL) == 0;
+    }
+
+    ok &= pthread_mutex_init(&s->arena, NULL) == 0;
+    ok &= pthread_mutex_init(&s->numbers, NULL) == 0;
+    ok &= pthread_mutex_init(&s->shared, NULL) == 0;
+
+    if (!ok)
+    {
+        free(s);
+        return NULL;
+    }
+
+    return s;
+}
+
+/** @brief Usuwa blokady części drzew.
+ * Nic nie robi, jeśli @p s ma wartość NULL.
+ * @param[in] s – wskaźnik na blokady, których nikt nie trzyma.
+ */
+static void shardsDelete(struct ShardLocks *s)
+{
+    if (s != NULL)
+    {
+        for(int i = 0; i < numberOfShards; i++)
+        {
+            pthread_mutex_destroy(&s->forward[i]);
+            pthread_mutex_destroy(&s->reverse[i]);
+        }
+
+        pthread_mutex_destroy(&s->arena);
+        pthread_mutex_destroy(&s->numbers);
+        pthread_mutex_destroy(&s->shared);
+        free(s);
+    }
+}
+
+/** @brief Zwraca bit części drzewa, do której należy numer.
+ * @param[in] num – wskaźnik na poprawny numer.
+ * @return Maska z bitem pierwszej cyfry numeru.
+ */
+static unsigned int shardBit(char const *num)
+{
+    return 1u << (num[0] - zero);
+}
+
+/** @brief Zakłada blokady części drzewa w kolejności rosnących cyfr.
+ * Nic nie robi, jeśli struktura nie jest w trybie współbieżnym.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] reverse – czy blokowane są części drzewa trev (a nie tfor);
+ * @param[in] shards – maska bitowa blokowanych części.
+ */
+static void shardsLock(struct PhoneForward *pf, bool reverse, unsigned int shards)
+{
+    if (pf->shards == NULL)
+        return;
+
+    pthread_mutex_t *locks = reverse ? pf->shards->reverse : pf->shards->forward;
+
+    for(int i = 0; i < numberOfShards; i++)
+    {
+        if (shards & (1u << i))
+            pthread_mutex_lock(&locks[i]);
+    }
+}
+
+/** @brief Zdejmuje blokady założone przez @ref shardsLock.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] reverse – czy blokowane były części drzewa trev;
+ * @param[in] shards – maska bitowa blokowanych części.
+ */
+static void shardsUnlock(struct PhoneForward *pf, bool reverse, unsigned int shards)
+{
+    if (pf->shards == NULL)
+        return;
+
+    pthread_mutex_t *locks = reverse ? pf->shards->reverse : pf->shards->forward;
+
+    for(int i = numberOfShards - 1; i >= 0; i--)
+    {
+        if (shards & (1u << i))
+            pthread_mutex_unlock(&locks[i]);
+    }
+}
+
+/** @brief Zwiększa numer wersji struktury.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ */
+static void phfwdChanged(struct PhoneForward *pf)
+{
+    if (pf->shards == NULL)
+    {
+        pf->generation++;
+        return;
+    }
+
+    pthread_mutex_lock(&pf->shards->shared);
+    pf->generation++;
+    pthread_mutex_unlock(&pf->shards->shared);
+}
+
+/** @brief Zakłada blokadę pisarza, jeśli struktura jest w trybie współbieżnym.
+ * Pisarze mogą trzymać ją jednocześnie, ale wykluczają zapytania.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ */
+static void phfwdWriteLock(struct PhoneForward *pf)
+{
+    if (pf->lock != NULL)
+        writeLock(pf->lock);
+}
+
+/** @brief Zdejmuje blokadę założoną przez @ref phfwdWriteLock.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ */
+static void phfwdWriteUnlock(struct PhoneForward *pf)
+{
+    if (pf->lock != NULL)
+        writeUnlock(pf->lock);
+}
+
+//komentarz w phone_forward.h
+bool phfwdSetConcurrent(struct PhoneForward *pf)
+{
+    if (pf == NULL || pf->origin != NULL || pf->snapshots > 0)
+        return false;
+
+    if (pf->lock != NULL)
+        return true;
+
+    // Zamrożonej struktury nikt nie zmienia, więc wystarczy blokada czytelników
+    if (pf->frozen != NULL)
+    {
+        pf->lock = readerLockNew();
+        return pf->lock != NULL;
+    }
+
+    // Synowie korzeni o różnych cyfrach są w różnych częściach drzew,
+    // więc korzenie nie mogą mieć wspólnych pól zmienianych przy zmianie synów
+    if (!sonsPin(&pf->arena, &pf->tfor->sons) || !sonsPin(&pf->arena, &pf->trev->sons))
+        return false;
+
+    pf->shards = shardsNew();
+    pf->lock = readerLockNew();
+
+    if (pf->shards == NULL || pf->lock == NULL)
+    {
+        shardsDelete(pf->shards);
+        readerLockDelete(pf->lock);
+        pf->shards = NULL;
+        pf->lock = NULL;
+
+        return false;
+    }
+
+    pf->arena.lock = &pf->shards->arena;
+    pf->numbers.lock = &pf->shards->numbers;
+
+    return true;
+}
+
+//komentarz w phone_forward.h
+void phfwdReadLock(struct PhoneForward const *pf)
+{
+    if (pf != NULL && pf->lock != NULL)
+        readLock(pf->lock);
+}
+
+//komentarz w phone_forward.h
+void phfwdReadUnlock(struct PhoneForward const *pf)
+{
+    if (pf != NULL && pf->lock != NULL)
+        readUnlock(pf->lock);
+}
+
+/** @brief Zapewnia, że korzenie drzew nie są współdzielone z migawkami.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ * @return Wartość @p true, jeśli korzenie nie są współdzielone.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool phfwdOwnRoots(struct PhoneForward *pf)
+{
+    void *root;
+
+    // Struktura w trybie współbieżnym nie ma migawek, więc jej korzenie nie są zapisywane
+    if (pf->tfor->refs > 1)
+    {
+        root = pf->tfor;
+
+        if (trieforOwn(pf, &root) == NULL)
+            return false;
+
+        pf->tfor = root;
+    }
+
+    if (pf->trev->refs > 1)
+    {
+        root = pf->trev;
+
+        if (trierevOwn(pf, &root) == NULL)
+            return false;
+
+        pf->trev = root;
+    }
+
+    return true;
+}
+
+/** @brief Dodaje przekierowanie poprawnych, różnych numerów.
+ * Wywoływana z założoną blokadą pisarza i blokadą części drzewa tfor
+ * z numerem @p num1.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num1   – wskaźnik na napis reprezentujący prefiks numerów
+ *                     przekierowywanych;
+ * @param[in] num2   – wskaźnik na napis reprezentujący prefiks numerów, na które
+ *                     jest wykonywane przekierowanie.
+ * @return Wartość @p true, jeśli przekierowanie zostało dodane.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool phfwdAddLocked(struct PhoneForward *pf, char const *num1, char const *num2)
+{
+    phfwdChanged(pf);
+
+    if (!phfwdOwnRoots(pf))
+        return false;
+
+    char const *source = poolIntern(&pf->numbers, num1);
+
+    if (source == NULL)
+        return false;
+
+    char const *target = poolIntern(&pf->numbers, num2);
+
+    if (target == NULL)
+    {
+        poolRelease(&pf->numbers, source);
+        return false;
+    }
+
+    const char *num = trieforGetForward(pf->tfor, (char *)num1);
+
+    // Zmieniane są drzewa reverse starego i nowego numeru docelowego
+    unsigned int shards = shardBit(num2) | (num != NULL ? shardBit(num) : 0);
+    bool result = true;
+
+    shardsLock(pf, true, shards);
+
+    if (num != NULL)
+        trierevRemoveOne(pf, pf->trev, num, source);
+
+    if (!trieforAdd(pf, pf->tfor, (char *)num1, source, target))
+    {
+        poolRelease(&pf->numbers, target);
+        poolRelease(&pf->numbers, source);
+        result = false;
+    }
+    else if (!trierevAdd(pf, pf->trev, (char *)num2, source))
+    {
+        poolRelease(&pf->numbers, source);
+        result = false;
+    }
+
+    shardsUnlock(pf, true, shards);
+
+    return result;
+}
+
+struct PhoneForward *phfwdNew()
+{
+    struct PhoneForward *t = malloc(sizeof(struct PhoneForward));
+
+    if (t == NULL)
+        return NULL;
+
+    arenaInit(&t->arena);
+    poolInit(&t->numbers, &t->arena);
+    countIndexInit(&t->shallowest);
+    t->countThreads = 1;
+    t->countPool = NULL;
+    // Wpisy z numerem wersji 0 są puste
+    t->generation = 1;
+    memset(t->countCache, 0, sizeof(t->countCache));
+    t->lock = NULL;
+    t->shards = NULL;
+    t->origin = NULL;
+    t->snapshots = 0;
+    t->deleted = false;
+    t->indexed = true;
+    t->frozen = NULL;
+    t->mapped = 0;
+    t->journal = NULL;
+    t->journalBase = NULL;
+    t->tfor = trieforNew(t);
+    t->trev = trierevNew(t);
+
+    if (t->tfor == NULL || t->trev == NULL)
+    {
+        phfwdDelete(t);
+        return NULL;
+    }
+
+    return t;
+}
+
+/** @brief Usuwa pamięć struktury, której nie potrzebują już migawki.
+ * @param[in] pf – wskaźnik na strukturę, która nie jest migawką.
+ */
+static void phfwdFree(struct PhoneForward *pf)
+{
+    // Wszystkie wierzchołki i numery są w arenie, więc nie trzeba przechodzić drzew
+    countIndexDestroy(&pf->shallowest);
+    poolDestroy(&pf->numbers);
+    arenaDestroy(&pf->arena);
+    readerLockDelete(pf->lock);
+    shardsDelete(pf->shards);
+
+    if (pf->mapped > 0)
+        munmap((void *)pf->frozen, pf->mapped);
+    else
+        free((void *)pf->frozen);
+
+    free(pf);
+}
+
+void phfwdDelete(struct PhoneForward *pf)
+{
+    if (pf == NULL)
+        return;
+
+    countPoolDelete(pf->countPool);
+    pf->countPool = NULL;
+
+    // Dziennik jest utrwalany przy usuwaniu, nawet jeśli pamięć zostaje dla migawek
+    journalClose(pf->journal);
+    free(pf->journalBase);
+    pf->journal = NULL;
+    pf->journalBase = NULL;
+
+    if (pf->origin == NULL && pf->snapshots == 0)
+    {
+        phfwdFree(pf);
+        return;
+    }
+
+    // Arena jest współdzielona z migawkami, więc zwalniane są tylko odwołania do drzew
+    struct PhoneForward *origin = pf->origin != NULL ? pf->origin : pf;
+
+    if (pf->tfor != NULL)
+        trieforRelease(origin, pf->tfor);
+
+    if (pf->trev != NULL)
+        trierevRelease(origin, pf->trev);
+
+    pf->tfor = NULL;
+    pf->trev = NULL;
+    countIndexDestroy(&pf->shallowest);
+
+    if (pf->origin == NULL)
+    {
+        pf->deleted = true;
+        return;
+    }
+
+    free(pf);
+
+    if (--origin->snapshots == 0 && origin->deleted)
+        phfwdFree(origin);
+}
+
+//komentarz w phone_forward.h
+struct PhoneForward *phfwdSnapshot(struct PhoneForward *pf)
+{
+    if (pf == NULL || pf->lock != NULL || pf->frozen != NULL)
+        return NULL;
+
+    struct PhoneForward *s = malloc(sizeof(struct PhoneForward));
+
+    if (s == NULL)
+        return NULL;
+
+    // Migawka nie alokuje niczego w swojej arenie, węzły należą do areny struktury origin
+    arenaInit(&s->arena);
+    poolInit(&s->numbers, &s->arena);
+    countIndexInit(&s->shallowest);
+    s->countThreads = pf->countThreads;
+    s->countPool = NULL;
+    s->generation = 1;
+    memset(s->countCache, 0, sizeof(s->countCache));
+    s->lock = NULL;
+    s->shards = NULL;
+    s->origin = pf->origin != NULL ? pf->origin : pf;
+    s->snapshots = 0;
+    s->deleted = false;
+    s->indexed = false;
+    s->frozen = NULL;
+    s->mapped = 0;
+    s->journal = NULL;
+    s->journalBase = NULL;
+    s->tfor = pf->tfor;
+    s->trev = pf->trev;
+    s->tfor->refs++;
+    s->trev->refs++;
+    s->origin->snapshots++;
+
+    return s;
+}
+
+/** @brief Zapisuje przekierowania w pliku dziennika i skraca dziennik.
+ * Wywołujący musi wykluczyć zmiany przekierowań @p pf.
+ * @param[in] pf – wskaźnik na strukturę z dziennikiem, która nie jest migawką.
+ * @return Wartość @p true, jeśli skrócono dziennik.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci lub
+ *         wystąpił błąd zapisu.
+ */
+static bool phfwdCompact(struct PhoneForward const *pf)
+{
+    struct FrozenForward *f = frozenBuild(pf);
 
-            t = t->sons[numAux[0] - zero];
+    if (f == NULL)
+        return false;
 
-            indeks++;
-            numAux++;
-        }
-        else
-        {
-            removeSub = false;
-            break;
-        }
-    }
+    // Dziennik jest przycinany dopiero po utrwaleniu pliku, a rekordy
+    // odtworzone po awarii między tymi krokami niczego nie zmieniają
+    bool result = frozenReplace(f, pf->journalBase) && journalReset(pf->journal);
 
-    if (removeSub)
-    {
-        // chcemy usunąć z tablicy reverse rzeczy, które musimy
+    free(f);
 
-        int idx = 0;
+    return result;
+}
 
-        for(int i = 0; i < t->reverse->size; i++)
-        {
-            if (strcmp(num2, t->reverse->tab[i]) == 0)
-            {
-                idx = i;
-                break;
-            }
-        }
+/** @brief Kończy zmianę przekierowań struktury z dziennikiem.
+ * Utrwala dziennik, jeżeli zebrało się w nim @p syncBatch rekordów, i skraca
+ * go, jeśli urósł ponad limit. Nic nie robi, jeśli struktura nie ma
+ * dziennika. Wywoływana bez blokad struktury.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] sync – czy trzeba utrwalić dziennik.
+ */
+static void phfwdJournaled(struct PhoneForward *pf, bool sync)
+{
+    if (pf->journal == NULL)
+        return;
 
-        t->reverse = phnumRemove(t->reverse, idx);
+    if (sync)
+        journalSync(pf->journal);
 
-        //Usuwanie poddrzewa
+    if (!journalFull(pf->journal))
+        return;
 
-        if (t->reverse->size == 0 && t->numberOfSons == 0)
-        {
-            trierevDelete(tAux->sons[num[depth] - zero]);
-            tAux->sons[num[depth] - zero] = NULL;
-            tAux->numberOfSons--;
-        }
+    // Blokada czytelnika wyklucza pisarzy, a inny wątek mógł już skrócić dziennik
+    phfwdReadLock(pf);
 
-    }
+    if (journalFull(pf->journal) && !phfwdCompact(pf))
+        journalPostpone(pf->journal);
+
+    phfwdReadUnlock(pf);
 }
 
-/** @brief Wyznacza przekierowania na prefiksy danego numeru w drzewie @p t.
- * Wyznacza wszystkie przekierowania na pefiksy danego numeru @p num. Wynikowy ciąg zawiera też
- * dany numer. Wynikowe numery są posortowane leksykograficznie i nie mogą się
- * powtarzać. Jeśli podany napis nie reprezentuje numeru, wynikiem jest pusty
- * ciąg. Alokuje strukturę @p PhoneNumbers, która musi być zwolniona za pomocą
- * funkcji @ref phnumDelete.
- * @param[in] t  – obiket typu Trie_reverse.
- * @param[in] num – wskaźnik na napis reprezentujący numer.
- * @return Wskaźnik na strukturę przechowującą ciąg numerów lub NULL, gdy nie
- *         udało się zaalokować pamięci.
+/** @brief Stosuje rekord dziennika odtwarzanego przez @ref phfwdRecover.
+ * @param[in,out] data – wskaźnik na strukturę bez dziennika;
+ * @param[in] add – czy rekord dodaje przekierowanie;
+ * @param[in] num1 – wskaźnik na pierwszy numer;
+ * @param[in] num2 – wskaźnik na drugi numer rekordu dodania lub NULL.
+ * @return Wartość @p true, jeśli zastosowano rekord.
+ *         Wartość @p false, jeśli rekord jest niepoprawny lub nie udało się
+ *         zaalokować pamięci.
  */
+static bool phfwdReplay(void *data, bool add, char const *num1, char const *num2)
+{
+    struct PhoneForward *pf = data;
 
-static struct PhoneNumbers *trierevReverse(Trie_reverse t, char *num)
+    if (add)
+        return phfwdAdd(pf, num1, num2);
+
+    if (!is_number(num1))
+        return false;
+
+    phfwdRemove(pf, num1);
+
+    return true;
+}
+
+//komentarz w phone_forward.h
+bool phfwdRollback(struct PhoneForward *pf, struct PhoneForward const *snapshot)
 {
-    struct PhoneNumbers *numbers = phnumNew(2);
-    numbers = phnumAdd(numbers, num);
-    char *numAux = num;
+    if (pf == NULL || snapshot == NULL || snapshot->origin != pf)
+        return false;
 
-    while(numAux[0] != '\0')
-    {
+    struct CountIndex shallowest;
 
-        if (t->sons[numAux[0] - zero] != NULL)
-        {
-            t = t->sons[numAux[0] - zero];
+    if (!trierevIndex(snapshot->trev, &shallowest))
+        return false;
 
-            char *numAux2;
+    // Dziennik nie ma rekordu przywrócenia, więc stan migawki trafia od razu
+    // do pliku; numery migawki leżą w puli pf, więc zapisywany jest widok pf
+    // z drzewami migawki
+    struct PhoneForward view = *pf;
 
-            for(int i = 0; i < t->reverse->size; i++)
-            {
-                numAux2 = (char *)merge_numbers(t->reverse->tab[i], numAux + 1);
-                numbers = phnumAdd(numbers, numAux2);
-                free(numAux2);
-            }
-        }
-        else
-            break;
+    view.tfor = snapshot->tfor;
+    view.trev = snapshot->trev;
+    view.shallowest = shallowest;
 
-        numAux++;
+    if (pf->journal != NULL && !phfwdCompact(&view))
+    {
+        countIndexDestroy(&shallowest);
+        return false;
     }
 
-    numbers = phnumUnique(numbers);
+    snapshot->tfor->refs++;
+    snapshot->trev->refs++;
+    trieforRelease(pf, pf->tfor);
+    trierevRelease(pf, pf->trev);
+    pf->tfor = snapshot->tfor;
+    pf->trev = snapshot->trev;
 
-    return numbers;
+    countIndexDestroy(&pf->shallowest);
+    pf->shallowest = shallowest;
+    pf->indexed = true;
+    pf->generation++;
+
+    return true;
 }
 
+/** @brief Zastępuje drzewa struktury zamrożonym blokiem.
+ * @param[in,out] pf – wskaźnik na strukturę, która nie jest migawką i nie ma migawek;
+ * @param[in] f – wskaźnik na nagłówek poprawnego bloku, który przejmuje struktura;
+ * @param[in] mapped – rozmiar odwzorowania pliku z blokiem lub 0, jeżeli blok zaalokowano.
+ */
+static void phfwdSetFrozen(struct PhoneForward *pf, struct FrozenForward const *f, size_t mapped)
+{
+    // Zamrożona struktura nie korzysta z drzew, więc zwalnia ich pamięć naraz
+    countIndexDestroy(&pf->shallowest);
+    poolDestroy(&pf->numbers);
+    arenaDestroy(&pf->arena);
+    pf->tfor = NULL;
+    pf->trev = NULL;
+    pf->frozen = f;
+    pf->mapped = mapped;
+}
 
-// PhoneForward
+//komentarz w phone_forward.h
+bool phfwdFreeze(struct PhoneForward *pf)
+{
+    if (pf == NULL || pf->lock != NULL || pf->origin != NULL || pf->snapshots > 0 || pf->journal != NULL)
+        return false;
 
-/** @brief Sprawdza, czy @p s wskazuje na poprawny numer.
- *
- * @param[in] s  – wskaźnik na ciąg znaków.
- * @return Wartość @p true, jeżeli @p s wskazuje na poprawny numer.
- *         Wartośc @p false w przeciwnym wypadku.
- */
+    if (pf->frozen != NULL)
+        return true;
 
-static bool is_number(char const *s)
+    struct FrozenForward *f = frozenBuild(pf);
+
+    if (f == NULL)
+        return false;
+
+    phfwdSetFrozen(pf, f, 0);
+
+    return true;
+}
+
+//komentarz w phone_forward.h
+bool phfwdSave(struct PhoneForward const *pf, char const *path)
 {
-    if (s == NULL)
+    if (pf == NULL || path == NULL || pf->origin != NULL)
         return false;
 
-    size_t len = strlen(s);
+    struct FrozenForward *built = NULL;
 
-    for(unsigned int i = 0; i < len; i++)
+    if (pf->frozen == NULL)
     {
-        if (s[i] < zero || s[i] > zero + numberOfDigits - 1)
+        phfwdReadLock(pf);
+        built = frozenBuild(pf);
+        phfwdReadUnlock(pf);
+
+        if (built == NULL)
             return false;
     }
 
-    return (len > 0);
+    bool result = frozenWrite(built != NULL ? built : pf->frozen, path, false);
+
+    free(built);
+
+    return result;
 }
 
+//komentarz w phone_forward.h
+struct PhoneForward *phfwdOpen(char const *path, bool verify)
+{
+    if (path == NULL)
+        return NULL;
+
+    int fd = open(path, O_RDONLY);
 
+    if (fd < 0)
+        return NULL;
 
-// Funkcje z phone_forward.h
+    struct stat st;
+    void *map = MAP_FAILED;
 
-struct PhoneForward *phfwdNew()
-{
-    struct PhoneForward *t = malloc(sizeof(struct PhoneForward));
-    t->tfor = trieforNew();
-    t->trev = trierevNew();
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (uint64_t)st.st_size >= sizeof(struct FrozenForward))
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
 
-    return t;
+    // Odwzorowanie pozostaje ważne po zamknięciu deskryptora
+    close(fd);
+
+    if (map == MAP_FAILED)
+        return NULL;
+
+    const struct FrozenForward *f = map;
+    bool valid = frozenHeaderValid(f, st.st_size)
+                 && (!verify || (frozenChecksum(f) == f->checksum && frozenValid(f, st.st_size)));
+    struct PhoneForward *pf = valid ? phfwdNew() : NULL;
+
+    if (pf == NULL)
+    {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    phfwdSetFrozen(pf, f, st.st_size);
+
+    return pf;
 }
 
-void phfwdDelete(struct PhoneForward *pf)
+//komentarz w phone_forward.h
+struct PhoneForward *phfwdLoad(char const *path)
 {
-    if (pf != NULL)
-    {
-        trieforDelete(pf->tfor);
-        trierevDelete(pf->trev);
+    if (path == NULL)
+        return NULL;
+
+    struct FrozenForward *f = frozenRead(path);
+
+    if (f == NULL)
+        return NULL;
 
-        free(pf);
+    struct PhoneForward *pf = phfwdNew();
+
+    if (pf != NULL && !frozenLoad(pf, f))
+    {
+        phfwdDelete(pf);
+        pf = NULL;
     }
+
+    free(f);
+
+    return pf;
 }
 
 bool phfwdAdd(struct PhoneForward *pf, char const *num1, char const *num2)
 {
-    if (pf == NULL)
+    // Migawki i struktury zamrożone są niezmienne
+    if (pf == NULL || pf->origin != NULL || pf->frozen != NULL)
         return false;
 
     if (!is_number(num1))
@@ -967,119 +4592,225 @@ bool phfwdAdd(struct PhoneForward *pf, char const *num1, char const *num2)
     if (strcmp(num1, num2) == 0)
         return false;
 
-    const char *num = trieforGetForward(pf->tfor, (char *)num1);
+    if (pf->journal != NULL && journalFailed(pf->journal))
+        return false;
 
-    if (num != NULL)
+    phfwdWriteLock(pf);
+    shardsLock(pf, false, shardBit(num1));
+
+    bool result = phfwdAddLocked(pf, num1, num2);
+    // Rekord jest dopisywany pod blokadą części, więc zmiany tych samych numerów są w kolejności
+    bool sync = result && pf->journal != NULL && journalAppend(pf->journal, true, num1, num2);
+
+    shardsUnlock(pf, false, shardBit(num1));
+    phfwdWriteUnlock(pf);
+    phfwdJournaled(pf, sync);
+
+    return result;
+}
+
+void phfwdRemove(struct PhoneForward *pf, char const *num)
+{
+    if (is_number(num) && pf != NULL && pf->origin == NULL && pf->frozen == NULL
+        && (pf->journal == NULL || !journalFailed(pf->journal)))
     {
-        trierevRemoveOne(pf->trev, (char *)num, (char *)num1);
-        free((char *)num);
+        struct RemovedRules rules = {NULL, 0, 0};
+        unsigned int shards = 0;
+        bool sync = false;
+
+        phfwdWriteLock(pf);
+        shardsLock(pf, false, shardBit(num));
+        phfwdChanged(pf);
+
+        if (phfwdOwnRoots(pf))
+            trieforRemove(pf, pf->tfor, (char *)num, &rules);
+
+        // Usunięte przekierowania mogą prowadzić do numerów z różnych części drzewa trev
+        for(size_t i = 0; i < rules.size; i++)
+            shards |= shardBit(rules.tab[i].target);
+
+        shardsLock(pf, true, shards);
+        trierevRemove(pf, pf->trev, &rules);
+        shardsUnlock(pf, true, shards);
+
+        // Usunięcie, które niczego nie zmieniło, nie musi trafiać do dziennika
+        if (rules.size > 0 && pf->journal != NULL)
+            sync = journalAppend(pf->journal, false, num, NULL);
+
+        shardsUnlock(pf, false, shardBit(num));
+
+        // Odwołania do puli przejęte z usuniętych wierzchołków
+        for(size_t i = 0; i < rules.size; i++)
+        {
+            poolRelease(&pf->numbers, rules.tab[i].source);
+            poolRelease(&pf->numbers, rules.tab[i].target);
+        }
+
+        phfwdWriteUnlock(pf);
+        free(rules.tab);
+        phfwdJournaled(pf, sync);
     }
+}
 
-    if (!trieforAdd(pf->tfor, (char *)num1, (char *)num2))
+bool phfwdGetView(struct PhoneForward const *pf, char const *num, struct PhoneForwardView *view)
+{
+    if (!is_number(num) || pf == NULL || view == NULL)
         return false;
 
-    return trierevAdd(pf->trev, (char *)num2, (char *)num1);
+    if (pf->frozen != NULL)
+        frozenGetView(pf->frozen, num, view);
+    else
+        trieforGetView(pf->tfor, num, view);
+
+    return true;
 }
 
-void phfwdRemove(struct PhoneForward *pf, char const *num)
+bool phfwdGetBatch(struct PhoneForward const *pf, char const *const *nums, size_t count,
+                   struct PhoneForwardView *views)
 {
-    if (is_number(num) && pf != NULL)
+    if (pf == NULL || (count > 0 && (nums == NULL || views == NULL)))
+        return false;
+
+    // Zamrożone drzewo jest zwarte, więc numery są wyznaczane po kolei bez sortowania
+    if (pf->frozen != NULL)
+    {
+        for(size_t i = 0; i < count; i++)
+        {
+            if (!phfwdGetView(pf, nums[i], &views[i]))
+                views[i] = (struct PhoneForwardView){"", 0, NULL};
+        }
+
+        return true;
+    }
+
+    char const *const **sorted = malloc((count > 0 ? count : 1) * sizeof(char const *const *));
+
+    if (sorted == NULL)
+        return false;
+
+    size_t valid = 0;
+    bool isSorted = true;
+
+    for(size_t i = 0; i < count; i++)
     {
-        struct PhoneNumbers *pnum;
-        pnum = trieforRemove(pf->tfor, (char *)num);
-        trierevRemove(pf->trev, pnum, (char *)num);
-        phnumDelete(pnum);
+        if (!is_number(nums[i]))
+        {
+            views[i] = (struct PhoneForwardView){"", 0, NULL};
+            continue;
+        }
+
+        if (valid > 0 && strcmp(*sorted[valid - 1], nums[i]) > 0)
+            isSorted = false;
+
+        sorted[valid++] = &nums[i];
     }
+
+    if (!isSorted)
+        qsort(sorted, valid, sizeof(char const *const *), comparePointed);
+
+    bool result = trieforGetBatch(pf->tfor, sorted, valid, nums, views);
+
+    free(sorted);
+
+    return result;
 }
 
 struct PhoneNumbers const * phfwdGet(struct PhoneForward *pf, char const *num)
 {
-    if (is_number(num) && pf != NULL)
-        return trieforGet(pf->tfor, (char *)num);
+    struct PhoneNumbers *number = phnumNew(1);
+    struct PhoneForwardView view;
 
-    return phnumNew(1);
+    if (number == NULL || pf == NULL)
+        return number;
 
+    phfwdReadLock(pf);
+
+    if (phfwdGetView(pf, num, &view))
+        number = phnumAppend(number, merge_numbers(view.prefix, view.suffix));
+
+    phfwdReadUnlock(pf);
+
+    return number;
 }
 
 struct PhoneNumbers const * phfwdReverse(struct PhoneForward *pf, char const *num)
 {
     if (is_number(num) && pf != NULL)
-        return trierevReverse(pf->trev, (char *)num);
+    {
+        phfwdReadLock(pf);
 
-    return phnumNew(1);
-}
+        struct PhoneNumbers const *result;
 
-// NonTrivialCount
+        if (pf->frozen != NULL)
+            result = frozenReverse(pf->frozen, num);
+        else
+            result = trierevReverse(pf->trev, (char *)num);
 
-/** @brief Podnosi @p basis do potęgi @p idx.
- *
- * @param[in] basis  – podstawa.
- * @param[in] idx  – wykładnik.
- * @return Zwraca wartość modulo rozmiar zakres size_t.
- */
+        phfwdReadUnlock(pf);
 
-size_t power(size_t basis, size_t idx)
-{
-    size_t result = 1, aux = basis;
+        return result;
+    }
 
-    while(idx > 0){
+    return phnumNew(1);
+}
 
-        if (idx % 2 == 1)
-            result *= aux;
+//komentarz w phone_forward.h
+void phfwdSetCountThreads(struct PhoneForward *pf, unsigned int threads)
+{
+    if (pf == NULL)
+        return;
 
-        aux*=aux;
-        idx /= 2;
-    }
+    threads = threads > 0 ? threads : 1;
 
-    return result;
+    if (threads == pf->countThreads && (threads == 1 || pf->countPool != NULL))
+        return;
+
+    countPoolDelete(pf->countPool);
+    pf->countThreads = threads;
+    // Bez puli zapytania liczą w jednym wątku
+    pf->countPool = threads > 1 ? countPoolNew(threads - 1) : NULL;
 }
 
-/** @brief Wylicza liczbę nietrywialnych numerów, którą wnioskuje z poddrzewa.
- *
- * @param[in] trev  – wskażnik na strukturę Trie_Reverse.
- * @param[in] len  – długość numerów.
- * @param[in] basis  – liczba różnych cyfr, które rozpatrujemy.
- * @param[in] setDigits  – tablica z wartościami, które wskazują, które cyfry są w secie.
- * @param[in] depth  – Aktualne głębokośc dfs - a.
- *
- * @return Wylicza liczbę nietrywialnych numerów, którą wnioskuje z poddrzewa.
+/** @brief Zapewnia, że indeks najpłytszych niepustych wierzchołków jest aktualny.
+ * Migawki budują indeks przy pierwszym liczeniu, a pozostałe struktury,
+ * gdy nie udało się go zaktualizować przy zmianie przekierowań.
+ * @param[in,out] pf – wskaźnik na strukturę, której nikt nie zmienia.
+ * @return Wartość @p true, jeśli indeks jest aktualny.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
  */
-
-size_t dfsNonTrivialCount(Trie_reverse trev, size_t len, size_t basis, bool *setDigits, size_t depth)
+static bool phfwdIndex(struct PhoneForward *pf)
 {
-    size_t res = 0;
-
-    if (len < depth)
-        return 0;
-
-    if (trev->reverse->size > 0)
-        return power(basis, len - depth);
+    // Współbieżne zapytania mogą budować indeks naraz
+    if (pf->shards != NULL)
+        pthread_mutex_lock(&pf->shards->shared);
 
-    for(int i = 0; i < numberOfDigits; i++)
+    if (!pf->indexed)
     {
-        if (setDigits[i] && trev->sons[i] != NULL)
-            res += dfsNonTrivialCount(trev->sons[i], len, basis, setDigits, depth + 1);
+        countIndexDestroy(&pf->shallowest);
+        pf->indexed = trierevIndex(pf->trev, &pf->shallowest);
     }
 
-    return res;
+    bool indexed = pf->indexed;
+
+    if (pf->shards != NULL)
+        pthread_mutex_unlock(&pf->shards->shared);
+
+    return indexed;
 }
 
 //komentarz w phone_forward.h
 size_t phfwdNonTrivialCount(struct PhoneForward *pf, char const *set, size_t len)
 {
     // Sprawdza jakie cyfry są w napisie set
-    bool setDigits[numberOfDigits];
     char *numAux = (char *)set;
     size_t setNumberOfDigits = 0;
-
-    for(int i = 0; i < numberOfDigits; i++)
-        setDigits[i] = false;
+    unsigned int mask = 0;
 
     while(numAux[0] != '\0')
     {
-        if (!setDigits[numAux[0] - zero] && numAux[0] >= zero && numAux[0] < zero + numberOfDigits)
+        if (numAux[0] >= zero && numAux[0] < zero + numberOfDigits && !(mask & (1u << (numAux[0] - zero))))
         {
-            setDigits[numAux[0] - zero] = true;
+            mask |= 1u << (numAux[0] - zero);
             setNumberOfDigits++;
         }
 
@@ -1089,6 +4820,102 @@ size_t phfwdNonTrivialCount(struct PhoneForward *pf, char const *set, size_t len
     if (setNumberOfDigits == 0 || len == 0 || pf == NULL)
         return 0;
 
+    phfwdReadLock(pf);
+
+    if (!phfwdIndex(pf))
+    {
+        phfwdReadUnlock(pf);
+        return 0;
+    }
+
+    // Wynik zależy tylko od zbioru cyfr i len, więc można go zapamiętać do zmiany przekierowań.
+    // Współbieżne zapytania nie korzystają z pamięci wyników, bo równolegle by ją zmieniały.
+    struct CountCacheEntry *entry = NULL;
+
+    if (pf->lock == NULL)
+    {
+        entry = &pf->countCache[(mask * 31 + len * 2654435761u) % countCacheSize];
+
+        if (entry->generation == pf->generation && entry->mask == mask && entry->len == len)
+            return entry->result;
+    }
+
+    // Liczą się najpłytsze niepuste wierzchołki z cyframi z set na ścieżce
+    struct CountTask task = {&pf->shallowest, NULL, pf->shallowest.capacity, mask, len, setNumberOfDigits, 0};
+    size_t result;
+
+    // Tablica grup zamrożonej struktury nie ma pustych miejsc
+    if (pf->frozen != NULL)
+    {
+        task.frozen = frozenAt(pf->frozen, pf->frozen->countOffset);
+        task.size = pf->frozen->countSize;
+    }
+
+    if (pf->countPool != NULL && task.size >= countParallelThreshold)
+        result = countParallel(&task, pf->countPool);
+    else
+        result = countTaskRange(&task, 0, task.size);
+
+    phfwdReadUnlock(pf);
+
+    if (entry != NULL)
+        *entry = (struct CountCacheEntry){pf->generation, len, mask, result};
+
+    return result;
+}
+
+//komentarz w phone_forward.h
+struct PhoneForward *phfwdRecover(char const *path, unsigned int syncBatch, size_t compactSize)
+{
+    if (path == NULL)
+        return NULL;
+
+    size_t length = strlen(path);
+    char *journal = malloc(length + sizeof(".journal"));
+    struct PhoneForward *pf = NULL;
+
+    if (journal == NULL)
+        return NULL;
+
+    memcpy(journal, path, length);
+    memcpy(journal + length, ".journal", sizeof(".journal"));
+
+    // Brak pliku z przekierowaniami oznacza, że dziennik nie był jeszcze skracany
+    if (access(path, F_OK) == 0)
+        pf = phfwdLoad(path);
+    else if (errno == ENOENT)
+        pf = phfwdNew();
+
+    if (pf != NULL && journalReplay(journal, phfwdReplay, pf))
+    {
+        pf->journalBase = malloc(length + 1);
+
+        if (pf->journalBase != NULL)
+        {
+            memcpy(pf->journalBase, path, length + 1);
+            pf->journal = journalOpen(journal, syncBatch, compactSize);
+        }
+    }
+
+    free(journal);
+
+    if (pf != NULL && pf->journal == NULL)
+    {
+        phfwdDelete(pf);
+        return NULL;
+    }
+
+    if (pf != NULL && journalFull(pf->journal) && !phfwdCompact(pf))
+        journalPostpone(pf->journal);
+
+    return pf;
+}
+
+//komentarz w phone_forward.h
+bool phfwdSync(struct PhoneForward *pf)
+{
+    if (pf == NULL || pf->journal == NULL)
+        return false;
 
-    return dfsNonTrivialCount(pf->trev, len, setNumberOfDigits, setDigits, 0);
+    return journalSync(pf->journal);
 }
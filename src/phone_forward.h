@@ -33,61 +33,9 @@ struct PhoneNumbers
     char const **tab; ///< tablica przechowująca wskaźniki na numery telefonów
 };
 
-struct Node_forward;
-
-/**
- * Typ reprezentujący drzewo trie, które odpowiada za
- * przekierowania typy forward.
- */
-typedef struct Node_forward* Trie_forward;
-
-/**
- * @brief Węzeł drzewa Trie_forward
- *
- * Struktura, która reprezentuje węzeł drzewa trie,
- * które odpowiada za przekierowania typu forward.
- */
-
-struct Node_forward
-{
-    char *forwarding; ///< numer, na który przekierowywana jest ścieżka w drzewie do tego węzła
-    Trie_forward *sons; ///< wskaźniki na synów węzła
-    int numberOfSons; ///< liczba synów węzła
-};
-
-
-struct Node_reverse;
-
-/**
- * Typ reprezentujący drzewo trie, które odpowiada za
- * przekierowania typu reverse.
- */
-typedef struct Node_reverse* Trie_reverse;
-
-/**
- * @brief Węzeł drzewa Trie_reverse
- *
- * Struktura, która reprezentuje węzeł drzewa trie,
- * które odpowiada za przekierowania typu reverse.
- */
-
-struct Node_reverse
-{
-    struct PhoneNumbers *reverse; ///< numery, które są przekierowywane na ścieżkę w drzewie do tego węzła
-    Trie_reverse *sons; ///< wskaźniki na synów węzła
-    int numberOfSons; ///< liczba synów węzła
-};
-
-
-/**
- * Struktura przechowująca przekierowania numerów telefonów.
- */
-
-struct PhoneForward
-{
-    Trie_forward tfor; ///< drzewo za pomocą którego analizuje się zapytania forward
-    Trie_reverse trev; ///< drzewo za pomocą którego analizuje się zapytania reverse
-};
+// Struktura przechowująca przekierowania numerów telefonów; jej pola są
+// opisane w phone_forward_internal.h i nie są częścią interfejsu
+struct PhoneForward;
 
 
 /** @brief Tworzy nową strukturę.
@@ -116,15 +64,16 @@ void phfwdDelete(struct PhoneForward *pf);
  *                   jest wykonywane przekierowanie.
  * @return Wartość @p true, jeśli przekierowanie zostało dodane.
  *         Wartość @p false, jeśli wystąpił błąd, np. podany napis nie
- *         reprezentuje numeru, oba podane numery są identyczne lub nie udało
- *         się zaalokować pamięci.
+ *         reprezentuje numeru, oba podane numery są identyczne, @p pf jest
+ *         migawką lub strukturą zamrożoną albo nie udało się zaalokować pamięci.
  */
 bool phfwdAdd(struct PhoneForward *pf, char const *num1, char const *num2);
 
 /** @brief Usuwa przekierowania.
  * Usuwa wszystkie przekierowania, w których parametr @p num jest prefiksem
  * parametru @p num1 użytego przy dodawaniu. Jeśli nie ma takich przekierowań
- * lub napis nie reprezentuje numeru, nic nie robi.
+ * lub napis nie reprezentuje numeru, nic nie robi. Nic nie robi też dla migawki
+ * i struktury zamrożonej.
  *
  * @param[in] pf  – wskaźnik na strukturę przechowującą przekierowania numerów;
  * @param[in] num – wskaźnik na napis reprezentujący prefiks numerów.
@@ -144,6 +93,58 @@ void phfwdRemove(struct PhoneForward *pf, char const *num);
  */
 struct PhoneNumbers const * phfwdGet(struct PhoneForward *pf, char const *num);
 
+/**
+ * @brief Wynik przekierowania numeru bez alokowania pamięci.
+ *
+ * Przekierowany numer to @p prefix, po którym następuje @p suffix. Oba napisy
+ * są pożyczone: @p prefix należy do puli numerów struktury, a @p suffix
+ * jest końcówką numeru podanego w zapytaniu. Są poprawne do następnej
+ * modyfikacji struktury lub zmiany numeru podanego w zapytaniu.
+ */
+
+struct PhoneForwardView
+{
+    char const *prefix; ///< numer, na który przekierowano prefiks, lub pusty napis
+    size_t prefixLength; ///< długość @p prefix
+    char const *suffix; ///< niedopasowana końcówka numeru podanego w zapytaniu
+};
+
+/** @brief Wyznacza przekierowanie numeru bez alokowania pamięci.
+ * Działa tak jak @ref phfwdGet, ale zamiast tworzyć nowy numer zapisuje
+ * w @p view numer, na który przekierowano najdłuższy pasujący prefiks, oraz
+ * niedopasowaną końcówkę @p num. Jeśli numer nie został przekierowany, to
+ * prefiks jest pusty, a końcówką jest cały @p num.
+ * Wynik wskazuje na numery z @p pf, więc w trybie współbieżnym wywołanie
+ * i korzystanie z wyniku trzeba otoczyć wywołaniami @ref phfwdReadLock
+ * i @ref phfwdReadUnlock.
+ * @param[in] pf   – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] num  – wskaźnik na napis reprezentujący numer;
+ * @param[out] view – wskaźnik na strukturę, w której zapisywany jest wynik.
+ * @return Wartość @p true, jeśli wyznaczono przekierowanie.
+ *         Wartość @p false, jeśli @p pf lub @p view ma wartość NULL albo
+ *         podany napis nie reprezentuje numeru.
+ */
+bool phfwdGetView(struct PhoneForward const *pf, char const *num, struct PhoneForwardView *view);
+
+/** @brief Wyznacza przekierowania wielu numerów.
+ * Działa tak jak @ref phfwdGetView wywołane dla każdego numeru z @p nums,
+ * ale przechodzi numery w porządku leksykograficznym i dla każdego z nich
+ * schodzi w drzewie tylko poniżej prefiksu wspólnego z poprzednim numerem.
+ * Numery już posortowane nie są sortowane ponownie. Wyniki są zapisywane
+ * w @p views w kolejności numerów w @p nums; dla napisu, który nie
+ * reprezentuje numeru, pole @p suffix wyniku ma wartość NULL. W trybie
+ * współbieżnym obowiązują te same zasady co dla @ref phfwdGetView.
+ * @param[in] pf    – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] nums  – tablica wskaźników na napisy reprezentujące numery;
+ * @param[in] count – liczba numerów w @p nums;
+ * @param[out] views – tablica co najmniej @p count wyników.
+ * @return Wartość @p true, jeśli wyznaczono przekierowania.
+ *         Wartość @p false, jeśli któryś z wskaźników ma wartość NULL lub
+ *         nie udało się zaalokować pamięci.
+ */
+bool phfwdGetBatch(struct PhoneForward const *pf, char const *const *nums, size_t count,
+                   struct PhoneForwardView *views);
+
 /** @brief Wyznacza przekierowania na dany numer.
  * Wyznacza wszystkie przekierowania na podany numer. Wynikowy ciąg zawiera też
  * dany numer. Wynikowe numery są posortowane leksykograficznie i nie mogą się
@@ -188,7 +189,9 @@ char const * phnumGet(struct PhoneNumbers const *pnum, size_t idx);
 
 /** @brief Oblicza liczbę nietrywialnych numerów
  * Oblicza liczbę nietrywialnych numerów długości @p len, które składają
- * się z cyfr z @p set, mod 2^(liczba bitów size_t)
+ * się z cyfr z @p set, mod 2^(liczba bitów size_t). Wynik jest zapamiętywany
+ * w strukturze, więc powtórzone zapytanie o ten sam zbiór cyfr i @p len bez
+ * zmian przekierowań pomiędzy nimi jest wykonywane w czasie stałym.
  * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania numerów;
  * @param[in] set  – zbiór znaków.
  * @param[in] len  – długość numerów, które rozpatrujemy.
@@ -199,4 +202,183 @@ char const * phnumGet(struct PhoneNumbers const *pnum, size_t idx);
  */
 size_t phfwdNonTrivialCount(struct PhoneForward *pf, char const *set, size_t len);
 
+/** @brief Ustawia liczbę wątków liczących nietrywialne numery.
+ * Domyślnie @ref phfwdNonTrivialCount liczy w jednym wątku. Przy większej
+ * liczbie wątków tworzona jest pula @p threads - 1 stałych wątków, które
+ * razem z wątkiem wywołującym dzielą duże indeksy na części i biorą je po
+ * kolei; wynik jest taki sam jak przy liczeniu w jednym wątku. Wątki puli
+ * kończą się przy zmianie ich liczby i w @ref phfwdDelete. Jeżeli pula
+ * liczy już zapytanie innego wątku, kolejne zapytanie liczy się w jednym
+ * wątku. Migawki nie dziedziczą puli. Funkcji nie można wywoływać
+ * równolegle z innymi funkcjami dla tej samej struktury. Nic nie robi,
+ * jeśli @p pf ma wartość NULL.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] threads – liczba wątków; 0 oznacza jeden wątek.
+ */
+void phfwdSetCountThreads(struct PhoneForward *pf, unsigned int threads);
+
+/** @brief Tworzy migawkę przekierowań.
+ * Migawka jest niezmienną strukturą z przekierowaniami z chwili jej
+ * utworzenia, którą można odpytywać tak jak @p pf. Węzły drzew są
+ * współdzielone, więc migawka powstaje w czasie stałym, a późniejsza zmiana
+ * przekierowań w @p pf kopiuje tylko współdzielone węzły na zmienianej
+ * ścieżce. Migawkę usuwa się funkcją @ref phfwdDelete, także po usunięciu
+ * @p pf. Migawkę może odpytywać inny wątek niż ten, który zmienia @p pf,
+ * ale tworzenie i usuwanie migawek musi się odbywać w wątku zmieniającym
+ * @p pf. Migawka migawki współdzieli węzły z tą samą strukturą.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ * @return Wskaźnik na migawkę lub NULL, jeśli @p pf ma wartość NULL, jest
+ *         w trybie współbieżnym, jest zamrożona lub nie udało się zaalokować
+ *         pamięci.
+ */
+struct PhoneForward * phfwdSnapshot(struct PhoneForward *pf);
+
+/** @brief Przywraca przekierowania z migawki.
+ * Po wywołaniu @p pf zawiera te same przekierowania co @p snapshot.
+ * Drzewa są przejmowane w czasie stałym, a indeks używany przez
+ * @ref phfwdNonTrivialCount jest budowany od nowa.
+ * Jeżeli @p pf ma dziennik (zob. @ref phfwdRecover), to przekierowania
+ * migawki są najpierw zapisywane w pliku z przekierowaniami, a dziennik
+ * jest skracany.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] snapshot – wskaźnik na migawkę utworzoną z @p pf.
+ * @return Wartość @p true, jeśli przywrócono przekierowania.
+ *         Wartość @p false, jeśli któryś ze wskaźników ma wartość NULL,
+ *         @p snapshot nie jest migawką @p pf, nie udało się zaalokować
+ *         pamięci lub zapisać pliku (wtedy @p pf się nie zmienia).
+ */
+bool phfwdRollback(struct PhoneForward *pf, struct PhoneForward const *snapshot);
+
+/** @brief Włącza tryb współbieżny.
+ * W trybie współbieżnym funkcje @ref phfwdAdd, @ref phfwdRemove,
+ * @ref phfwdGet, @ref phfwdReverse i @ref phfwdNonTrivialCount można wywoływać
+ * z wielu wątków naraz. Zapytania wykonują się równolegle. Zmiany
+ * przekierowań czekają na zakończenie trwających zapytań i wykonują się
+ * równolegle ze sobą, jeżeli dotyczą prefiksów i numerów docelowych
+ * o różnych pierwszych cyfrach.
+ * Zapytania nie korzystają wtedy z zapamiętanych wyników
+ * @ref phfwdNonTrivialCount. Funkcję trzeba wywołać, zanim strukturę zacznie
+ * używać więcej niż jeden wątek. Struktura w trybie współbieżnym nie może
+ * mieć migawek. Struktury zamrożonej nikt nie zmienia, więc tryb współbieżny
+ * wyłącza dla niej tylko zapamiętywanie wyników.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ * @return Wartość @p true, jeśli struktura jest w trybie współbieżnym.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, jest migawką lub ma
+ *         migawki albo nie udało się zaalokować pamięci.
+ */
+bool phfwdSetConcurrent(struct PhoneForward *pf);
+
+/** @brief Rozpoczyna odczyt struktury w trybie współbieżnym.
+ * Dopóki wątek nie wywoła @ref phfwdReadUnlock, przekierowania w @p pf się
+ * nie zmieniają i wyniki @ref phfwdGetView oraz @ref phfwdGetBatch pozostają
+ * ważne. W tym czasie wątek nie może zmieniać przekierowań ani wywoływać
+ * @ref phfwdGet, @ref phfwdReverse i @ref phfwdNonTrivialCount. Nic nie robi,
+ * jeśli @p pf ma wartość NULL lub nie jest w trybie współbieżnym.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ */
+void phfwdReadLock(struct PhoneForward const *pf);
+
+/** @brief Kończy odczyt rozpoczęty przez @ref phfwdReadLock.
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ */
+void phfwdReadUnlock(struct PhoneForward const *pf);
+
+/** @brief Zamraża strukturę.
+ * Zastępuje drzewa @p pf niezmiennym, zwartym układem w jednym bloku
+ * pamięci (zob. @ref FrozenForward): wierzchołki obu drzew leżą w tablicach
+ * w kolejności przechodzenia wszerz, a etykiety i numery w tablicach znaków.
+ * Funkcje @ref phfwdGet, @ref phfwdGetView, @ref phfwdGetBatch,
+ * @ref phfwdReverse i @ref phfwdNonTrivialCount działają bezpośrednio na tym
+ * układzie i dają te same wyniki co przed zamrożeniem. Przekierowań
+ * zamrożonej struktury nie można już zmieniać ani tworzyć jej migawek.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ * @return Wartość @p true, jeśli struktura jest zamrożona.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, jest w trybie
+ *         współbieżnym, jest migawką, ma migawki lub dziennik albo nie udało
+ *         się zaalokować pamięci (wtedy @p pf się nie zmienia).
+ */
+bool phfwdFreeze(struct PhoneForward *pf);
+
+/** @brief Zapisuje przekierowania w pliku.
+ * Zapisuje w pliku @p path blok zamrożonej struktury (zob.
+ * @ref FrozenForward) z uzupełnioną sumą kontrolną. Struktura, która nie jest
+ * zamrożona, jest na czas zapisu zamrażana w osobnym bloku, a sama się nie
+ * zmienia. W trybie współbieżnym zapis wstrzymuje zmiany przekierowań.
+ * @param[in] pf   – wskaźnik na strukturę przechowującą przekierowania numerów;
+ * @param[in] path – ścieżka pliku.
+ * @return Wartość @p true, jeśli zapisano przekierowania.
+ *         Wartość @p false, jeśli któryś ze wskaźników ma wartość NULL,
+ *         @p pf jest migawką, nie udało się zaalokować pamięci lub
+ *         wystąpił błąd zapisu.
+ */
+bool phfwdSave(struct PhoneForward const *pf, char const *path);
+
+/** @brief Wczytuje przekierowania z pliku.
+ * Tworzy nową strukturę z przekierowaniami zapisanymi przez @ref phfwdSave.
+ * Drzewa są odtwarzane wierzchołek po wierzchołku w jednym przejściu pliku,
+ * bez wyszukiwania miejsc w drzewach, a drzewa AVL numerów są budowane od
+ * razu zrównoważone. Plik jest odrzucany, jeżeli ma inną wersję, niezgodną
+ * sumę kontrolną lub niespójne położenia tablic.
+ * @param[in] path – ścieżka pliku.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, jeśli @p path ma wartość
+ *         NULL, nie udało się odczytać pliku, plik jest niepoprawny lub nie
+ *         udało się zaalokować pamięci.
+ */
+struct PhoneForward * phfwdLoad(char const *path);
+
+/** @brief Otwiera plik z przekierowaniami bez wczytywania go.
+ * Odwzorowuje w pamięci plik zapisany przez @ref phfwdSave tylko do odczytu
+ * i tworzy zamrożoną strukturę (zob. @ref phfwdFreeze), która odpytuje plik
+ * bezpośrednio. Strony pliku są wczytywane przy pierwszym dostępie
+ * i współdzielone przez wszystkie procesy, które otworzyły ten sam plik.
+ * Bez sprawdzania zawartości otwarcie zajmuje czas stały, ale wtedy plik
+ * musi pochodzić z @ref phfwdSave i nie może być zmieniany, dopóki
+ * struktura istnieje; sprawdzany jest tylko nagłówek. Strukturę usuwa się
+ * funkcją @ref phfwdDelete.
+ * @param[in] path   – ścieżka pliku;
+ * @param[in] verify – czy sprawdzić sumę kontrolną i zawartość pliku tak jak
+ *                     @ref phfwdLoad (w czasie liniowym).
+ * @return Wskaźnik na utworzoną strukturę lub NULL, jeśli @p path ma wartość
+ *         NULL, nie udało się odwzorować pliku, plik jest niepoprawny lub nie
+ *         udało się zaalokować pamięci.
+ */
+struct PhoneForward * phfwdOpen(char const *path, bool verify);
+
+/** @brief Tworzy strukturę z dziennikiem zmian.
+ * Wczytuje przekierowania z pliku @p path (zob. @ref phfwdLoad), jeżeli
+ * istnieje, i odtwarza na nich dziennik z pliku o ścieżce @p path
+ * z dopisanym ".journal". Plik dziennika jest wczytywany jednym odczytem,
+ * a rekordy są stosowane bez blokad i bez dopisywania ich od nowa; rekord
+ * uszkodzony przez przerwany zapis i dalsze są odrzucane. Następnie
+ * @ref phfwdAdd i @ref phfwdRemove, które zmieniają przekierowania,
+ * dopisują rekordy do dziennika. Rekordy są zapisywane w pliku buforami,
+ * a utrwalane po każdych @p syncBatch rekordach lub w @ref phfwdSync; wątki
+ * wywołujące wtedy @ref phfwdSync czekają na jedno wspólne utrwalenie.
+ * Gdy dziennik urośnie o więcej niż @p compactSize bajtów, przekierowania
+ * są zapisywane do pliku tymczasowego, który zastępuje @p path, a dziennik
+ * jest skracany do pustego. Przerwanie w trakcie skracania nie psuje stanu,
+ * bo ponowne odtworzenie tych samych rekordów nie zmienia przekierowań.
+ * Po błędzie zapisu dziennika struktura przestaje przyjmować zmiany.
+ * @param[in] path        – ścieżka pliku z przekierowaniami;
+ * @param[in] syncBatch   – liczba rekordów, po której dziennik jest
+ *                          utrwalany; 0 oznacza 1;
+ * @param[in] compactSize – rozmiar dziennika w bajtach, po którym jest
+ *                          skracany.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, jeśli @p path ma wartość
+ *         NULL, plik z przekierowaniami lub dziennik są niepoprawne, nie
+ *         udało się ich odczytać lub otworzyć dziennika albo nie udało się
+ *         zaalokować pamięci.
+ */
+struct PhoneForward * phfwdRecover(char const *path, unsigned int syncBatch, size_t compactSize);
+
+/** @brief Utrwala dziennik zmian.
+ * Po powrocie wszystkie zmiany przekierowań wykonane przed wywołaniem są
+ * zapisane na dysku i zostaną odtworzone przez @ref phfwdRecover.
+ * @param[in,out] pf – wskaźnik na strukturę przechowującą przekierowania numerów.
+ * @return Wartość @p true, jeśli utrwalono zmiany.
+ *         Wartość @p false, jeśli @p pf ma wartość NULL, nie ma dziennika
+ *         lub wystąpił błąd zapisu.
+ */
+bool phfwdSync(struct PhoneForward *pf);
+
 #endif /* __PHONE_FORWARD_H__ */
@@ -0,0 +1,352 @@
+/** @file
+ * Wewnętrzne struktury modułu phone_forward
+ *
+ * Układ struktury @ref PhoneForward, węzłów jej drzew i zamrożonego bloku.
+ * Nagłówek dołączają tylko pliki modułu, testy, które sprawdzają układ
+ * zapisywanego pliku, i program mierzący wydajność; programy korzystające
+ * z przekierowań dołączają phone_forward.h, w którym struktura jest
+ * nieprzezroczysta.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#ifndef __PHONE_FORWARD_INTERNAL_H__
+#define __PHONE_FORWARD_INTERNAL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "arena.h"
+#include "count_index.h"
+#include "journal.h"
+#include "number_pool.h"
+#include "phone_forward.h"
+#include "reader_lock.h"
+
+/**
+ * Maksymalna liczba synów węzła przechowywanych w małej tablicy
+ */
+#define smallSons 4
+
+/**
+ * @brief Synowie węzła drzewa trie.
+ *
+ * Węzły, które mają co najwyżej @ref smallSons synów, przechowują ich
+ * w małej tablicy posortowanej według cyfr (cyfry są w @p keys).
+ * Węzły z większą liczbą synów mają pełną tablicę indeksowaną cyfrą.
+ * Liście nie mają tablicy wcale.
+ */
+
+struct TrieSons
+{
+    void **tab; ///< tablica wskaźników na synów lub NULL, jeżeli węzeł nie ma synów
+    unsigned char capacity; ///< rozmiar tablicy @p tab: 0, smallSons lub liczba cyfr
+    unsigned char numberOfSons; ///< liczba synów węzła
+    unsigned char keys[smallSons]; ///< cyfry kolejnych synów z małej tablicy
+    bool pinned; ///< czy pełna tablica nigdy nie zmienia rozmiaru, a @p numberOfSons nie jest aktualizowane
+};
+
+/**
+ * Maksymalna długość etykiety krawędzi przechowywanej bezpośrednio w węźle
+ */
+#define inlineLabel 8
+
+/**
+ * @brief Etykieta krawędzi skompresowanego drzewa trie.
+ *
+ * Ciąg cyfr na krawędzi prowadzącej od ojca do węzła (pierwsza cyfra
+ * wyznacza, którym synem ojca jest węzeł). Krótkie etykiety są
+ * przechowywane w węźle, dłuższe w osobnej tablicy. Etykieta nie jest
+ * zakończona znakiem '\0'.
+ */
+
+struct TrieLabel
+{
+    /// cyfry etykiety
+    union
+    {
+        char inl[inlineLabel]; ///< cyfry etykiety o długości co najwyżej inlineLabel
+        char *ptr; ///< wskaźnik na cyfry dłuższej etykiety
+    } digits;
+    unsigned int length; ///< długość etykiety
+};
+
+struct Node_forward;
+
+/**
+ * Typ reprezentujący drzewo trie, które odpowiada za
+ * przekierowania typy forward. Drzewo jest skompresowane: ciągi
+ * wierzchołków bez rozgałęzień i przekierowań są zastąpione jedną
+ * krawędzią z etykietą.
+ */
+typedef struct Node_forward* Trie_forward;
+
+/**
+ * @brief Węzeł drzewa Trie_forward
+ *
+ * Struktura, która reprezentuje węzeł drzewa trie,
+ * które odpowiada za przekierowania typu forward.
+ */
+
+struct Node_forward
+{
+    struct TrieLabel label; ///< cyfry na krawędzi od ojca do węzła
+    char const *forwarding; ///< numer z puli, na który przekierowywana jest ścieżka w drzewie do tego węzła
+    char const *source; ///< numer z puli równy ścieżce w drzewie do tego węzła lub NULL, jeżeli nie ma przekierowania
+    struct TrieSons sons; ///< synowie węzła
+    unsigned int refs; ///< liczba wskaźników na węzeł (węzły niezmienione od migawki są współdzielone)
+};
+
+
+struct Node_reverse;
+
+/**
+ * @brief Węzeł drzewa AVL numerów przekierowywanych na węzeł Trie_reverse.
+ *
+ * Numery w drzewie są uporządkowane leksykograficznie, co pozwala dodawać,
+ * wyszukiwać i usuwać numery w czasie logarytmicznym i przeglądać je
+ * w kolejności rosnącej.
+ */
+
+struct ReverseEntry
+{
+    char const *number; ///< numer z puli
+    struct ReverseEntry *left; ///< poddrzewo numerów mniejszych od @p number
+    struct ReverseEntry *right; ///< poddrzewo numerów większych od @p number
+    int height; ///< wysokość poddrzewa o korzeniu w tym węźle
+    unsigned int refs; ///< liczba wskaźników na węzeł (węzły niezmienione od migawki są współdzielone)
+};
+
+/**
+ * Typ reprezentujący drzewo trie, które odpowiada za
+ * przekierowania typu reverse. Drzewo jest skompresowane tak jak
+ * Trie_forward, więc wierzchołki istnieją tylko w rozgałęzieniach
+ * i tam, gdzie drzewo reverse jest niepuste.
+ */
+typedef struct Node_reverse* Trie_reverse;
+
+/**
+ * @brief Węzeł drzewa Trie_reverse
+ *
+ * Struktura, która reprezentuje węzeł drzewa trie,
+ * które odpowiada za przekierowania typu reverse.
+ */
+
+struct Node_reverse
+{
+    struct TrieLabel label; ///< cyfry na krawędzi od ojca do węzła
+    struct ReverseEntry *reverse; ///< drzewo numerów, które są przekierowywane na ścieżkę w drzewie do tego węzła lub NULL, jeżeli nie ma takich numerów
+    unsigned int reverseSize; ///< liczba numerów w drzewie @p reverse
+    unsigned int refs; ///< liczba wskaźników na węzeł (węzły niezmienione od migawki są współdzielone)
+    struct TrieSons sons; ///< synowie węzła
+};
+
+
+/**
+ * Liczba wyników phfwdNonTrivialCount zapamiętywanych w strukturze
+ */
+#define countCacheSize 64
+
+/**
+ * @brief Zapamiętany wynik phfwdNonTrivialCount.
+ *
+ * Wynik jest aktualny, jeżeli @p generation jest równe numerowi wersji
+ * struktury, w której jest zapamiętany.
+ */
+
+struct CountCacheEntry
+{
+    unsigned long long generation; ///< numer wersji struktury, dla której policzono wynik, 0 dla pustego wpisu
+    size_t len; ///< długość numerów z zapytania
+    unsigned int mask; ///< maska bitowa cyfr ze zbioru z zapytania
+    size_t result; ///< wynik zapytania
+};
+
+/**
+ * Liczba miejsc tablicy indeksu, które wątek bierze naraz do policzenia
+ */
+#define countChunk 1024
+
+/**
+ * Minimalny rozmiar tablicy indeksu, od którego liczenie jest dzielone między
+ * wątki; w jednym wątku liczenie takiej tablicy trwa kilka razy dłużej niż
+ * obudzenie puli (zob. pomiar count programu phone_forward_bench)
+ */
+#define countParallelThreshold (4 * countChunk)
+
+/**
+ * @brief Stałe wątki liczące nietrywialne numery.
+ * Wątki czekają na zadanie na zmiennej warunkowej @p start. Zadanie zleca
+ * jeden wątek naraz (ten, który trzyma @p owner); wątki puli i zlecający
+ * biorą kolejne części tablicy indeksu ze wspólnego licznika zadania.
+ */
+struct CountPool
+{
+    pthread_mutex_t owner; ///< muteks wątku zlecającego zadanie
+    pthread_mutex_t lock; ///< muteks chroniący pozostałe pola
+    pthread_cond_t start; ///< zmienna warunkowa sygnalizowana przy zleceniu zadania i zakończeniu puli
+    pthread_cond_t done; ///< zmienna warunkowa sygnalizowana, gdy ostatni wątek puli skończy zadanie
+    struct CountTask *task; ///< bieżące zadanie lub NULL, jeśli nie można się do niego dołączyć
+    unsigned long long round; ///< numer ostatnio zleconego zadania
+    unsigned int running; ///< liczba wątków puli liczących bieżące zadanie
+    size_t result; ///< suma wyników wątków puli dla bieżącego zadania
+    bool stop; ///< czy wątki puli mają się zakończyć
+    unsigned int threads; ///< liczba utworzonych wątków puli
+    pthread_t workers[]; ///< identyfikatory wątków puli
+};
+
+/**
+ * Liczba części, na które dzielone są drzewa w trybie współbieżnym
+ * (po jednej na każdą cyfrę)
+ */
+#define numberOfShards 12
+
+/**
+ * @brief Blokady zmian przekierowań w trybie współbieżnym.
+ * Poddrzewa korzenia dla różnych cyfr są zmieniane niezależnie. Zmiana
+ * przekierowań zakłada blokadę części drzewa tfor wyznaczonej przez pierwszą
+ * cyfrę przekierowywanego prefiksu, a potem blokady części drzewa trev
+ * wyznaczonych przez pierwsze cyfry numerów, na które są przekierowania,
+ * w kolejności rosnących cyfr. Arena i pula mają własne muteksy.
+ */
+struct ShardLocks
+{
+    pthread_mutex_t forward[numberOfShards]; ///< blokady części drzewa tfor
+    pthread_mutex_t reverse[numberOfShards]; ///< blokady części drzewa trev
+    pthread_mutex_t arena; ///< muteks areny
+    pthread_mutex_t numbers; ///< muteks puli numerów
+    pthread_mutex_t shared; ///< muteks indeksu najpłytszych wierzchołków i numeru wersji
+};
+
+/**
+ * Wartość pola @p magic zamrożonej struktury ("PFWF")
+ */
+#define frozenMagic 0x46574650u
+
+/**
+ * Wersja układu zamrożonej struktury
+ */
+#define frozenVersion 2u
+
+/**
+ * Wartość pola @p byteOrder zamrożonej struktury; na komputerze o innej
+ * kolejności bajtów odczytuje się ją jako 0x04030201
+ */
+#define frozenByteOrder 0x01020304u
+
+/**
+ * @brief Grupa indeksu najpłytszych wierzchołków w zamrożonej strukturze.
+ *
+ * Odpowiada niepustemu wpisowi @ref CountIndexEntry, ale ma pola o stałych
+ * rozmiarach i jawne wyrównanie, więc jej układ nie zależy od kompilatora.
+ */
+
+struct FrozenCountEntry
+{
+    uint64_t depth; ///< głębokość wierzchołków grupy
+    uint32_t mask; ///< maska bitowa cyfr grupy
+    uint32_t pad; ///< wyrównanie, zawsze 0
+    uint64_t count; ///< liczba wierzchołków w grupie (większa od 0)
+};
+
+/**
+ * @brief Numer w zamrożonej strukturze.
+ */
+
+struct FrozenNumber
+{
+    uint32_t offset; ///< położenie numeru w tablicy numerów
+    uint32_t length; ///< długość numeru
+};
+
+/**
+ * @brief Wierzchołek zamrożonego drzewa trie.
+ *
+ * Wierzchołki drzewa leżą w tablicy w kolejności przechodzenia wszerz,
+ * więc synowie wierzchołka leżą obok siebie w kolejności rosnących cyfr.
+ * Syn dla cyfry d ma indeks @p sons zwiększony o liczbę zapalonych bitów
+ * @p sonMask mniejszych od bitu d.
+ */
+
+struct FrozenNode
+{
+    uint32_t label; ///< położenie cyfr etykiety krawędzi od ojca w tablicy etykiet
+    uint32_t labelLength; ///< długość etykiety
+    uint32_t sons; ///< indeks pierwszego syna w tablicy wierzchołków
+    uint32_t value; ///< w drzewie tfor położenie numeru, na który jest przekierowanie; w drzewie trev indeks pierwszego numeru w tablicy @p sources
+    uint32_t valueLength; ///< w drzewie tfor długość tego numeru (0, jeżeli nie ma przekierowania); w drzewie trev liczba numerów
+    uint16_t sonMask; ///< maska bitowa cyfr synów
+    uint16_t pad; ///< wyrównanie, zawsze 0
+};
+
+/**
+ * @brief Nagłówek zamrożonej struktury.
+ *
+ * Zamrożona struktura jest jednym blokiem pamięci, który zaczyna się od
+ * nagłówka. Tablice są w kolejności: grupy indeksu najpłytszych wierzchołków
+ * (struct FrozenCountEntry), wierzchołki drzewa tfor i drzewa trev
+ * (struct FrozenNode), numery przekierowywane na wierzchołki drzewa trev
+ * (struct FrozenNumber), etykiety i numery zakończone znakiem '\0'.
+ * Położenia tablic są liczone od początku bloku, więc blok można przenieść
+ * w inne miejsce pamięci. Ten sam blok jest formatem pliku zapisywanego
+ * przez @ref phfwdSave, więc plik można odpytywać bez wczytywania
+ * (zob. @ref phfwdOpen). Wszystkie struktury bloku mają pola o stałych
+ * rozmiarach bez niejawnego wyrównania, a liczby są zapisane w kolejności
+ * bajtów komputera, który zapisał plik; pole @p byteOrder pozwala odrzucić
+ * plik z komputera o innej kolejności bajtów.
+ */
+
+struct FrozenForward
+{
+    uint32_t magic; ///< wartość @ref frozenMagic
+    uint32_t version; ///< wartość @ref frozenVersion
+    uint32_t byteOrder; ///< wartość @ref frozenByteOrder
+    uint32_t pad; ///< wyrównanie, zawsze 0
+    uint64_t size; ///< rozmiar całego bloku w bajtach
+    uint64_t checksum; ///< suma kontrolna FNV-1a (liczona słowami 64-bitowymi) bloku z tym polem równym 0 (0 dla bloku, który nie był zapisany w pliku)
+    uint64_t countOffset; ///< położenie tablicy grup indeksu
+    uint64_t forwardOffset; ///< położenie tablicy wierzchołków drzewa tfor
+    uint64_t reverseOffset; ///< położenie tablicy wierzchołków drzewa trev
+    uint64_t sourcesOffset; ///< położenie tablicy numerów przekierowywanych
+    uint64_t labelsOffset; ///< położenie tablicy etykiet
+    uint64_t numbersOffset; ///< położenie tablicy numerów
+    uint32_t countSize; ///< liczba grup indeksu
+    uint32_t forwardSize; ///< liczba wierzchołków drzewa tfor
+    uint32_t reverseSize; ///< liczba wierzchołków drzewa trev
+    uint32_t sourcesSize; ///< liczba numerów przekierowywanych
+};
+
+/**
+ * Struktura przechowująca przekierowania numerów telefonów.
+ * Wszystkie węzły drzew i przechowywane w nich numery są alokowane
+ * w arenie struktury, więc usunięcie struktury zwalnia je naraz.
+ * Migawki współdzielą z nią arenę, pulę i niezmienione węzły drzew;
+ * zmiana przekierowań kopiuje tylko współdzielone węzły na zmienianych
+ * ścieżkach.
+ */
+
+struct PhoneForward
+{
+    Trie_forward tfor; ///< drzewo za pomocą którego analizuje się zapytania forward
+    Trie_reverse trev; ///< drzewo za pomocą którego analizuje się zapytania reverse
+    struct Arena arena; ///< arena, w której alokowane są węzły drzew i numery
+    struct NumberPool numbers; ///< pula numerów współdzielona przez oba drzewa
+    struct CountIndex shallowest; ///< indeks najpłytszych niepustych wierzchołków drzewa trev
+    unsigned int countThreads; ///< liczba wątków używanych przez phfwdNonTrivialCount
+    struct CountPool *countPool; ///< wątki liczące nietrywialne numery lub NULL (wtedy liczy jeden wątek)
+    unsigned long long generation; ///< numer wersji struktury, zwiększany przy każdej zmianie przekierowań
+    struct CountCacheEntry countCache[countCacheSize]; ///< zapamiętane wyniki phfwdNonTrivialCount
+    struct ReaderLock *lock; ///< blokada w trybie współbieżnym lub NULL
+    struct ShardLocks *shards; ///< blokady części drzew w trybie współbieżnym lub NULL
+    struct PhoneForward *origin; ///< struktura, której migawką jest ta struktura, lub NULL
+    unsigned int snapshots; ///< liczba istniejących migawek struktury
+    bool deleted; ///< czy struktura została usunięta, ale jej arena jest potrzebna migawkom
+    bool indexed; ///< czy indeks @p shallowest jest aktualny (migawki budują go przy pierwszym liczeniu)
+    struct FrozenForward const *frozen; ///< zamrożone przekierowania lub NULL (wtedy @p tfor i @p trev mają wartość NULL)
+    size_t mapped; ///< rozmiar odwzorowanego w pamięci pliku z blokiem @p frozen lub 0, jeżeli blok zaalokowano
+    struct Journal *journal; ///< dziennik zmian przekierowań lub NULL
+    char *journalBase; ///< ścieżka pliku, do którego skracany jest dziennik, lub NULL
+};
+
+#endif /* __PHONE_FORWARD_INTERNAL_H__ */
@@ -1,13 +1,32 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include "phone_forward.h"
-#include "phone_forward.h"
+#include "open_table.h"
 
 #define numberOfDigits 12
 #define zero '0'
 
+/**
+ * Rozmiar bloku, którym wczytywane jest wejście
+ */
+#define inputBlockSize (1 << 16)
+
+/**
+ * Rozmiar bufora wyjścia; po jego zapełnieniu wyjście jest wypisywane
+ */
+#define outputBlockSize (1 << 16)
+
 /** @brief Sprawdza, czy @p s wskazuje na poprawny numer.
  *
  * @param[in] s  – wskaźnik na ciąg znaków.
@@ -64,10 +83,211 @@ static bool is_id(char const *s)
 char c; ///< zmienna, która służy do wczytywania
 bool eof = false; ///< zmienna, która wskazuje, czy pojawił się już EOF
 
+static char inputBlock[inputBlockSize]; ///< blok, do którego wczytywane jest wejście
+static const char *inputPos = inputBlock; ///< wskaźnik na następny nieprzeczytany bajt bloku
+static const char *inputEnd = inputBlock; ///< wskaźnik za ostatni wczytany bajt bloku
+static int inputFd = STDIN_FILENO; ///< deskryptor, z którego wczytywane są bloki lub -1
+static char *inputMap = NULL; ///< zmapowany do pamięci plik wejściowy lub NULL
+static size_t inputMapSize = 0; ///< rozmiar zmapowanego pliku wejściowego
+
+/** @brief Ustawia plik @p path jako wejście programu.
+ * Jeżeli to możliwe, mapuje cały plik do pamięci i komendy są czytane
+ * bezpośrednio z mapowania. W przeciwnym wypadku (np. plik jest potokiem
+ * lub jest pusty) plik jest czytany blokami, tak jak standardowe wejście.
+ *
+ * @param[in] path – ścieżka do pliku z komendami.
+ * @return Wartość @p true, jeżeli udało się otworzyć plik.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool openInputFile(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map != MAP_FAILED)
+        {
+            posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+            close(fd);
+
+            inputMap = map;
+            inputMapSize = st.st_size;
+            inputPos = inputMap;
+            inputEnd = inputMap + inputMapSize;
+            inputFd = -1;
+
+            return true;
+        }
+    }
+
+    inputFd = fd;
+
+    return true;
+}
+
+/// Zamyka wejście otwarte przez @ref openInputFile
+static void closeInput()
+{
+    if (inputMap != NULL)
+        munmap(inputMap, inputMapSize);
+    else if (inputFd != STDIN_FILENO)
+        close(inputFd);
+}
+
+static char outputBlock[outputBlockSize]; ///< bufor, w którym gromadzone jest wyjście
+static size_t outputSize = 0; ///< liczba bajtów zgromadzonych w buforze wyjścia
+
+/** @brief Wypisuje na standardowe wyjście dane wskazywane przez @p iov.
+ * Ponawia writev(2) aż do wypisania wszystkich danych lub wystąpienia błędu.
+ *
+ * @param[in,out] iov – tablica opisów fragmentów do wypisania (jest modyfikowana);
+ * @param[in] count – liczba elementów tablicy @p iov.
+ */
+static void writeAll(struct iovec *iov, int count)
+{
+    while (count > 0)
+    {
+        ssize_t n = writev(STDOUT_FILENO, iov, count);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            return;
+        }
+
+        while (count > 0 && (size_t)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            count--;
+        }
+
+        if (count > 0)
+        {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+/// Wypisuje zawartość bufora wyjścia i go opróżnia
+static void flushOutput()
+{
+    struct iovec iov = {outputBlock, outputSize};
+
+    if (outputSize > 0)
+        writeAll(&iov, 1);
+
+    outputSize = 0;
+}
+
+/** @brief Wypisuje numer złożony z dwóch części, zakończony znakiem nowej linii.
+ * Krótkie numery są kopiowane do bufora wyjścia. Numer, który się w nim
+ * nie mieści, jest wypisywany razem z zawartością bufora jednym
+ * wywołaniem writev(2), bez kopiowania.
+ *
+ * @param[in] prefix – wskaźnik na początek numeru;
+ * @param[in] prefixLen – długość początku numeru;
+ * @param[in] suffix – wskaźnik na koniec numeru;
+ * @param[in] suffixLen – długość końca numeru.
+ */
+static void writeNumberParts(const char *prefix, size_t prefixLen, const char *suffix, size_t suffixLen)
+{
+    if (outputSize + prefixLen + suffixLen + 1 <= outputBlockSize)
+    {
+        memcpy(outputBlock + outputSize, prefix, prefixLen);
+        outputSize += prefixLen;
+        memcpy(outputBlock + outputSize, suffix, suffixLen);
+        outputSize += suffixLen;
+        outputBlock[outputSize++] = '\n';
+        return;
+    }
+
+    struct iovec iov[4] = {{outputBlock, outputSize}, {(char *)prefix, prefixLen},
+                           {(char *)suffix, suffixLen}, {"\n", 1}};
+
+    writeAll(iov, 4);
+    outputSize = 0;
+}
+
+/** @brief Wypisuje numer @p num zakończony znakiem nowej linii.
+ *
+ * @param[in] num – wskaźnik na numer;
+ * @param[in] len – długość numeru.
+ */
+static void writeNumber(const char *num, size_t len)
+{
+    writeNumberParts(num, len, "", 0);
+}
+
+/** @brief Wypisuje komunikat o błędzie na standardowe wyjście diagnostyczne.
+ * Przed wypisaniem komunikatu opróżnia bufor wyjścia, żeby zachować
+ * kolejność wyników i komunikatów.
+ *
+ * @param[in] format – format komunikatu, jak w printf.
+ */
+static void reportError(const char *format, ...)
+{
+    va_list args;
+
+    flushOutput();
+
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+}
+
+/** @brief Wczytuje kolejny blok wejścia.
+ * Wczytuje do @p inputBlock kolejny blok wejścia za pomocą jednego
+ * wywołania read(2). Zmapowany plik jest w całości jednym blokiem.
+ *
+ * @return Wartość @p true, jeżeli wczytano co najmniej jeden bajt.
+ *         Wartość @p false, jeżeli wejście się skończyło lub wystąpił błąd.
+ */
+static bool refillInput()
+{
+    ssize_t n;
+
+    if (inputFd < 0)
+        return false;
+
+    // Przed czekaniem na dalsze wejście wypisuje to, co już obliczono
+    flushOutput();
+
+    do
+    {
+        n = read(inputFd, inputBlock, inputBlockSize);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0)
+        return false;
+
+    inputPos = inputBlock;
+    inputEnd = inputBlock + n;
+
+    return true;
+}
+
 /// Czyta bajt z wejścia do zmiennej @c, jeżeli na wejściu jest eof to zmienia stan @eof
-void readChar()
+static inline void readChar()
 {
-    eof = (scanf("%c", &c) == EOF);
+    if (inputPos == inputEnd && !refillInput())
+    {
+        eof = true;
+        return;
+    }
+
+    eof = false;
+    c = *inputPos++;
 }
 
 
@@ -79,7 +299,7 @@ void printPhoneNumbers(struct PhoneNumbers *pnum)
 {
     for(int i = 0; i < pnum->size; i++)
     {
-        printf("%s\n", pnum->tab[i]);
+        writeNumber(pnum->tab[i], strlen(pnum->tab[i]));
     }
 }
 
@@ -108,35 +328,45 @@ static char const *copy_string(char const *s)
 struct ForwardingBase
 {
     const char *name; ///< nazwa bazy
+    unsigned int hash; ///< wartość funkcji haszującej nazwy
     struct PhoneForward *phoneFor; ///< struktura przechowująca przekierowania
 };
 
 /** @brief Tworzy nową strukturę.
- * Tworzy nową strukturę niezawierającą żadnych przekierowań o nazwie @p name.
+ * Tworzy nową bazę o nazwie @p name z przekierowaniami @p pf.
  *
+ * @param[in] name – wskaźnik na nazwę bazy;
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania, którą
+ *                 baza przejmuje.
  * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się
- *         zaalokować pamięci.
+ *         zaalokować pamięci (wtedy @p pf nie jest przejmowana).
  */
-struct ForwardingBase *forBaseNew(const char *name)
+struct ForwardingBase *forBaseNew(const char *name, struct PhoneForward *pf)
 {
     struct ForwardingBase *b = (struct ForwardingBase*)malloc(sizeof(struct ForwardingBase));
 
     if (b != NULL)
     {
         b->name = copy_string((char const*)name);
-        b->phoneFor = phfwdNew();
+        b->phoneFor = pf;
     }
 
     return b;
 }
 
+/**
+ * Początkowy rozmiar tablicy haszującej baz
+ */
+#define basesInitialCapacity 16
+
 /**
  * Struktura przechowująca bazy przekierowań.
  */
 struct Bases
 {
-    int size; ///< rozmiar struktury (ile jest aktualnie baz w strukturze)
-    struct ForwardingBase *bases[101]; ///< tablica, w której przechowuje wskaźniki na strukturę
+    size_t size; ///< rozmiar struktury (ile jest aktualnie baz w strukturze)
+    size_t capacity; ///< rozmiar tablicy (potęga dwójki)
+    struct ForwardingBase **bases; ///< tablica haszująca z adresowaniem otwartym, zapełniona co najwyżej w połowie
 };
 
 /** @brief Tworzy nową strukturę.
@@ -150,11 +380,92 @@ struct Bases *basesNew()
     struct Bases *b = (struct Bases*)malloc(sizeof(struct Bases));
 
     if (b != NULL)
+    {
         b->size = 0;
+        b->capacity = basesInitialCapacity;
+        b->bases = calloc(basesInitialCapacity, sizeof(struct ForwardingBase *));
+
+        if (b->bases == NULL)
+        {
+            free(b);
+            b = NULL;
+        }
+    }
 
     return b;
 }
 
+/** @brief Sprawdza, czy miejsce tablicy baz jest puste.
+ *
+ * @param[in] entry – wskaźnik na miejsce tablicy.
+ * @return Wartość @p true, jeśli miejsce jest puste.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool basesEmpty(void const *entry)
+{
+    return *(struct ForwardingBase *const *)entry == NULL;
+}
+
+/** @brief Zwraca zapamiętaną wartość funkcji haszującej nazwy bazy.
+ *
+ * @param[in] entry – wskaźnik na niepuste miejsce tablicy.
+ * @return Wartość funkcji haszującej.
+ */
+static size_t basesEntryHash(void const *entry)
+{
+    return (*(struct ForwardingBase *const *)entry)->hash;
+}
+
+/** @brief Sprawdza, czy miejsce tablicy zawiera bazę o szukanej nazwie.
+ *
+ * @param[in] entry – wskaźnik na niepuste miejsce tablicy;
+ * @param[in] name – wskaźnik na nazwę.
+ * @return Wartość @p true, jeśli miejsce zawiera bazę.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool basesMatches(void const *entry, void const *name)
+{
+    return strcmp((*(struct ForwardingBase *const *)entry)->name, name) == 0;
+}
+
+/**
+ * Opis elementów tablicy haszującej baz
+ */
+static const struct OpenTableType basesType = {sizeof(struct ForwardingBase *), basesEmpty, basesEntryHash};
+
+/** @brief Szuka w tablicy miejsca bazy o nazwie @p name.
+ *
+ * @param[in] b   – wskaźnik na strukturę przechowującą bazy przekierowań;
+ * @param[in] name – wskaźnik na nazwę;
+ * @param[in] hash – wartość funkcji haszującej nazwy.
+ * @return Indeks miejsca z bazą o tej nazwie lub pierwszego wolnego miejsca.
+ */
+static size_t basesSlot(const struct Bases *b, const char *name, unsigned int hash)
+{
+    return openTableFind(b->bases, b->capacity, &basesType, hash, basesMatches, name);
+}
+
+/** @brief Powiększa tablicę haszującą baz dwukrotnie.
+ *
+ * @param[in,out] b – wskaźnik na strukturę przechowującą bazy przekierowań.
+ * @return Wartość @p true, jeśli powiększono tablicę.
+ *         Wartość @p false, jeśli nie udało się zaalokować pamięci.
+ */
+static bool basesGrow(struct Bases *b)
+{
+    size_t capacity = 2 * b->capacity;
+    struct ForwardingBase **bases = openTableResize(b->bases, b->capacity, &basesType, capacity);
+
+    if (bases == NULL)
+        return false;
+
+    free(b->bases);
+    b->bases = bases;
+    b->capacity = capacity;
+
+    return true;
+}
+
 long long bytesCounter = 0; ///< licznik wczytanych bajtów
 long long previousBytesCounterState = 1; ///< pomocnicza zmienna do liczenia, który to bajt
 char buffer[100003]; ///< bufor, do którego wczytuję wejście
@@ -162,6 +473,36 @@ int idx = 0; ///< indeks bufora
 struct ForwardingBase *actualBase = NULL; ///< wskaźnik na aktualną bazę
 struct Bases *bas; ///< wskaźnik na stukturę przechowującą bazy przekierowań
 
+/** @brief Dodaje bazę z istniejącymi przekierowaniami.
+ * Dodaje do struktury, na którą wskazuje @p b, bazę o nazwie @p name, która
+ * przejmuje strukturę @p pf.
+ *
+ * @param[in] b   – wskaźnik na strukturę przechowującą bazy przekierowań;
+ * @param[in] name – wskaźnik na napis reprezentujący nazmę bazy;
+ * @param[in] pf – wskaźnik na strukturę przechowującą przekierowania.
+ *
+ * @return Wskaźnik na utworzoną bazę przekierowań lub NULL,
+ *         jeżeli nie udało się zaalokować pamięci (wtedy @p pf nie jest
+ *         przejmowana)
+ */
+struct ForwardingBase* addBaseWith(struct Bases *b, const char *name, struct PhoneForward *pf)
+{
+    // Tablica jest zapełniona co najwyżej w połowie, więc ciągi zajętych miejsc są krótkie
+    if (2 * (b->size + 1) > b->capacity && !basesGrow(b))
+        return NULL;
+
+    struct ForwardingBase *base = forBaseNew(name, pf);
+
+    if (base == NULL)
+        return NULL;
+
+    base->hash = openTableHash(name, NULL);
+    b->bases[basesSlot(b, name, base->hash)] = base;
+    b->size++;
+
+    return base;
+}
+
 /** @brief Dodaje nową bazę przekierowań.
  * Dodaje nową bazę przekierowań do struktury, na którą wskazuje @p b.
  *
@@ -173,10 +514,17 @@ struct Bases *bas; ///< wskaźnik na stukturę przechowującą bazy przekierowa
  */
 struct ForwardingBase* addBase(struct Bases *b, const char *name)
 {
-    b->bases[b->size] = forBaseNew(name);
-    b->size++;
+    struct PhoneForward *pf = phfwdNew();
+
+    if (pf == NULL)
+        return NULL;
+
+    struct ForwardingBase *base = addBaseWith(b, name, pf);
 
-    return b->bases[b->size - 1];
+    if (base == NULL)
+        phfwdDelete(pf);
+
+    return base;
 }
 
 /** @brief Dealokuje bazę przekierowań.
@@ -202,21 +550,19 @@ void baseDel(struct ForwardingBase *b)
  */
 bool removeBase(struct Bases *b, const char *name)
 {
-    for(int i = 0; i < b->size; i++)
-    {
-        if (strcmp(b->bases[i]->name, name) == 0)
-        {
-            if (b->bases[i] == actualBase)
-                actualBase = NULL;
+    size_t i = basesSlot(b, name, openTableHash(name, NULL));
 
-            baseDel(b->bases[i]);
-            b->bases[i] = b->bases[b->size - 1];
-            b->size--;
-            return true;
-        }
-    }
+    if (b->bases[i] == NULL)
+        return false;
 
-    return false;
+    if (b->bases[i] == actualBase)
+        actualBase = NULL;
+
+    baseDel(b->bases[i]);
+    openTableErase(b->bases, b->capacity, &basesType, i);
+    b->size--;
+
+    return true;
 }
 
 /** @brief Usuwa strukturą przechowującą bazy przekierowań.
@@ -226,10 +572,12 @@ bool removeBase(struct Bases *b, const char *name)
  */
 void delBases(struct Bases *b)
 {
-    for(int i = 0; i < b->size; i++)
+    for(size_t i = 0; i < b->capacity; i++)
     {
-        baseDel(b->bases[i]);
+        if (b->bases[i] != NULL)
+            baseDel(b->bases[i]);
     }
+    free(b->bases);
     free(b);
 }
 
@@ -245,13 +593,52 @@ void delBases(struct Bases *b)
  */
 struct ForwardingBase* getForwardingBase(struct Bases *b, const char *name)
 {
-    for(int i = 0; i < b->size; i++)
+    return b->bases[basesSlot(b, name, openTableHash(name, NULL))];
+}
+
+/** @brief Dołącza bazę przekierowań z pliku.
+ * Otwiera plik zapisany przez @ref phfwdSave jako bazę tylko do odczytu
+ * (zob. @ref phfwdOpen) i dodaje ją pod nazwą do struktury wskazywanej
+ * przez @p b. Dodawanie przekierowań do takiej bazy kończy się błędem.
+ * Bez @p verify sprawdzany jest tylko nagłówek pliku, więc dołączenie
+ * zajmuje czas stały niezależnie od rozmiaru pliku, ale uszkodzone drzewa
+ * w pliku mogą prowadzić do odczytu poza nim; można tak dołączać tylko
+ * zaufane pliki.
+ *
+ * @param[in] b   – wskaźnik na strukturę przechowującą bazy przekierowań;
+ * @param[in] spec – wskaźnik na napis postaci nazwa=plik;
+ * @param[in] verify – czy sprawdzić sumę kontrolną i całą zawartość pliku.
+ *
+ * @return Wartość @p true, jeśli dołączono bazę.
+ *         Wartość @p false, jeśli napis lub plik są niepoprawne, baza o tej
+ *         nazwie już istnieje albo nie udało się zaalokować pamięci.
+ */
+static bool attachBase(struct Bases *b, char *spec, bool verify)
+{
+    char *path = strchr(spec, '=');
+
+    if (path == NULL)
+        return false;
+
+    *path = '\0';
+    path++;
+
+    if (!is_id(spec) || strcmp("NEW", spec) == 0 || strcmp("DEL", spec) == 0
+        || getForwardingBase(b, spec) != NULL)
+        return false;
+
+    struct PhoneForward *pf = phfwdOpen(path, verify);
+
+    if (pf == NULL)
+        return false;
+
+    if (addBaseWith(b, spec, pf) == NULL)
     {
-        if (strcmp(b->bases[i]->name, name) == 0)
-            return b->bases[i];
+        phfwdDelete(pf);
+        return false;
     }
 
-    return NULL;
+    return true;
 }
 
 /** @brief Dodaje przekierowanie do aktualnej bazy.
@@ -279,13 +666,12 @@ bool addForward(char const *num1, char const *num2)
  */
 bool printForwardFromNum(char const *num)
 {
-    const struct PhoneNumbers* phnum  = phfwdGet(actualBase->phoneFor, num);
+    struct PhoneForwardView view;
 
-    if (phnum->size == 0)
+    if (!phfwdGetView(actualBase->phoneFor, num, &view))
         return false;
 
-    printPhoneNumbers((struct PhoneNumbers*)phnum);
-    phnumDelete(phnum);
+    writeNumberParts(view.prefix, view.prefixLength, view.suffix, strlen(view.suffix));
 
     return true;
 }
@@ -338,7 +724,17 @@ void printNumberOfNonTrivials(char const *set)
     if (strlen(set) > 12)
         len = (strlen(set) - 12);
 
-    printf("%lu\n", phfwdNonTrivialCount(actualBase->phoneFor, set, len));
+    size_t count = phfwdNonTrivialCount(actualBase->phoneFor, set, len);
+    char digits[24];
+    int i = sizeof(digits);
+
+    do
+    {
+        digits[--i] = zero + count % 10;
+        count /= 10;
+    } while (count > 0);
+
+    writeNumber(digits + i, sizeof(digits) - i);
 }
 
 
@@ -407,24 +803,22 @@ bool processParticularCommand(int keyword)
     {
         case 0:
             {
-                fprintf(stderr, "ERROR %lld\n", previousBytesCounterState);
+                reportError("ERROR %lld\n", previousBytesCounterState);
                 return false;
             }
         case 1: //? *
             {
-                const char *name = copy_string(buffer + 1);
+                const char *name = buffer + 1;
 
                 if (actualBase == NULL)
                 {
-                    fprintf(stderr, "ERROR ? %lld\n", previousBytesCounterState);
-                    free((char*)name);
+                    reportError("ERROR ? %lld\n", previousBytesCounterState);
                     return false;
                 }
 
                 if (!is_number(name))
                 {
-                    fprintf(stderr, "ERROR %lld\n", previousBytesCounterState);
-                    free((char*)name);
+                    reportError("ERROR %lld\n", previousBytesCounterState);
                     return false;
                 }
 
@@ -433,34 +827,29 @@ bool processParticularCommand(int keyword)
                     bool aux = printForwardToNum(name);
 
                     if (!aux)
-                        fprintf(stderr, "ERROR ? %lld\n", previousBytesCounterState);
+                        reportError("ERROR ? %lld\n", previousBytesCounterState);
                 }
                 else
                 {
-                    fprintf(stderr, "ERROR ? %lld\n", previousBytesCounterState);
-                    free((char*)name);
+                    reportError("ERROR ? %lld\n", previousBytesCounterState);
                     return false;
                 }
 
-                free((char*)name);
-
                 return true;
             }
         case 2: //@ *
             {
-                const char *name = copy_string(buffer + 1);
+                const char *name = buffer + 1;
 
                 if (actualBase == NULL)
                 {
-                    fprintf(stderr, "ERROR @ %lld\n", previousBytesCounterState);
-                    free((char*)name);
+                    reportError("ERROR @ %lld\n", previousBytesCounterState);
                     return false;
                 }
 
                 if (!is_number(name))
                 {
-                    fprintf(stderr, "ERROR %lld\n", previousBytesCounterState);
-                    free((char*)name);
+                    reportError("ERROR %lld\n", previousBytesCounterState);
                     return false;
                 }
 
@@ -468,23 +857,19 @@ bool processParticularCommand(int keyword)
                     printNumberOfNonTrivials(name);
                 else
                 {
-                    fprintf(stderr, "ERROR @ %lld\n", previousBytesCounterState);
-                    free((char*)name);
+                    reportError("ERROR @ %lld\n", previousBytesCounterState);
                     return false;
                 }
 
-                free((char*)name);
-
                 return true;
             }
         case 3: // NEW
             {
-                const char *name = copy_string(buffer + 3);
+                const char *name = buffer + 3;
 
                 if (!is_id(name) || strcmp("NEW", name) == 0 || strcmp("DEL", name) == 0)
                 {
-                    fprintf(stderr, "ERROR %lld\n", previousBytesCounterState + 4);
-                    free((char*)name);
+                    reportError("ERROR %lld\n", previousBytesCounterState + 4);
                     return false;
                 }
 
@@ -493,20 +878,17 @@ bool processParticularCommand(int keyword)
                 if (actualBase == NULL)
                     actualBase = addBase(bas, name);
 
-                free((char*)name);
-
                 return true;
             }
         case 4: // DEL
             {
-                const char *name = copy_string(buffer + 3);
+                const char *name = buffer + 3;
 
                 if (is_id(name) && strcmp("DEL", name) != 0 && strcmp("NEW", name) != 0)
                 {
                     if (!removeBase(bas, name))
                     {
-                        fprintf(stderr, "ERROR DEL %lld\n", previousBytesCounterState);
-                        free((char*)name);
+                        reportError("ERROR DEL %lld\n", previousBytesCounterState);
                         return false;
                     }
                 }
@@ -516,37 +898,31 @@ bool processParticularCommand(int keyword)
                         removeForwards(name);
                     else
                     {
-                        fprintf(stderr, "ERROR DEL %lld\n", previousBytesCounterState);
-                        free((char*)name);
+                        reportError("ERROR DEL %lld\n", previousBytesCounterState);
                         return false;
                     }
                 }
                 else
                 {
-                    fprintf(stderr, "ERROR %lld\n", previousBytesCounterState + 4);
-                    free((char*)name);
+                    reportError("ERROR %lld\n", previousBytesCounterState + 4);
                     return false;
                 }
 
-                free((char*)name);
-
                 return true;
             }
         case 5: // * ?
             {
-                const char *name = copy_string(buffer);
+                const char *name = buffer;
 
                 if (actualBase == NULL)
                 {
-                    fprintf(stderr, "ERROR ? %lld\n", previousBytesCounterState + idx);
-                    free((char*)name);
+                    reportError("ERROR ? %lld\n", previousBytesCounterState + idx);
                     return false;
                 }
 
                 if (!is_number(name))
                 {
-                    fprintf(stderr, "ERROR %lld\n", previousBytesCounterState + idx);
-                    free((char*)name);
+                    reportError("ERROR %lld\n", previousBytesCounterState + idx);
                     return false;
                 }
 
@@ -555,17 +931,14 @@ bool processParticularCommand(int keyword)
                     bool aux = printForwardFromNum(name);
 
                     if (!aux)
-                        fprintf(stderr, "ERROR ? %lld\n", previousBytesCounterState + idx);
+                        reportError("ERROR ? %lld\n", previousBytesCounterState + idx);
                 }
                 else
                 {
-                    fprintf(stderr, "ERROR ? %lld\n", previousBytesCounterState + idx);
-                    free((char*)name);
+                    reportError("ERROR ? %lld\n", previousBytesCounterState + idx);
                     return false;
                 }
 
-                free((char*)name);
-
                 return true;
             }
         case 6: // * > *
@@ -582,26 +955,22 @@ bool processParticularCommand(int keyword)
                     }
                 }
 
-                const char *num1 = copy_string(buffer);
-                const char *num2 = copy_string(buffer + division + 1);
+                const char *num1 = buffer;
+                const char *num2 = buffer + division + 1;
 
                 if (actualBase == NULL)
                 {
-                    fprintf(stderr, "ERROR > %lld\n", previousBytesCounterState + division + 1);
-                    free((char*)num1);
-                    free((char*)num2);
+                    reportError("ERROR > %lld\n", previousBytesCounterState + division + 1);
                     return false;
                 }
 
                 if (!is_number(num1) || !is_number(num2))
                 {
                     if (!is_number(num1))
-                        fprintf(stderr, "ERROR %lld\n", previousBytesCounterState);
+                        reportError("ERROR %lld\n", previousBytesCounterState);
                     else
-                        fprintf(stderr, "ERROR %lld\n", previousBytesCounterState + idx - strlen(num2));
+                        reportError("ERROR %lld\n", previousBytesCounterState + idx - strlen(num2));
 
-                    free((char*)num1);
-                    free((char*)num2);
                     return false;
                 }
 
@@ -609,23 +978,16 @@ bool processParticularCommand(int keyword)
                 {
                     if (!addForward(num1, num2))
                     {
-                        fprintf(stderr, "ERROR > %lld\n", previousBytesCounterState + division);
-                        free((char*)num1);
-                        free((char*)num2);
+                        reportError("ERROR > %lld\n", previousBytesCounterState + division);
                         return false;
                     }
                 }
                 else
                 {
-                    fprintf(stderr, "ERROR > %lld\n", previousBytesCounterState + division);
-                    free((char*)num1);
-                    free((char*)num2);
+                    reportError("ERROR > %lld\n", previousBytesCounterState + division);
                     return false;
                 }
 
-                free((char*)num1);
-                free((char*)num2);
-
                 return true;
 
             }
@@ -702,9 +1064,9 @@ bool processCommand()
                 if (eof)
                 {
                     if (idx > 0)
-                        fprintf(stderr, "ERROR %lld\n", commentCounter);
+                        reportError("ERROR %lld\n", commentCounter);
                     else
-                        fprintf(stderr, "ERROR EOF\n");
+                        reportError("ERROR EOF\n");
 
                     return false;
                 }
@@ -712,7 +1074,7 @@ bool processCommand()
             }
             else
             {
-                fprintf(stderr, "ERROR %lld\n", bytesCounter - 1);
+                reportError("ERROR %lld\n", bytesCounter - 1);
                 return false;
             }
 
@@ -746,17 +1108,42 @@ bool processCommand()
 
 int prevKeyword = 0, newKeyword = 0;
 
-int main()
+int main(int argc, char *argv[])
 {
     // Tworzy nową strukturą baz przekierowań
     bas = basesNew();
 
+    // Opcje -b nazwa=plik dołączają bazy zapisane przez phfwdSave po sprawdzeniu
+    // całego pliku, a opcje -B nazwa=plik sprawdzają tylko nagłówek zaufanego
+    // pliku, więc dołączają go w czasie stałym
+    int arg = 1;
+
+    for(; arg + 1 < argc && (strcmp(argv[arg], "-b") == 0 || strcmp(argv[arg], "-B") == 0); arg += 2)
+    {
+        if (!attachBase(bas, argv[arg + 1], argv[arg][1] == 'b'))
+        {
+            fprintf(stderr, "%s: cannot attach base\n", argv[arg + 1]);
+            delBases(bas);
+            return 1;
+        }
+    }
+
+    // Jeżeli podano plik, to komendy są czytane z niego zamiast ze standardowego wejścia
+    if (arg < argc && !openInputFile(argv[arg]))
+    {
+        perror(argv[arg]);
+        delBases(bas);
+        return 1;
+    }
+
     while(!eof)
     {
         // jeżeli niepoprawna komenda to kończy program
         if (!processCommand())
         {
             delBases(bas);
+            closeInput();
+            flushOutput();
             return 1;
         }
 
@@ -766,5 +1153,7 @@ int main()
 
     //usuwa strukture przechowującą bazy przekierowań
     delBases(bas);
+    closeInput();
+    flushOutput();
     return 0;
 }
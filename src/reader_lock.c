@@ -0,0 +1,196 @@
+/** @file
+ * Implementacja modułu reader_lock.h
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include "reader_lock.h"
+
+/**
+ * Numer następnego licznika przydzielanego wątkowi
+ */
+static atomic_uint nextSlot;
+
+/**
+ * Numer licznika czytelników bieżącego wątku powiększony o 1 lub 0, jeżeli
+ * wątek nie dostał jeszcze licznika
+ */
+static _Thread_local unsigned int threadSlot;
+
+/** @brief Zwraca numer licznika czytelników bieżącego wątku.
+ * Wątki dostają liczniki po kolei, więc do @ref readerSlots wątków każdy
+ * ma własny licznik.
+ * @return Numer licznika.
+ */
+static unsigned int readerSlot(void)
+{
+    if (threadSlot == 0)
+        threadSlot = atomic_fetch_add(&nextSlot, 1) % readerSlots + 1;
+
+    return threadSlot - 1;
+}
+
+struct ReaderLock *readerLockNew(void)
+{
+    struct ReaderLock *lock = aligned_alloc(cacheLine, sizeof(struct ReaderLock));
+
+    if (lock == NULL)
+        return NULL;
+
+    for(int i = 0; i < readerSlots; i++)
+        atomic_init(&lock->slots[i].readers, 0);
+
+    atomic_init(&lock->writing, false);
+    lock->writers = 0;
+    lock->waiting = 0;
+    lock->phase = 0;
+    lock->draining = false;
+
+    bool ok = pthread_mutex_init(&lock->mutex, NULL) == 0;
+
+    ok = ok && pthread_cond_init(&lock->readable, NULL) == 0;
+    ok = ok && pthread_cond_init(&lock->writable, NULL) == 0;
+    ok = ok && pthread_cond_init(&lock->drained, NULL) == 0;
+
+    if (!ok)
+    {
+        free(lock);
+        return NULL;
+    }
+
+    return lock;
+}
+
+void readerLockDelete(struct ReaderLock *lock)
+{
+    if (lock != NULL)
+    {
+        pthread_cond_destroy(&lock->drained);
+        pthread_cond_destroy(&lock->writable);
+        pthread_cond_destroy(&lock->readable);
+        pthread_mutex_destroy(&lock->mutex);
+        free(lock);
+    }
+}
+
+/** @brief Sprawdza, czy żaden czytelnik nie trzyma blokady.
+ * @param[in] lock – wskaźnik na blokadę.
+ * @return Wartość @p true, jeśli wszystkie liczniki czytelników są zerowe.
+ *         Wartość @p false w przeciwnym wypadku.
+ */
+static bool readersGone(struct ReaderLock *lock)
+{
+    for(int i = 0; i < readerSlots; i++)
+    {
+        if (atomic_load(&lock->slots[i].readers) != 0)
+            return false;
+    }
+
+    return true;
+}
+
+/** @brief Budzi pisarza czekającego na czytelników.
+ * Wywoływana po zmniejszeniu licznika czytelnika, więc pisarz, który
+ * sprawdził liczniki przed zmniejszeniem, już śpi na @p drained.
+ * @param[in,out] lock – wskaźnik na blokadę.
+ */
+static void readerLeft(struct ReaderLock *lock)
+{
+    pthread_mutex_lock(&lock->mutex);
+
+    if (lock->draining)
+        pthread_cond_broadcast(&lock->drained);
+
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+void readLock(struct ReaderLock *lock)
+{
+    struct ReaderSlot *slot = &lock->slots[readerSlot()];
+
+    // Pisarz ustawia writing przed sprawdzeniem liczników, a czytelnik
+    // zwiększa licznik przed sprawdzeniem writing, więc któryś z nich
+    // zobaczy drugiego
+    atomic_fetch_add(&slot->readers, 1);
+
+    if (!atomic_load(&lock->writing))
+        return;
+
+    atomic_fetch_sub(&slot->readers, 1);
+
+    pthread_mutex_lock(&lock->mutex);
+
+    if (lock->draining)
+        pthread_cond_broadcast(&lock->drained);
+
+    // Pisarze zmieniają writing tylko pod muteksem, a nowi pisarze nie
+    // zaczynają fazy, dopóki czekający czytelnicy się nie zgłoszą
+    if (atomic_load(&lock->writing))
+    {
+        unsigned long long phase = lock->phase;
+
+        lock->waiting++;
+
+        while (lock->phase == phase)
+            pthread_cond_wait(&lock->readable, &lock->mutex);
+
+        if (--lock->waiting == 0)
+            pthread_cond_broadcast(&lock->writable);
+    }
+
+    atomic_fetch_add(&slot->readers, 1);
+
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+void readUnlock(struct ReaderLock *lock)
+{
+    atomic_fetch_sub(&lock->slots[readerSlot()].readers, 1);
+
+    if (atomic_load(&lock->writing))
+        readerLeft(lock);
+}
+
+void writeLock(struct ReaderLock *lock)
+{
+    pthread_mutex_lock(&lock->mutex);
+
+    // Czytelnicy czekający na koniec fazy wchodzą przed następną fazą,
+    // a do fazy, w której pierwszy pisarz czeka na czytelników, nie można
+    // dołączyć przed jego wejściem
+    while (lock->waiting > 0 || lock->draining)
+        pthread_cond_wait(&lock->writable, &lock->mutex);
+
+    if (lock->writers == 0)
+    {
+        lock->draining = true;
+        atomic_store(&lock->writing, true);
+
+        while (!readersGone(lock))
+            pthread_cond_wait(&lock->drained, &lock->mutex);
+
+        lock->draining = false;
+        pthread_cond_broadcast(&lock->writable);
+    }
+
+    lock->writers++;
+
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+void writeUnlock(struct ReaderLock *lock)
+{
+    pthread_mutex_lock(&lock->mutex);
+
+    if (--lock->writers == 0)
+    {
+        atomic_store(&lock->writing, false);
+        lock->phase++;
+        pthread_cond_broadcast(&lock->readable);
+    }
+
+    pthread_mutex_unlock(&lock->mutex);
+}
@@ -0,0 +1,100 @@
+/** @file
+ * Interfejs blokady czytelników i pisarzy z rozproszonym licznikiem czytelników
+ *
+ * Czytelnicy zgłaszają się w jednym z wielu liczników, z których każdy
+ * zajmuje osobną linię pamięci podręcznej, więc równolegli czytelnicy nie
+ * modyfikują wspólnego słowa. Pisarze mogą pracować jednocześnie (sami
+ * muszą się ze sobą synchronizować), ale nigdy razem z czytelnikami:
+ * pierwszy pisarz czeka, aż wszystkie liczniki czytelników się wyzerują.
+ * Blokady czytelnika nie można zakładać wielokrotnie w jednym wątku.
+ *
+ * Nikt nie czeka aktywnie: czytelnicy i pisarze, którzy muszą czekać, śpią
+ * na zmiennych warunkowych. Blokada działa fazami: czytelnicy, którzy
+ * zastali pisarzy, wchodzą zaraz po zakończeniu fazy pisarzy, zanim zacznie
+ * się następna, a nowi pisarze nie dołączają do fazy, na której koniec
+ * czekają czytelnicy. Dzięki temu ani pisarze nie zagłodzą czytelników,
+ * ani czytelnicy pisarzy.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#ifndef __READER_LOCK_H__
+#define __READER_LOCK_H__
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+/**
+ * Liczba liczników czytelników
+ */
+#define readerSlots 64
+
+/**
+ * Rozmiar linii pamięci podręcznej
+ */
+#define cacheLine 64
+
+/**
+ * @brief Licznik czytelników zajmujący osobną linię pamięci podręcznej.
+ */
+struct ReaderSlot
+{
+    _Alignas(cacheLine) atomic_uint readers; ///< liczba czytelników zgłoszonych w tym liczniku
+};
+
+/**
+ * Struktura przechowująca blokadę.
+ */
+struct ReaderLock
+{
+    struct ReaderSlot slots[readerSlots]; ///< liczniki czytelników
+    _Alignas(cacheLine) atomic_bool writing; ///< czy pisarz czeka na czytelników lub zmienia dane
+    pthread_mutex_t mutex; ///< muteks chroniący pozostałe pola
+    pthread_cond_t readable; ///< zmienna warunkowa sygnalizowana na końcu fazy pisarzy
+    pthread_cond_t writable; ///< zmienna warunkowa, na której czekają pisarze spoza fazy
+    pthread_cond_t drained; ///< zmienna warunkowa sygnalizowana przez odchodzących czytelników
+    unsigned int writers; ///< liczba pisarzy trzymających blokadę
+    unsigned int waiting; ///< liczba czytelników czekających na koniec fazy pisarzy
+    unsigned long long phase; ///< liczba zakończonych faz pisarzy
+    bool draining; ///< czy pierwszy pisarz fazy czeka na czytelników
+};
+
+/** @brief Tworzy blokadę.
+ * Pamięć blokady jest wyrównana do linii pamięci podręcznej.
+ * @return Wskaźnik na blokadę lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+struct ReaderLock *readerLockNew(void);
+
+/** @brief Usuwa blokadę.
+ * Nic nie robi, jeśli @p lock ma wartość NULL.
+ * @param[in] lock – wskaźnik na blokadę, której nikt nie trzyma.
+ */
+void readerLockDelete(struct ReaderLock *lock);
+
+/** @brief Zakłada blokadę czytelnika.
+ * Czeka do końca fazy pisarzy, jeżeli pisarz zmienia dane lub czeka na
+ * czytelników.
+ * @param[in,out] lock – wskaźnik na blokadę.
+ */
+void readLock(struct ReaderLock *lock);
+
+/** @brief Zdejmuje blokadę czytelnika założoną w tym samym wątku.
+ * @param[in,out] lock – wskaźnik na blokadę.
+ */
+void readUnlock(struct ReaderLock *lock);
+
+/** @brief Zakłada blokadę pisarza.
+ * Czeka na zakończenie pracy wszystkich czytelników. Inni pisarze mogą
+ * trzymać blokadę w tym samym czasie, ale jeśli na koniec ich fazy czekają
+ * czytelnicy, to pisarz czeka, aż ci czytelnicy wejdą.
+ * @param[in,out] lock – wskaźnik na blokadę.
+ */
+void writeLock(struct ReaderLock *lock);
+
+/** @brief Zdejmuje blokadę pisarza.
+ * @param[in,out] lock – wskaźnik na blokadę.
+ */
+void writeUnlock(struct ReaderLock *lock);
+
+#endif /* __READER_LOCK_H__ */
@@ -0,0 +1,138 @@
+/** @file
+ * Test programu phone_forward z wieloma bazami przekierowań
+ *
+ * Generuje wejście, które tworzy 100 000 baz, usuwa co trzecią i odpytuje
+ * wszystkie w przemieszanej kolejności, po czym uruchamia na nim program
+ * podany w argumencie i porównuje wyjście z oczekiwanym.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Liczba tworzonych baz
+ */
+#define testBases 100000
+
+/**
+ * Mnożnik permutujący kolejność zapytań (względnie pierwszy z @ref testBases)
+ */
+#define testStride 7919
+
+/** @brief Zapisuje wejście testu.
+ * @param[in,out] input – plik wejścia.
+ * @return Wartość @p true, jeśli zapisano wejście.
+ */
+static bool testWriteInput(FILE *input)
+{
+    for(int i = 0; i < testBases; i++)
+        fprintf(input, "NEW b%d\n1 > 9%d\n", i, i);
+
+    for(int i = 0; i < testBases; i += 3)
+        fprintf(input, "DEL b%d\n", i);
+
+    // Usunięte bazy są tworzone od nowa, więc nie mają przekierowań
+    for(long long k = 0; k < testBases; k++)
+    {
+        int i = k * testStride % testBases;
+
+        fprintf(input, "NEW b%d\n12 ?\n", i);
+    }
+
+    return fflush(input) == 0 && !ferror(input);
+}
+
+/** @brief Sprawdza wyjście programu.
+ * @param[in,out] output – wyjście programu.
+ * @return Liczba błędnych wierszy.
+ */
+static int testCheckOutput(FILE *output)
+{
+    char line[64], expected[64];
+    int errors = 0;
+
+    for(long long k = 0; k < testBases; k++)
+    {
+        int i = k * testStride % testBases;
+
+        if (i % 3 == 0)
+            sprintf(expected, "12\n");
+        else
+            sprintf(expected, "9%d2\n", i);
+
+        if (fgets(line, sizeof(line), output) == NULL)
+        {
+            fprintf(stderr, "output ends before query %lld\n", k);
+            return errors + 1;
+        }
+
+        if (strcmp(line, expected) != 0 && errors++ < 10)
+            fprintf(stderr, "base b%d: got %s", i, line);
+    }
+
+    if (fgets(line, sizeof(line), output) != NULL)
+    {
+        fprintf(stderr, "unexpected output: %s", line);
+        errors++;
+    }
+
+    return errors;
+}
+
+/** @brief Uruchamia test.
+ * @param[in] argc – liczba argumentów;
+ * @param[in] argv – argumenty: ścieżka programu phone_forward.
+ * @return 0, jeśli test się udał, a 1 w przeciwnym wypadku.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s phone_forward\n", argv[0]);
+        return 1;
+    }
+
+    char path[] = "/tmp/phone_forward_bases_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *input = fd >= 0 ? fdopen(fd, "w") : NULL;
+
+    if (input == NULL || !testWriteInput(input))
+    {
+        perror(path);
+        return 1;
+    }
+
+    fclose(input);
+
+    char *command = malloc(strlen(argv[1]) + strlen(path) + 16);
+
+    if (command == NULL)
+    {
+        unlink(path);
+        return 1;
+    }
+
+    sprintf(command, "'%s' < '%s'", argv[1], path);
+
+    FILE *output = popen(command, "r");
+    int errors = output != NULL ? testCheckOutput(output) : 1;
+    int status = output != NULL ? pclose(output) : -1;
+
+    unlink(path);
+    free(command);
+
+    if (status != 0)
+    {
+        fprintf(stderr, "%s exited with status %d\n", argv[1], status);
+        errors++;
+    }
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/** @file
+ * Testy wyznaczania przekierowań bez alokowania pamięci
+ *
+ * Program porównuje wyniki @ref phfwdGetBatch z wynikami @ref phfwdGetView
+ * i @ref phfwdGet dla każdego numeru z osobna na losowych strukturach,
+ * także zamrożonych. Zestawy numerów zawierają napisy, które nie są
+ * numerami, powtórzenia, numery będące prefiksami innych numerów oraz
+ * numery posortowane i nieposortowane, bo przechodzenie posortowanych
+ * numerów współdzieli ścieżkę w drzewie między kolejnymi numerami.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_utils.h"
+
+/**
+ * Liczba numerów w zestawie
+ */
+#define testBatchSize 2000
+
+/**
+ * Maksymalna długość numeru w zestawie
+ */
+#define testBatchLength 12
+
+/** @brief Porównuje napisy przy sortowaniu.
+ * @param[in] a – wskaźnik na wskaźnik na pierwszy napis;
+ * @param[in] b – wskaźnik na wskaźnik na drugi napis.
+ * @return Wynik porównania napisów funkcją strcmp.
+ */
+static int testCompare(void const *a, void const *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/** @brief Sprawdza, czy wynik bez alokowania jest równy numerowi.
+ * @param[in] view – wskaźnik na wynik;
+ * @param[in] pnum – wskaźnik na wynik @ref phfwdGet.
+ * @return Wartość @p true, jeśli prefiks z końcówką są jedynym numerem
+ *         @p pnum albo wynik oznacza niepoprawny numer, a @p pnum jest pusty.
+ */
+static bool testViewIs(struct PhoneForwardView const *view, struct PhoneNumbers const *pnum)
+{
+    char const *num = phnumGet(pnum, 0);
+
+    if (view->suffix == NULL || num == NULL)
+        return view->suffix == NULL && num == NULL && pnum != NULL;
+
+    return strlen(view->prefix) >= view->prefixLength && strncmp(num, view->prefix, view->prefixLength) == 0
+           && strcmp(num + view->prefixLength, view->suffix) == 0 && phnumGet(pnum, 1) == NULL;
+}
+
+/** @brief Tworzy zestaw numerów.
+ * Zestaw zawiera numery losowe, ich prefiksy i powtórzenia oraz napisy,
+ * które nie są numerami (pusty, z niedozwolonym znakiem i NULL).
+ * @param[in] seed – ziarno generatora;
+ * @param[in] sorted – czy numery (bez NULL) mają być posortowane.
+ * @return Tablica @ref testBatchSize napisów lub NULL, gdy nie udało się
+ *         zaalokować pamięci. Napisy leżą w tym samym bloku co tablica.
+ */
+static char **testBatch(unsigned int seed, bool sorted)
+{
+    char **nums = malloc(testBatchSize * (sizeof(char *) + testBatchLength + 2));
+
+    if (nums == NULL)
+        return NULL;
+
+    char *text = (char *)(nums + testBatchSize);
+
+    for(int i = 0; i < testBatchSize; i++)
+    {
+        nums[i] = text + i * (testBatchLength + 2);
+
+        int kind = rand_r(&seed) % 10;
+
+        if (kind == 0 && i > 0 && nums[i - 1] != NULL)
+        {
+            // Prefiks lub powtórzenie poprzedniego numeru
+            strcpy(nums[i], nums[i - 1]);
+            nums[i][rand_r(&seed) % (strlen(nums[i]) + 1)] = '\0';
+        }
+        else if (kind == 1)
+        {
+            testNumber(&seed, nums[i], testBatchLength - 1);
+            nums[i][rand_r(&seed) % strlen(nums[i])] = 'a';
+        }
+        else if (kind == 2)
+        {
+            nums[i][0] = '\0';
+
+            if (i % 3 == 0)
+                nums[i] = NULL;
+        }
+        else
+            testNumber(&seed, nums[i], testBatchLength);
+    }
+
+    if (sorted)
+    {
+        size_t present = 0;
+
+        for(int i = 0; i < testBatchSize; i++)
+        {
+            if (nums[i] != NULL)
+                nums[present++] = nums[i];
+        }
+
+        qsort(nums, present, sizeof(char *), testCompare);
+
+        for(size_t i = present; i < testBatchSize; i++)
+            nums[i] = NULL;
+    }
+
+    return nums;
+}
+
+/** @brief Porównuje wyniki @ref phfwdGetBatch z wynikami dla pojedynczych numerów.
+ * @param[in] pf – wskaźnik na sprawdzaną strukturę;
+ * @param[in] reference – wskaźnik na strukturę z tymi samymi przekierowaniami,
+ *                        która nie jest zamrożona;
+ * @param[in] seed – ziarno generatora zestawów.
+ * @param[in] what – opis sprawdzanej struktury.
+ */
+static void testBatches(struct PhoneForward *pf, struct PhoneForward *reference, unsigned int seed,
+                        char const *what)
+{
+    struct PhoneForwardView *views = malloc(testBatchSize * sizeof(struct PhoneForwardView));
+    int errors = 0;
+
+    for(int round = 0; views != NULL && round < 6; round++)
+    {
+        char **nums = testBatch(seed + round, round % 2 == 0);
+        // Zestawy różnej długości, także pusty i jednoelementowy
+        size_t count = round < 2 ? testBatchSize : (size_t[]){0, 1, 17, 500}[round - 2];
+
+        if (nums == NULL || !phfwdGetBatch(pf, (char const *const *)nums, count, views))
+        {
+            testCheck(false, "phfwdGetBatch");
+            free(nums);
+            continue;
+        }
+
+        for(size_t i = 0; i < count; i++)
+        {
+            struct PhoneForwardView single;
+            bool valid = phfwdGetView(pf, nums[i], &single);
+            struct PhoneNumbers const *pnum = phfwdGet(reference, nums[i]);
+
+            if (!valid)
+                single.suffix = NULL;
+
+            errors += !testViewIs(&views[i], pnum) || !testViewIs(&single, pnum);
+            errors += valid && (views[i].prefixLength != single.prefixLength
+                                || strncmp(views[i].prefix, single.prefix, single.prefixLength) != 0
+                                || strcmp(views[i].suffix, single.suffix) != 0);
+            phnumDelete(pnum);
+        }
+
+        free(nums);
+    }
+
+    if (errors > 0)
+        fprintf(stderr, "%d wrong results\n", errors);
+
+    testCheck(views != NULL && errors == 0, what);
+    free(views);
+}
+
+/** @brief Uruchamia testy.
+ * @return 0, jeśli testy się udały, a 1 w przeciwnym wypadku.
+ */
+int main(void)
+{
+    for(unsigned int seed = 1; seed <= 4; seed++)
+    {
+        struct PhoneForward *pf = phfwdNew(), *reference = phfwdNew();
+
+        // Małe bazy mają płytkie drzewa, a duże długie ścieżki wspólne dla wielu numerów
+        testFill(pf, seed, 500 * seed * seed);
+        testFill(reference, seed, 500 * seed * seed);
+        testBatches(pf, reference, seed * 100, "phfwdGetBatch matches phfwdGetView and phfwdGet");
+
+        testCheck(phfwdFreeze(pf), "phfwdFreeze");
+        testBatches(pf, reference, seed * 100 + 50, "phfwdGetBatch on a frozen structure");
+
+        testCheck(!phfwdGetBatch(pf, NULL, 1, NULL), "phfwdGetBatch rejects NULL arrays");
+
+        phfwdDelete(pf);
+        phfwdDelete(reference);
+    }
+
+    struct PhoneForwardView view;
+
+    testCheck(!phfwdGetView(NULL, "1", &view) && !phfwdGetBatch(NULL, NULL, 0, NULL),
+              "NULL structure is rejected");
+
+    return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,218 @@
+/** @file
+ * Test trybu współbieżnego
+ *
+ * Kilka wątków zmienia przekierowania w strukturze w trybie współbieżnym,
+ * a inne w tym czasie wyznaczają przekierowania, odwracają je i liczą
+ * nietrywialne numery. Każdy pisarz zmienia tylko prefiksy zaczynające się
+ * od własnej pary cyfr, ale pierwsze cyfry są wspólne dla kilku pisarzy,
+ * a numery docelowe są dowolne, więc pisarze konkurują o te same części
+ * obu drzew. Zmiany różnych pisarzy są przemienne, więc na końcu struktura
+ * musi odpowiadać tak samo jak struktura, w której zmiany kolejnych
+ * pisarzy wykonano po kolei w jednym wątku.
+ *
+ * Test można uruchomić z ThreadSanitizerem (zob. opcję SANITIZE
+ * w CMakeLists.txt).
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "test_utils.h"
+
+/**
+ * Liczba pisarzy
+ */
+#define testWriters 6
+
+/**
+ * Liczba czytelników
+ */
+#define testReaders 4
+
+/**
+ * Liczba zmian wykonywanych przez każdego pisarza
+ */
+#define testChanges 4000
+
+/**
+ * Liczba pierwszych cyfr prefiksów pisarzy (kilku pisarzy ma tę samą)
+ */
+#define testShards 3
+
+/**
+ * @brief Dane wątku testu.
+ */
+struct TestThread
+{
+    pthread_t thread; ///< wątek
+    struct PhoneForward *pf; ///< wspólna struktura w trybie współbieżnym
+    int id; ///< numer pisarza lub czytelnika
+    atomic_bool *stop; ///< czy pisarze skończyli (dla czytelników)
+    int failures; ///< liczba błędnych odpowiedzi zauważonych przez wątek
+};
+
+/** @brief Losuje zmianę pisarza.
+ * Prefiks zaczyna się od cyfry id % testShards, po której następuje cyfra id.
+ * @param[in] id – numer pisarza;
+ * @param[in,out] seed – stan generatora;
+ * @param[out] num1 – bufor na prefiks (co najmniej 16 znaków);
+ * @param[out] num2 – bufor na numer docelowy (co najmniej 16 znaków) lub
+ *                    pusty napis, jeżeli zmiana usuwa przekierowania.
+ */
+static void testWriterChange(int id, unsigned int *seed, char *num1, char *num2)
+{
+    num1[0] = '0' + id % testShards;
+    num1[1] = '0' + id;
+    testNumber(seed, num1 + 2, rand_r(seed) % 10 == 0 ? 1 : 6);
+    testNumber(seed, num2, 7);
+
+    if (rand_r(seed) % 6 == 0)
+        num2[0] = '\0';
+}
+
+/** @brief Wykonuje zmianę pisarza.
+ * @param[in,out] pf – wskaźnik na strukturę;
+ * @param[in] num1 – prefiks;
+ * @param[in] num2 – numer docelowy lub pusty napis.
+ */
+static void testWriterApply(struct PhoneForward *pf, char const *num1, char const *num2)
+{
+    if (num2[0] == '\0')
+        phfwdRemove(pf, num1);
+    else
+        phfwdAdd(pf, num1, num2);
+}
+
+/** @brief Wykonuje zmiany pisarza.
+ * @param[in,out] data – wskaźnik na @ref TestThread.
+ * @return NULL.
+ */
+static void *testWriter(void *data)
+{
+    struct TestThread *w = data;
+    unsigned int seed = w->id + 1;
+    char num1[16], num2[16];
+
+    for(int i = 0; i < testChanges; i++)
+    {
+        testWriterChange(w->id, &seed, num1, num2);
+        testWriterApply(w->pf, num1, num2);
+    }
+
+    return NULL;
+}
+
+/** @brief Odpytuje strukturę, dopóki pisarze działają.
+ * Sprawdza, czy wyniki mają postać, której wymaga interfejs: przekierowanie
+ * to jeden numer, a wynik odwrócenia jest posortowany i zawiera sam numer.
+ * @param[in,out] data – wskaźnik na @ref TestThread.
+ * @return NULL.
+ */
+static void *testReader(void *data)
+{
+    struct TestThread *r = data;
+    unsigned int seed = 1000 + r->id;
+    char num[16];
+
+    while (!atomic_load(r->stop))
+    {
+        testNumber(&seed, num, 9);
+
+        struct PhoneNumbers const *pnum = phfwdGet(r->pf, num);
+
+        r->failures += phnumGet(pnum, 0) == NULL || phnumGet(pnum, 1) != NULL;
+        phnumDelete(pnum);
+
+        pnum = phfwdReverse(r->pf, num);
+
+        bool self = false;
+
+        for(size_t i = 0; phnumGet(pnum, i) != NULL; i++)
+        {
+            self = self || strcmp(phnumGet(pnum, i), num) == 0;
+            r->failures += i > 0 && strcmp(phnumGet(pnum, i - 1), phnumGet(pnum, i)) >= 0;
+        }
+
+        r->failures += !self;
+        phnumDelete(pnum);
+
+        phfwdNonTrivialCount(r->pf, num, rand_r(&seed) % 8);
+
+        // Wynik bez alokowania jest ważny pod blokadą czytelnika
+        struct PhoneForwardView view;
+
+        phfwdReadLock(r->pf);
+        r->failures += !phfwdGetView(r->pf, num, &view) || strlen(view.suffix) > strlen(num);
+        phfwdReadUnlock(r->pf);
+    }
+
+    return NULL;
+}
+
+/** @brief Uruchamia test.
+ * @return 0, jeśli test się udał, a 1 w przeciwnym wypadku.
+ */
+int main(void)
+{
+    struct PhoneForward *pf = phfwdNew(), *reference = phfwdNew();
+    struct TestThread threads[testWriters + testReaders];
+    atomic_bool stop;
+
+    atomic_init(&stop, false);
+
+    // Struktura ma przekierowania, zanim zaczną działać wątki
+    testFill(pf, 7, 2000);
+    testFill(reference, 7, 2000);
+
+    if (pf == NULL || reference == NULL || !phfwdSetConcurrent(pf))
+    {
+        fprintf(stderr, "cannot create a concurrent structure\n");
+        return 1;
+    }
+
+    phfwdSetCountThreads(pf, 2);
+
+    for(int i = 0; i < testWriters + testReaders; i++)
+    {
+        threads[i] = (struct TestThread){.pf = pf, .id = i < testWriters ? i : i - testWriters, .stop = &stop};
+        pthread_create(&threads[i].thread, NULL, i < testWriters ? testWriter : testReader, &threads[i]);
+    }
+
+    for(int i = 0; i < testWriters; i++)
+        pthread_join(threads[i].thread, NULL);
+
+    atomic_store(&stop, true);
+
+    for(int i = testWriters; i < testWriters + testReaders; i++)
+    {
+        pthread_join(threads[i].thread, NULL);
+        testCheck(threads[i].failures == 0, "concurrent queries return well-formed results");
+    }
+
+    // Zmiany pisarzy wykonane po kolei w jednym wątku
+    for(int id = 0; id < testWriters; id++)
+    {
+        unsigned int seed = id + 1;
+        char num1[16], num2[16];
+
+        for(int i = 0; i < testChanges; i++)
+        {
+            testWriterChange(id, &seed, num1, num2);
+            testWriterApply(reference, num1, num2);
+        }
+    }
+
+    testCheck(testSame(pf, reference, 3), "concurrent changes match a sequential replay");
+
+    phfwdDelete(pf);
+    phfwdDelete(reference);
+
+    return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,224 @@
+/** @file
+ * Testy zapamiętywania wyników phfwdNonTrivialCount
+ *
+ * Program na przemian zmienia przekierowania i powtarza te same zapytania
+ * o liczbę nietrywialnych numerów, więc kolejne zapytania trafiają
+ * w zapamiętane wyniki. Odpowiedzi porównuje ze strukturą w trybie
+ * współbieżnym, która nie zapamiętuje wyników. Zmianami są dodanie
+ * i usunięcie przekierowań, przywrócenie migawki, wczytanie z pliku
+ * i zamrożenie.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "test_utils.h"
+
+/**
+ * Liczba zmian w teście
+ */
+#define testSteps 300
+
+/**
+ * Maksymalna długość numerów z zapytań
+ */
+#define testMaxLength 6
+
+/**
+ * Zbiory cyfr z zapytań
+ */
+static char const *const testSets[] = {"0123456789:;", "0", "19", "357", ":;", "0a1"};
+
+/**
+ * @brief Zmiana przekierowań.
+ */
+struct TestOperation
+{
+    char num1[8]; ///< przekierowywany prefiks lub prefiks usuwanych przekierowań
+    char num2[8]; ///< prefiks, na który jest przekierowanie, lub pusty napis dla usunięcia
+};
+
+/**
+ * Zmiany przekierowań, które wyznaczają aktualną zawartość struktury
+ */
+static struct TestOperation testLog[testSteps];
+
+/**
+ * Liczba zmian w @ref testLog
+ */
+static size_t testLogSize = 0;
+
+/** @brief Wykonuje zmianę.
+ * @param[in,out] pf – wskaźnik na strukturę;
+ * @param[in] op – wskaźnik na zmianę.
+ */
+static void testApply(struct PhoneForward *pf, struct TestOperation const *op)
+{
+    if (op->num2[0] == '\0')
+        phfwdRemove(pf, op->num1);
+    else
+        phfwdAdd(pf, op->num1, op->num2);
+}
+
+/** @brief Tworzy strukturę, która nie zapamiętuje wyników.
+ * @param[in] operations – liczba pierwszych zmian z @ref testLog, które ją wyznaczają.
+ * @return Wskaźnik na strukturę w trybie współbieżnym lub NULL, gdy nie
+ *         udało się zaalokować pamięci.
+ */
+static struct PhoneForward *testUncached(size_t operations)
+{
+    struct PhoneForward *pf = phfwdNew();
+
+    for(size_t i = 0; pf != NULL && i < operations; i++)
+        testApply(pf, &testLog[i]);
+
+    if (pf != NULL && !phfwdSetConcurrent(pf))
+    {
+        phfwdDelete(pf);
+        return NULL;
+    }
+
+    return pf;
+}
+
+/** @brief Zadaje wszystkie zapytania, żeby ich wyniki zostały zapamiętane.
+ * @param[in,out] pf – wskaźnik na strukturę.
+ */
+static void testWarm(struct PhoneForward *pf)
+{
+    for(size_t s = 0; s < sizeof(testSets) / sizeof(testSets[0]); s++)
+    {
+        for(size_t len = 1; len <= testMaxLength; len++)
+            phfwdNonTrivialCount(pf, testSets[s], len);
+    }
+}
+
+/** @brief Porównuje wyniki zapytań z wynikami struktury, która ich nie zapamiętuje.
+ * Każde zapytanie jest zadawane dwa razy, więc drugi wynik pochodzi
+ * z pamięci wyników.
+ * @param[in,out] pf – wskaźnik na sprawdzaną strukturę;
+ * @param[in,out] uncached – wskaźnik na strukturę z tymi samymi przekierowaniami;
+ * @param[in] what – opis sprawdzanej zmiany.
+ */
+static void testCounts(struct PhoneForward *pf, struct PhoneForward *uncached, char const *what)
+{
+    bool same = pf != NULL && uncached != NULL;
+
+    for(size_t s = 0; same && s < sizeof(testSets) / sizeof(testSets[0]); s++)
+    {
+        for(size_t len = 1; same && len <= testMaxLength; len++)
+        {
+            size_t expected = phfwdNonTrivialCount(uncached, testSets[s], len);
+
+            same = phfwdNonTrivialCount(pf, testSets[s], len) == expected
+                   && phfwdNonTrivialCount(pf, testSets[s], len) == expected;
+        }
+    }
+
+    testCheck(same, what);
+}
+
+/** @brief Losuje zmianę krótkich numerów, która zwykle zmienia wyniki zapytań.
+ * @param[in,out] seed – stan generatora;
+ * @param[out] op – wskaźnik na zmianę.
+ */
+static void testOperation(unsigned int *seed, struct TestOperation *op)
+{
+    testNumber(seed, op->num1, 3);
+    testNumber(seed, op->num2, 4);
+
+    if (rand_r(seed) % 4 == 0)
+        op->num2[0] = '\0';
+}
+
+/** @brief Uruchamia testy.
+ * @return 0, jeśli testy się udały, a 1 w przeciwnym wypadku.
+ */
+int main(void)
+{
+    struct PhoneForward *pf = phfwdNew(), *uncached = testUncached(0), *snapshot = NULL;
+    unsigned int seed = 5;
+    size_t snapshotSize = 0;
+
+    for(int step = 0; step < testSteps && pf != NULL && uncached != NULL; step++)
+    {
+        struct TestOperation *op = &testLog[testLogSize++];
+
+        testWarm(pf);
+        testOperation(&seed, op);
+        testApply(pf, op);
+        testApply(uncached, op);
+        testCounts(pf, uncached, op->num2[0] == '\0' ? "count after phfwdRemove" : "count after phfwdAdd");
+
+        // Zmiany, które niczego nie zmieniają, nie mogą zepsuć zapamiętanych wyników
+        testWarm(pf);
+        phfwdAdd(pf, "1", "1");
+        phfwdRemove(pf, "a");
+        testCounts(pf, uncached, "count after a rejected change");
+
+        if (step % 50 == 10)
+        {
+            phfwdDelete(snapshot);
+            snapshot = phfwdSnapshot(pf);
+            snapshotSize = testLogSize;
+            testCounts(snapshot, uncached, "count of a snapshot");
+        }
+
+        if (step % 50 == 40)
+        {
+            testWarm(pf);
+            testWarm(snapshot);
+            testCheck(phfwdRollback(pf, snapshot), "phfwdRollback");
+            testLogSize = snapshotSize;
+            phfwdDelete(uncached);
+            uncached = testUncached(testLogSize);
+            testCounts(pf, uncached, "count after phfwdRollback");
+            testCounts(snapshot, uncached, "count of a snapshot after phfwdRollback");
+        }
+    }
+
+    phfwdDelete(snapshot);
+
+    // Wczytana struktura zaczyna bez zapamiętanych wyników i zapamiętuje nowe
+    char path[] = "/tmp/phone_forward_count_XXXXXX";
+    int fd = mkstemp(path);
+    struct PhoneForward *loaded = NULL;
+
+    testWarm(pf);
+
+    if (fd >= 0 && phfwdSave(pf, path))
+        loaded = phfwdLoad(path);
+
+    testCheck(loaded != NULL, "phfwdLoad");
+    testCounts(loaded, uncached, "count after phfwdLoad");
+
+    struct TestOperation op = {"12", ""};
+
+    testWarm(loaded);
+    testApply(loaded, &op);
+    testApply(uncached, &op);
+    testCounts(loaded, uncached, "count after a change after phfwdLoad");
+
+    // Zamrożenie nie zmienia przekierowań, więc zapamiętane wyniki są dalej poprawne
+    testWarm(loaded);
+    testCheck(phfwdFreeze(loaded), "phfwdFreeze");
+    testCounts(loaded, uncached, "count after phfwdFreeze");
+
+    if (fd >= 0)
+    {
+        close(fd);
+        unlink(path);
+    }
+
+    phfwdDelete(loaded);
+    phfwdDelete(pf);
+    phfwdDelete(uncached);
+
+    return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,253 @@
+/** @file
+ * Test bardzo długich numerów i bardzo głębokich drzew
+ *
+ * Program dodaje, wyznacza, odwraca, liczy i usuwa przekierowania numerów
+ * mających około 100 000 cyfr oraz przekierowania, które rozgałęziają
+ * drzewa na każdej z 10 000 głębokości. Wszystko wykonuje w wątku
+ * ze stosem o rozmiarze @ref testStackSize, więc rekurencja po cyfrach
+ * numeru lub po wierzchołkach drzewa kończy się przepełnieniem stosu.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "test_utils.h"
+
+/**
+ * Rozmiar stosu wątku testu w bajtach
+ */
+#define testStackSize (64 * 1024)
+
+/**
+ * Liczba cyfr długich numerów
+ */
+#define testLongLength 100000
+
+/**
+ * Liczba głębokości, na których rozgałęziają się drzewa
+ */
+#define testDepth 10000
+
+/** @brief Tworzy numer z powtarzanych cyfr 0-9 zaczynający się od cyfry @p first.
+ * @param[in] length – długość numeru;
+ * @param[in] first – pierwsza cyfra.
+ * @return Wskaźnik na numer lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+static char *testLongNumber(size_t length, int first)
+{
+    char *num = malloc(length + 2);
+
+    if (num != NULL)
+    {
+        for(size_t i = 0; i < length; i++)
+            num[i] = '0' + (first + i) % 10;
+
+        num[length] = '\0';
+    }
+
+    return num;
+}
+
+/** @brief Sprawdza, czy ciąg numerów to dokładnie podane numery.
+ * @param[in] pnum – wskaźnik na ciąg numerów;
+ * @param[in] first – jeden z oczekiwanych numerów;
+ * @param[in] second – drugi oczekiwany numer lub NULL.
+ * @return Wartość @p true, jeśli ciąg składa się z podanych numerów
+ *         w kolejności leksykograficznej.
+ */
+static bool testNumbers(struct PhoneNumbers const *pnum, char const *first, char const *second)
+{
+    char const *x = phnumGet(pnum, 0), *y = phnumGet(pnum, 1);
+
+    if (second != NULL && strcmp(first, second) > 0)
+    {
+        char const *swap = first;
+
+        first = second;
+        second = swap;
+    }
+
+    return x != NULL && strcmp(x, first) == 0
+           && (second == NULL ? y == NULL : y != NULL && strcmp(y, second) == 0 && phnumGet(pnum, 2) == NULL);
+}
+
+/** @brief Sprawdza przekierowanie numerów o @ref testLongLength cyfrach.
+ */
+static void testLong(void)
+{
+    struct PhoneForward *pf = phfwdNew();
+    char *num1 = testLongNumber(testLongLength, 1), *num2 = testLongNumber(testLongLength, 2);
+    char *query = testLongNumber(testLongLength + 1, 1);
+    char *expected = testLongNumber(testLongLength + 1, 2);
+
+    if (pf == NULL || num1 == NULL || num2 == NULL || query == NULL || expected == NULL)
+    {
+        testCheck(false, "allocation");
+        return;
+    }
+
+    query[testLongLength] = '5';
+    expected[testLongLength] = '5';
+
+    testCheck(phfwdAdd(pf, num1, num2), "phfwdAdd of long numbers");
+
+    struct PhoneNumbers const *pnum = phfwdGet(pf, query);
+
+    testCheck(testNumbers(pnum, expected, NULL), "phfwdGet of a long number");
+    phnumDelete(pnum);
+
+    pnum = phfwdReverse(pf, num2);
+    testCheck(testNumbers(pnum, num1, num2), "phfwdReverse of a long number");
+    phnumDelete(pnum);
+
+    // Jedyny numer długości testLongLength przekierowany na siebie to num2
+    testCheck(phfwdNonTrivialCount(pf, "0123456789", testLongLength) == 1,
+              "phfwdNonTrivialCount of long numbers");
+
+    phfwdRemove(pf, num1);
+    pnum = phfwdGet(pf, query);
+    testCheck(testNumbers(pnum, query, NULL), "phfwdRemove of a long number");
+    phnumDelete(pnum);
+
+    testCheck(phfwdNonTrivialCount(pf, "0123456789", testLongLength) == 0,
+              "phfwdNonTrivialCount after phfwdRemove");
+
+    free(num1);
+    free(num2);
+    free(query);
+    free(expected);
+    phfwdDelete(pf);
+}
+
+/** @brief Tworzy numer rozgałęziający drzewo na głębokości @p depth.
+ * @param[in] base – wskaźnik na długi numer;
+ * @param[in] depth – głębokość rozgałęzienia;
+ * @param[in] shift – o ile zmieniana jest cyfra numeru @p base na głębokości @p depth (od 1 do 9).
+ * @return Wskaźnik na numer: pierwsze @p depth cyfr @p base i zmieniona cyfra
+ *         lub NULL, gdy nie udało się zaalokować pamięci.
+ */
+static char *testBranch(char const *base, size_t depth, int shift)
+{
+    char *num = malloc(depth + 2);
+
+    if (num != NULL)
+    {
+        memcpy(num, base, depth);
+        num[depth] = '0' + (base[depth] - '0' + shift) % 10;
+        num[depth + 1] = '\0';
+    }
+
+    return num;
+}
+
+/** @brief Sprawdza drzewa rozgałęziające się na @ref testDepth głębokościach.
+ * Przekierowania prowadzą z numerów zmieniających cyfrę długiego numeru na
+ * kolejnych głębokościach na numery zmieniające tę cyfrę inaczej, więc oba
+ * drzewa mają ścieżkę z @ref testDepth wierzchołkami.
+ */
+static void testDeep(void)
+{
+    struct PhoneForward *pf = phfwdNew();
+    char *base = testLongNumber(testDepth + 1, 0);
+    size_t expected = 0, power = 1, remaining = 0;
+    bool added = pf != NULL && base != NULL;
+
+    for(size_t depth = testDepth; added && depth-- > 0;)
+    {
+        char *num1 = testBranch(base, depth, 1), *num2 = testBranch(base, depth, 2);
+
+        added = num1 != NULL && num2 != NULL && phfwdAdd(pf, num1, num2);
+        free(num1);
+        free(num2);
+
+        // Numer docelowy z głębokości depth wyznacza power numerów długości testDepth
+        expected += power;
+        remaining = power;
+        power *= 10;
+    }
+
+    testCheck(added, "phfwdAdd of branches");
+
+    for(size_t depth = 0; added && depth < testDepth; depth += 397)
+    {
+        char *num1 = testBranch(base, depth, 1), *num2 = testBranch(base, depth, 2);
+        struct PhoneNumbers const *pnum;
+
+        if (num1 == NULL || num2 == NULL)
+        {
+            free(num1);
+            free(num2);
+            testCheck(false, "allocation");
+            break;
+        }
+
+        pnum = phfwdGet(pf, num1);
+        testCheck(testNumbers(pnum, num2, NULL), "phfwdGet at depth");
+        phnumDelete(pnum);
+
+        pnum = phfwdReverse(pf, num2);
+        testCheck(testNumbers(pnum, num1, num2), "phfwdReverse at depth");
+        phnumDelete(pnum);
+
+        free(num1);
+        free(num2);
+    }
+
+    // Liczba jest liczona modulo rozmiar size_t tak samo jak expected
+    testCheck(!added || phfwdNonTrivialCount(pf, "0123456789", testDepth) == expected,
+              "phfwdNonTrivialCount of branches");
+
+    // Wszystkie przekierowania oprócz pierwszego zaczynają się od cyfry 0
+    phfwdRemove(pf, "0");
+    testCheck(phfwdNonTrivialCount(pf, "0123456789", testDepth) == remaining,
+              "phfwdRemove of branches");
+
+    struct PhoneForward *copy = phfwdSnapshot(pf);
+
+    testCheck(copy != NULL, "phfwdSnapshot");
+    phfwdDelete(copy);
+
+    free(base);
+    phfwdDelete(pf);
+}
+
+/** @brief Wykonuje przypadki testowe.
+ * @param[in] data – nieużywany.
+ * @return NULL.
+ */
+static void *testRun(void *data)
+{
+    (void)data;
+
+    testLong();
+    testDeep();
+
+    return NULL;
+}
+
+/** @brief Uruchamia test w wątku z małym stosem.
+ * @return 0, jeśli test się udał, a 1 w przeciwnym wypadku.
+ */
+int main(void)
+{
+    pthread_attr_t attr;
+    pthread_t thread;
+
+    if (pthread_attr_init(&attr) != 0 || pthread_attr_setstacksize(&attr, testStackSize) != 0
+        || pthread_create(&thread, &attr, testRun, NULL) != 0)
+    {
+        fprintf(stderr, "cannot create a thread with a %d byte stack\n", testStackSize);
+        return 1;
+    }
+
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+
+    return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,392 @@
+/** @file
+ * Testy zapisywania i odtwarzania przekierowań
+ *
+ * Program wykonuje przypadek testowy o nazwie podanej w argumencie:
+ * zapisanie i wczytanie struktury, otwarcie pliku bez wczytywania,
+ * odrzucanie uszkodzonych plików oraz odtwarzanie dziennika z przerwanym
+ * ostatnim zapisem. Pliki są tworzone w katalogu tymczasowym, który jest
+ * usuwany na końcu.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../src/phone_forward_internal.h"
+#include "test_utils.h"
+
+/**
+ * Maksymalna długość ścieżki pliku testu
+ */
+#define testPathLength 256
+
+/**
+ * Katalog tymczasowy testu
+ */
+static char testDirectory[] = "/tmp/phone_forward_test_XXXXXX";
+
+/** @brief Tworzy ścieżkę pliku w katalogu tymczasowym.
+ * @param[out] path – bufor na @ref testPathLength znaków;
+ * @param[in] name – nazwa pliku.
+ * @return Wskaźnik @p path.
+ */
+static char *testPath(char *path, char const *name)
+{
+    snprintf(path, testPathLength, "%s/%s", testDirectory, name);
+    return path;
+}
+
+/** @brief Wczytuje cały plik.
+ * @param[in] path – ścieżka pliku;
+ * @param[out] size – rozmiar pliku.
+ * @return Wskaźnik na zawartość pliku lub NULL, gdy nie udało się go odczytać.
+ */
+static char *testReadFile(char const *path, size_t *size)
+{
+    FILE *file = fopen(path, "rb");
+    char *data = NULL;
+
+    if (file != NULL && fseek(file, 0, SEEK_END) == 0)
+    {
+        long length = ftell(file);
+
+        data = length > 0 ? malloc(length) : NULL;
+
+        if (data != NULL && (fseek(file, 0, SEEK_SET) != 0 || fread(data, 1, length, file) != (size_t)length))
+        {
+            free(data);
+            data = NULL;
+        }
+
+        *size = length;
+    }
+
+    if (file != NULL)
+        fclose(file);
+
+    return data;
+}
+
+/** @brief Zapisuje cały plik.
+ * @param[in] path – ścieżka pliku;
+ * @param[in] data – zawartość;
+ * @param[in] size – rozmiar zawartości.
+ * @return Wartość @p true, jeśli zapisano plik.
+ */
+static bool testWriteFile(char const *path, char const *data, size_t size)
+{
+    FILE *file = fopen(path, "wb");
+
+    if (file == NULL)
+        return false;
+
+    bool written = fwrite(data, 1, size, file) == size;
+
+    return fclose(file) == 0 && written;
+}
+
+/** @brief Sprawdza, że plik o zawartości @p data jest odrzucany.
+ * @param[in] data – zawartość pliku;
+ * @param[in] size – rozmiar zawartości;
+ * @param[in] header – czy uszkodzenie jest w nagłówku (wtedy odrzuca go
+ *                     także @ref phfwdOpen bez sprawdzania zawartości);
+ * @param[in] what – opis uszkodzenia.
+ */
+static void testRejected(char const *data, size_t size, bool header, char const *what)
+{
+    char path[testPathLength];
+    struct PhoneForward *loaded, *opened, *verified;
+
+    testWriteFile(testPath(path, "corrupt.bin"), data, size);
+
+    loaded = phfwdLoad(path);
+    verified = phfwdOpen(path, true);
+    opened = header ? phfwdOpen(path, false) : NULL;
+
+    if (loaded != NULL || verified != NULL || opened != NULL)
+        fprintf(stderr, "accepted: %s\n", what);
+
+    testCheck(loaded == NULL, "phfwdLoad rejects a corrupted file");
+    testCheck(verified == NULL, "phfwdOpen with verification rejects a corrupted file");
+    testCheck(opened == NULL, "phfwdOpen rejects a corrupted header");
+
+    phfwdDelete(loaded);
+    phfwdDelete(verified);
+    phfwdDelete(opened);
+    unlink(path);
+}
+
+/** @brief Zapisuje strukturę, wczytuje ją i porównuje z oryginałem.
+ */
+static void testSaveLoad(void)
+{
+    char path[testPathLength], again[testPathLength];
+    struct PhoneForward *pf = phfwdNew();
+
+    testFill(pf, 1, 20000);
+    testCheck(phfwdSave(pf, testPath(path, "base.bin")), "phfwdSave");
+
+    struct PhoneForward *loaded = phfwdLoad(path);
+
+    testCheck(loaded != NULL, "phfwdLoad");
+
+    if (loaded == NULL)
+    {
+        phfwdDelete(pf);
+        return;
+    }
+
+    testCheck(testSame(pf, loaded, 2), "loaded structure answers like the saved one");
+
+    // Wczytaną strukturę można zapisać i wczytać ponownie
+    testCheck(phfwdSave(loaded, testPath(again, "again.bin")), "phfwdSave of a loaded structure");
+
+    struct PhoneForward *reloaded = phfwdLoad(again);
+
+    testCheck(reloaded != NULL && testSame(pf, reloaded, 3), "second round trip");
+    phfwdDelete(reloaded);
+
+    // Wczytana struktura jest zwykłą strukturą, którą można zmieniać
+    testFill(pf, 3, 2000);
+    testFill(loaded, 3, 2000);
+    testCheck(testSame(pf, loaded, 4), "loaded structure changes like the saved one");
+
+    unlink(path);
+    unlink(again);
+    phfwdDelete(loaded);
+    phfwdDelete(pf);
+
+    // Pusta struktura też daje poprawny plik
+    pf = phfwdNew();
+    testCheck(phfwdSave(pf, path), "phfwdSave of an empty structure");
+    loaded = phfwdLoad(path);
+    testCheck(loaded != NULL && testSame(pf, loaded, 5), "empty structure round trip");
+    unlink(path);
+    phfwdDelete(loaded);
+    phfwdDelete(pf);
+}
+
+/** @brief Otwiera zapisany plik bez wczytywania i porównuje z oryginałem.
+ */
+static void testOpen(void)
+{
+    char path[testPathLength];
+    struct PhoneForward *pf = phfwdNew();
+
+    testFill(pf, 6, 20000);
+    testCheck(phfwdSave(pf, testPath(path, "base.bin")), "phfwdSave");
+
+    for(int verify = 0; verify < 2; verify++)
+    {
+        struct PhoneForward *opened = phfwdOpen(path, verify);
+
+        testCheck(opened != NULL, "phfwdOpen");
+
+        if (opened == NULL)
+            continue;
+
+        testCheck(testSame(pf, opened, 7), "opened structure answers like the saved one");
+        testCheck(!phfwdAdd(opened, "1", "2"), "opened structure is read-only");
+
+        phfwdSetCountThreads(opened, 3);
+        testCheck(testSame(pf, opened, 8), "opened structure counts in parallel like the saved one");
+
+        phfwdDelete(opened);
+    }
+
+    unlink(path);
+    phfwdDelete(pf);
+}
+
+/** @brief Sprawdza odrzucanie uszkodzonych plików.
+ */
+static void testCorrupt(void)
+{
+    char path[testPathLength];
+    struct PhoneForward *pf = phfwdNew();
+    size_t size = 0;
+
+    testFill(pf, 9, 5000);
+    testCheck(phfwdSave(pf, testPath(path, "base.bin")), "phfwdSave");
+
+    char *data = testReadFile(path, &size);
+
+    phfwdDelete(pf);
+    unlink(path);
+    testCheck(data != NULL && size > sizeof(struct FrozenForward), "saved file is readable");
+
+    if (data == NULL || size <= sizeof(struct FrozenForward))
+    {
+        free(data);
+        return;
+    }
+
+    char *copy = malloc(size);
+    struct FrozenForward header;
+
+    testRejected(data, 0, true, "empty file");
+    testRejected(data, sizeof(struct FrozenForward) - 1, true, "truncated header");
+    testRejected(data, size - 1, true, "truncated body");
+
+    // Zmiana każdego z kilku bajtów ciała psuje sumę kontrolną
+    for(size_t i = sizeof(struct FrozenForward); i < size; i += size / 7 + 1)
+    {
+        memcpy(copy, data, size);
+        copy[i] ^= 0x10;
+        testRejected(copy, size, false, "flipped body byte");
+    }
+
+    memcpy(&header, data, sizeof(struct FrozenForward));
+    header.version++;
+    memcpy(copy, data, size);
+    memcpy(copy, &header, sizeof(struct FrozenForward));
+    testRejected(copy, size, true, "other version");
+
+    memcpy(&header, data, sizeof(struct FrozenForward));
+    header.byteOrder = __builtin_bswap32(header.byteOrder);
+    memcpy(copy, data, size);
+    memcpy(copy, &header, sizeof(struct FrozenForward));
+    testRejected(copy, size, true, "other byte order");
+
+    memcpy(&header, data, sizeof(struct FrozenForward));
+    header.checksum ^= 1;
+    memcpy(copy, data, size);
+    memcpy(copy, &header, sizeof(struct FrozenForward));
+    testRejected(copy, size, false, "wrong checksum");
+
+    free(copy);
+    free(data);
+}
+
+/** @brief Sprawdza odtwarzanie dziennika z przerwanym ostatnim zapisem.
+ */
+static void testJournal(void)
+{
+    char path[testPathLength], journal[testPathLength];
+    struct PhoneForward *reference = phfwdNew();
+    struct stat st;
+
+    testPath(path, "journaled.bin");
+    testPath(journal, "journaled.bin.journal");
+
+    struct PhoneForward *pf = phfwdRecover(path, 64, 1 << 30);
+
+    testCheck(pf != NULL, "phfwdRecover without files");
+
+    if (pf == NULL)
+    {
+        phfwdDelete(reference);
+        return;
+    }
+
+    testFill(pf, 10, 3000);
+    testFill(reference, 10, 3000);
+    testCheck(phfwdSync(pf), "phfwdSync");
+    testCheck(stat(journal, &st) == 0, "journal exists");
+
+    off_t synced = st.st_size;
+
+    // Ostatni rekord jest zapisany tylko w połowie
+    testCheck(phfwdAdd(pf, "12345", "678"), "phfwdAdd");
+    testCheck(phfwdSync(pf), "phfwdSync");
+    phfwdDelete(pf);
+    testCheck(stat(journal, &st) == 0 && st.st_size > synced, "journal grows");
+    testCheck(truncate(journal, synced + (st.st_size - synced) / 2) == 0, "truncate journal");
+
+    pf = phfwdRecover(path, 64, 1 << 30);
+    testCheck(pf != NULL, "phfwdRecover after a torn write");
+
+    if (pf == NULL)
+    {
+        phfwdDelete(reference);
+        return;
+    }
+
+    testCheck(testSame(pf, reference, 11), "recovery drops only the torn record");
+
+    // Urwany rekord jest odcięty, więc nowe rekordy da się odtworzyć
+    testFill(pf, 12, 500);
+    testFill(reference, 12, 500);
+    phfwdDelete(pf);
+
+    pf = phfwdRecover(path, 64, 1 << 30);
+    testCheck(pf != NULL && testSame(pf, reference, 13), "records after a torn write are recovered");
+
+    // Po skróceniu dziennika przekierowania są w pliku z przekierowaniami
+    phfwdDelete(pf);
+    pf = phfwdRecover(path, 64, 1024);
+    testFill(pf, 14, 2000);
+    testFill(reference, 14, 2000);
+    phfwdDelete(pf);
+
+    pf = phfwdRecover(path, 64, 1024);
+    testCheck(pf != NULL && testSame(pf, reference, 15), "recovery after compaction");
+
+    phfwdDelete(pf);
+    phfwdDelete(reference);
+    unlink(journal);
+    unlink(path);
+}
+
+/**
+ * @brief Przypadek testowy.
+ */
+struct TestCase
+{
+    char const *name; ///< nazwa przypadku
+    void (*run)(void); ///< funkcja wykonująca przypadek
+};
+
+/**
+ * Wszystkie przypadki testowe
+ */
+static const struct TestCase testCases[] = {
+    {"save_load", testSaveLoad},
+    {"open", testOpen},
+    {"corrupt", testCorrupt},
+    {"journal", testJournal},
+};
+
+/** @brief Wykonuje przypadek testowy.
+ * @param[in] argc – liczba argumentów;
+ * @param[in] argv – argumenty: nazwa przypadku.
+ * @return 0, jeśli przypadek się udał, a 1 w przeciwnym wypadku.
+ */
+int main(int argc, char *argv[])
+{
+    size_t cases = sizeof(testCases) / sizeof(testCases[0]);
+    size_t i = 0;
+
+    while (argc == 2 && i < cases && strcmp(argv[1], testCases[i].name) != 0)
+        i++;
+
+    if (argc != 2 || i == cases)
+    {
+        fprintf(stderr, "usage: %s save_load|open|corrupt|journal\n", argv[0]);
+        return 1;
+    }
+
+    if (mkdtemp(testDirectory) == NULL)
+    {
+        perror(testDirectory);
+        return 1;
+    }
+
+    testCases[i].run();
+
+    // Przypadki usuwają swoje pliki, a pliki tymczasowe skracania mogą zostać
+    char command[testPathLength];
+
+    snprintf(command, sizeof(command), "rm -rf '%s'", testDirectory);
+
+    if (system(command) != 0)
+        fprintf(stderr, "cannot remove %s\n", testDirectory);
+
+    return testFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+/** @file
+ * Testy migawek i przywracania przekierowań
+ *
+ * Program zmienia strukturę, tworzy jej migawki i przywraca przekierowania
+ * z migawek, a każdą migawkę i samą strukturę porównuje ze strukturą,
+ * w której od nowa wykonano po kolei te same zmiany. Zmiany usuwają także
+ * całe poddrzewa współdzielone z migawkami.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "test_utils.h"
+
+/**
+ * Maksymalna liczba zapamiętanych zmian
+ */
+#define testMaxOperations 100000
+
+/**
+ * Maksymalna liczba jednocześnie istniejących migawek
+ */
+#define testMaxSnapshots 6
+
+/**
+ * @brief Zmiana przekierowań.
+ */
+struct TestOperation
+{
+    char num1[16]; ///< przekierowywany prefiks lub prefiks usuwanych przekierowań
+    char num2[16]; ///< prefiks, na który jest przekierowanie, lub pusty napis dla usunięcia
+};
+
+/**
+ * @brief Migawka i liczba zmian, które ją wyznaczają.
+ */
+struct TestSnapshot
+{
+    struct PhoneForward *pf; ///< migawka lub NULL
+    size_t operations; ///< liczba zmian z dziennika testu wykonanych przed utworzeniem migawki
+};
+
+/**
+ * Zmiany przekierowań wykonane na strukturze, która jest aktualnie zmieniana
+ */
+static struct TestOperation testLog[testMaxOperations];
+
+/**
+ * Liczba zmian w @ref testLog
+ */
+static size_t testLogSize = 0;
+
+/** @brief Wykonuje zmianę.
+ * @param[in,out] pf – wskaźnik na strukturę;
+ * @param[in] op – wskaźnik na zmianę.
+ */
+static void testApply(struct PhoneForward *pf, struct TestOperation const *op)
+{
+    if (op->num2[0] == '\0')
+        phfwdRemove(pf, op->num1);
+    else
+        phfwdAdd(pf, op->num1, op->num2);
+}
+
+/** @brief Losuje zmiany, wykonuje je i zapisuje w @ref testLog.
+ * Co dwudziesta zmiana usuwa przekierowania z jednocyfrowym prefiksem,
+ * czyli całe poddrzewo korzenia, zwykle współdzielone z migawkami.
+ * @param[in,out] pf – wskaźnik na strukturę;
+ * @param[in,out] seed – stan generatora;
+ * @param[in] changes – liczba zmian.
+ */
+static void testChange(struct PhoneForward *pf, unsigned int *seed, int changes)
+{
+    for(int i = 0; i < changes && testLogSize < testMaxOperations; i++)
+    {
+        struct TestOperation *op = &testLog[testLogSize++];
+        int kind = rand_r(seed) % 20;
+
+        testNumber(seed, op->num1, kind == 0 ? 1 : 7);
+        testNumber(seed, op->num2, 7);
+
+        if (kind < 3)
+            op->num2[0] = '\0';
+
+        testApply(pf, op);
+    }
+}
+
+/** @brief Sprawdza strukturę z wynikiem zmian wykonanych od nowa.
+ * @param[in] pf – wskaźnik na sprawdzaną strukturę;
+ * @param[in] operations – liczba pierwszych zmian z @ref testLog, które ją wyznaczają;
+ * @param[in] seed – ziarno generatora zapytań;
+ * @param[in] what – opis sprawdzanej struktury.
+ */
+static void testReplayed(struct PhoneForward *pf, size_t operations, unsigned int seed, char const *what)
+{
+    struct PhoneForward *reference = phfwdNew();
+
+    for(size_t i = 0; reference != NULL && i < operations; i++)
+        testApply(reference, &testLog[i]);
+
+    testCheck(pf != NULL && reference != NULL && testSame(pf, reference, seed), what);
+    phfwdDelete(reference);
+}
+
+/** @brief Sprawdza wszystkie istniejące migawki.
+ * @param[in] snapshots – tablica @ref testMaxSnapshots migawek;
+ * @param[in] seed – ziarno generatora zapytań.
+ */
+static void testSnapshots(struct TestSnapshot const *snapshots, unsigned int seed)
+{
+    for(int i = 0; i < testMaxSnapshots; i++)
+    {
+        if (snapshots[i].pf != NULL)
+            testReplayed(snapshots[i].pf, snapshots[i].operations, seed + i, "snapshot answers like a replay");
+    }
+}
+
+/** @brief Tworzy migawki, zmienia strukturę i przywraca migawki.
+ * Migawki są tworzone także z migawek, zastępują losowe starsze migawki,
+ * a struktura jest przywracana do losowych migawek i dalej zmieniana.
+ */
+static void testRollback(void)
+{
+    struct PhoneForward *pf = phfwdNew();
+    struct TestSnapshot snapshots[testMaxSnapshots] = {{NULL, 0}};
+    unsigned int seed = 1;
+
+    testLogSize = 0;
+
+    for(int round = 0; round < 30; round++)
+    {
+        int slot = rand_r(&seed) % testMaxSnapshots;
+        struct TestSnapshot *source = &snapshots[rand_r(&seed) % testMaxSnapshots];
+
+        phfwdDelete(snapshots[slot].pf);
+
+        // Migawka migawki ma przekierowania tej migawki
+        if (round % 4 == 3 && source->pf != NULL && source != &snapshots[slot])
+            snapshots[slot] = (struct TestSnapshot){phfwdSnapshot(source->pf), source->operations};
+        else
+            snapshots[slot] = (struct TestSnapshot){phfwdSnapshot(pf), testLogSize};
+
+        testCheck(snapshots[slot].pf != NULL, "phfwdSnapshot");
+        testCheck(!phfwdAdd(snapshots[slot].pf, "1", "2"), "snapshot is read-only");
+
+        testChange(pf, &seed, 300);
+
+        if (round % 5 == 4)
+        {
+            struct TestSnapshot *target = &snapshots[rand_r(&seed) % testMaxSnapshots];
+
+            if (target->pf != NULL)
+            {
+                testCheck(phfwdRollback(pf, target->pf), "phfwdRollback");
+                testLogSize = target->operations;
+                testReplayed(pf, testLogSize, seed, "rolled back structure answers like a replay");
+
+                // Zmiana po przywróceniu nie zmienia migawki, z której przywrócono
+                testChange(pf, &seed, 100);
+            }
+        }
+
+        testReplayed(pf, testLogSize, seed, "structure answers like a replay");
+        testSnapshots(snapshots, seed);
+    }
+
+    // Przywrócenie tej samej migawki drugi raz
+    struct PhoneForward *snapshot = phfwdSnapshot(pf);
+    size_t operations = testLogSize;
+
+    testChange(pf, &seed, 500);
+    testCheck(phfwdRollback(pf, snapshot), "phfwdRollback");
+    testChange(pf, &seed, 500);
+    testCheck(phfwdRollback(pf, snapshot), "second phfwdRollback to the same snapshot");
+    testLogSize = operations;
+    testReplayed(pf, testLogSize, seed, "structure rolled back twice answers like a replay");
+    testReplayed(snapshot, operations, seed + 1, "snapshot survives two rollbacks");
+    phfwdDelete(snapshot);
+
+    struct PhoneForward *other = phfwdNew();
+
+    testCheck(!phfwdRollback(other, snapshots[0].pf), "phfwdRollback rejects a foreign snapshot");
+    phfwdDelete(other);
+
+    for(int i = 0; i < testMaxSnapshots; i++)
+        phfwdDelete(snapshots[i].pf);
+
+    testReplayed(pf, testLogSize, seed, "structure outlives its snapshots");
+    phfwdDelete(pf);
+}
+
+/** @brief Usuwa strukturę przed jej migawkami.
+ * Migawki korzystają z areny usuniętej struktury, więc muszą dalej
+ * odpowiadać tak samo, także po utworzeniu migawki migawki.
+ */
+static void testOriginDeleted(void)
+{
+    struct PhoneForward *pf = phfwdNew();
+    struct TestSnapshot snapshots[testMaxSnapshots] = {{NULL, 0}};
+    unsigned int seed = 2;
+
+    testLogSize = 0;
+
+    for(int i = 0; i < testMaxSnapshots - 1; i++)
+    {
+        testChange(pf, &seed, 400);
+        snapshots[i] = (struct TestSnapshot){phfwdSnapshot(pf), testLogSize};
+    }
+
+    testChange(pf, &seed, 400);
+    phfwdDelete(pf);
+
+    snapshots[testMaxSnapshots - 1] = (struct TestSnapshot){phfwdSnapshot(snapshots[1].pf), snapshots[1].operations};
+    testCheck(snapshots[testMaxSnapshots - 1].pf != NULL, "phfwdSnapshot of a snapshot of a deleted structure");
+    testSnapshots(snapshots, 20);
+
+    // Migawki są usuwane w innej kolejności niż były tworzone
+    for(int i = 0; i < testMaxSnapshots; i += 2)
+    {
+        phfwdDelete(snapshots[i].pf);
+        snapshots[i].pf = NULL;
+    }
+
+    testSnapshots(snapshots, 30);
+
+    for(int i = 1; i < testMaxSnapshots; i += 2)
+        phfwdDelete(snapshots[i].pf);
+}
+
+/** @brief Uruchamia testy.
+ * @return 0, jeśli testy się udały, a 1 w przeciwnym wypadku.
+ */
+int main(void)
+{
+    testRollback();
+    testOriginDeleted();
+
+    return testFailures == 0 ? 0 : 1;
+}
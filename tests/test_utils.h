@@ -0,0 +1,137 @@
+/** @file
+ * Funkcje pomocnicze testów modułu phone_forward.h
+ *
+ * Każdy test jest osobnym programem, więc funkcje są zdefiniowane
+ * w nagłówku. Numery są losowane z dwunastu cyfr, żeby zapytania trafiały
+ * w przekierowania także dla krótkich numerów.
+ *
+ * @author Jan Klinkosz <jk394342@mimuw.edu.pl>
+ */
+
+#ifndef __TEST_UTILS_H__
+#define __TEST_UTILS_H__
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/phone_forward.h"
+
+/**
+ * Liczba zapytań, którymi porównywane są struktury
+ */
+#define testQueries 3000
+
+/**
+ * Liczba niespełnionych warunków
+ */
+static int testFailures = 0;
+
+/** @brief Zapisuje niespełniony warunek.
+ * @param[in] condition – wartość warunku;
+ * @param[in] what – opis warunku.
+ */
+static inline void testCheck(bool condition, char const *what)
+{
+    if (!condition)
+    {
+        fprintf(stderr, "FAILED: %s\n", what);
+        testFailures++;
+    }
+}
+
+/** @brief Losuje numer.
+ * @param[in,out] seed – stan generatora;
+ * @param[out] num – bufor na co najmniej @p max + 1 znaków;
+ * @param[in] max – maksymalna długość numeru.
+ */
+static inline void testNumber(unsigned int *seed, char *num, int max)
+{
+    static char const digits[] = "0123456789:;";
+    int len = 1 + rand_r(seed) % max;
+
+    for(int i = 0; i < len; i++)
+        num[i] = digits[rand_r(seed) % 12];
+
+    num[len] = '\0';
+}
+
+/** @brief Losowo dodaje i usuwa przekierowania.
+ * @param[in,out] pf – wskaźnik na strukturę;
+ * @param[in] seed – ziarno generatora;
+ * @param[in] changes – liczba zmian.
+ */
+static inline void testFill(struct PhoneForward *pf, unsigned int seed, int changes)
+{
+    char num1[16], num2[16];
+
+    for(int i = 0; i < changes; i++)
+    {
+        testNumber(&seed, num1, 7);
+        testNumber(&seed, num2, 7);
+
+        if (rand_r(&seed) % 8 == 0)
+            phfwdRemove(pf, num1);
+        else
+            phfwdAdd(pf, num1, num2);
+    }
+}
+
+/** @brief Sprawdza, czy dwa ciągi numerów są równe.
+ * @param[in] a – wskaźnik na pierwszy ciąg;
+ * @param[in] b – wskaźnik na drugi ciąg.
+ * @return Wartość @p true, jeśli ciągi są równe.
+ */
+static inline bool testSameNumbers(struct PhoneNumbers const *a, struct PhoneNumbers const *b)
+{
+    for(size_t i = 0;; i++)
+    {
+        char const *x = phnumGet(a, i), *y = phnumGet(b, i);
+
+        if (x == NULL || y == NULL)
+            return x == y;
+
+        if (strcmp(x, y) != 0)
+            return false;
+    }
+}
+
+/** @brief Sprawdza, czy dwie struktury odpowiadają tak samo na zapytania.
+ * Porównuje wyniki @ref phfwdGet, @ref phfwdReverse
+ * i @ref phfwdNonTrivialCount dla losowych numerów.
+ * @param[in] a – wskaźnik na pierwszą strukturę;
+ * @param[in] b – wskaźnik na drugą strukturę;
+ * @param[in] seed – ziarno generatora zapytań.
+ * @return Wartość @p true, jeśli wszystkie odpowiedzi są równe.
+ */
+static inline bool testSame(struct PhoneForward *a, struct PhoneForward *b, unsigned int seed)
+{
+    char num[16];
+
+    for(int i = 0; i < testQueries; i++)
+    {
+        testNumber(&seed, num, 9);
+
+        struct PhoneNumbers const *x = phfwdGet(a, num), *y = phfwdGet(b, num);
+        bool same = testSameNumbers(x, y);
+
+        phnumDelete(x);
+        phnumDelete(y);
+
+        x = phfwdReverse(a, num);
+        y = phfwdReverse(b, num);
+        same = same && testSameNumbers(x, y);
+
+        phnumDelete(x);
+        phnumDelete(y);
+
+        size_t len = rand_r(&seed) % 12;
+
+        if (!same || phfwdNonTrivialCount(a, num, len) != phfwdNonTrivialCount(b, num, len))
+            return false;
+    }
+
+    return true;
+}
+
+#endif /* __TEST_UTILS_H__ */